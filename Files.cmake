@@ -1,23 +1,45 @@
 # Source files
 SET (msgpack-c_SOURCES
+    src/allocator.c
+    src/contiguous.c
+    src/cursor.c
+    src/event.c
+    src/fdbuffer.c
+    src/filter.c
+    src/mmap_reader.c
     src/objectc.c
+    src/projection.c
     src/unpack.c
     src/version.c
     src/vrefbuffer.c
     src/zone.c
+    src/zone_mmap.c
+    src/skip.c
+    src/typed.c
     src/sprintf.c
+    src/tape.c
 )
 
 # Header files
 SET (msgpack-c_common_HEADERS
     include/msgpack.h
+    include/msgpack/allocator.h
+    include/msgpack/cursor.h
+    include/msgpack/event.h
     include/msgpack/fbuffer.h
+    include/msgpack/fdbuffer.h
+    include/msgpack/filter.h
     include/msgpack/gcc_atomic.h
+    include/msgpack/mmap_reader.h
     include/msgpack/object.h
     include/msgpack/pack.h
     include/msgpack/pack_define.h
+    include/msgpack/projection.h
+    include/msgpack/pzbuffer.h
     include/msgpack/sbuffer.h
+    include/msgpack/tape.h
     include/msgpack/timestamp.h
+    include/msgpack/typed.h
     include/msgpack/unpack.h
     include/msgpack/unpack_define.h
     include/msgpack/unpack_template.h
@@ -27,6 +49,7 @@ SET (msgpack-c_common_HEADERS
     include/msgpack/vrefbuffer.h
     include/msgpack/zbuffer.h
     include/msgpack/zone.h
+    include/msgpack/zunpacker.h
 )
 
 # Header files will configured
@@ -0,0 +1,95 @@
+/*
+ * msgpack_unpacker_next over many small messages, with atomic and plain
+ * reference counting of the unpacker buffers.
+ *
+ * usage: unpacker_refcount [messages] [rounds]
+ */
+#include <msgpack.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define FEED_SIZE (64 * 1024)
+
+/* ["event", i, "payload"]: the strs reference the unpacker buffer */
+static void pack_messages(msgpack_sbuffer* sbuf, size_t messages)
+{
+    msgpack_packer pk;
+    size_t i;
+
+    msgpack_packer_init(&pk, sbuf, msgpack_sbuffer_write);
+    for(i = 0; i < messages; ++i) {
+        msgpack_pack_array(&pk, 3);
+        msgpack_pack_str_with_body(&pk, "event", 5);
+        msgpack_pack_uint64(&pk, i);
+        msgpack_pack_str_with_body(&pk, "payload", 7);
+    }
+}
+
+static double run(const msgpack_sbuffer* sbuf, size_t messages, bool atomic)
+{
+    msgpack_unpacker unp;
+    msgpack_unpacked result;
+    size_t fed = 0;
+    size_t count = 0;
+    clock_t start;
+
+    if(!msgpack_unpacker_init(&unp, FEED_SIZE)) {
+        fprintf(stderr, "out of memory\n");
+        exit(1);
+    }
+    msgpack_unpacker_set_atomic_refcount(&unp, atomic);
+    msgpack_unpacked_init(&result);
+
+    start = clock();
+    while(fed < sbuf->size) {
+        size_t n = sbuf->size - fed < FEED_SIZE ? sbuf->size - fed : FEED_SIZE;
+        if(!msgpack_unpacker_reserve_buffer(&unp, n)) {
+            fprintf(stderr, "out of memory\n");
+            exit(1);
+        }
+        memcpy(msgpack_unpacker_buffer(&unp), sbuf->data + fed, n);
+        msgpack_unpacker_buffer_consumed(&unp, n);
+        fed += n;
+        while(msgpack_unpacker_next(&unp, &result) == MSGPACK_UNPACK_SUCCESS) {
+            ++count;
+        }
+    }
+    msgpack_unpacked_destroy(&result);
+    msgpack_unpacker_destroy(&unp);
+
+    if(count != messages) {
+        fprintf(stderr, "unpacked %lu messages of %lu\n",
+                (unsigned long)count, (unsigned long)messages);
+        exit(1);
+    }
+    return (double)(clock() - start) / CLOCKS_PER_SEC;
+}
+
+int main(int argc, char** argv)
+{
+    size_t messages = argc > 1 ? (size_t)strtoul(argv[1], NULL, 10) : 1000000;
+    int rounds = argc > 2 ? atoi(argv[2]) : 5;
+    double best_atomic = 0;
+    double best_plain = 0;
+    msgpack_sbuffer sbuf;
+    int i;
+
+    msgpack_sbuffer_init(&sbuf);
+    pack_messages(&sbuf, messages);
+
+    for(i = 0; i < rounds; ++i) {
+        double t = run(&sbuf, messages, true);
+        if(i == 0 || t < best_atomic) best_atomic = t;
+        t = run(&sbuf, messages, false);
+        if(i == 0 || t < best_plain) best_plain = t;
+    }
+
+    printf("%lu messages, best of %d rounds\n", (unsigned long)messages, rounds);
+    printf("atomic refcount: %8.2f ns/message\n", best_atomic * 1e9 / (double)messages);
+    printf("plain refcount:  %8.2f ns/message\n", best_plain * 1e9 / (double)messages);
+
+    msgpack_sbuffer_destroy(&sbuf);
+    return 0;
+}
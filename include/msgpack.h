@@ -14,6 +14,7 @@
  */
 
 #include "msgpack/util.h"
+#include "msgpack/allocator.h"
 #include "msgpack/object.h"
 #include "msgpack/zone.h"
 #include "msgpack/pack.h"
@@ -22,4 +23,22 @@
 #include "msgpack/vrefbuffer.h"
 #include "msgpack/version.h"
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 int msgpack_sprintf(msgpack_packer* pk, const char *fmt, ...);
+
+/**
+ * Same syntax as msgpack_sprintf, the output is appended to vbuf.
+ * str and bin bodies of vbuf->ref_size bytes or more (or any size with the
+ * %&s and %&p specifiers) are referenced instead of copied, so they must stay
+ * valid until the vectors of vbuf are written out.
+ * Returns 0 on success, -1 if memory could not be allocated.
+ */
+int msgpack_sprintf_vrefbuffer(msgpack_vrefbuffer* vbuf, const char *fmt, ...);
+
+#ifdef __cplusplus
+}
+#endif
+
@@ -0,0 +1,86 @@
+/*
+ * MessagePack for C allocator hooks
+ *
+ *    Distributed under the Boost Software License, Version 1.0.
+ *    (See accompanying file LICENSE_1_0.txt or copy at
+ *    http://www.boost.org/LICENSE_1_0.txt)
+ */
+#ifndef MSGPACK_ALLOCATOR_H
+#define MSGPACK_ALLOCATOR_H
+
+#include "sysdep.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/**
+ * @defgroup msgpack_allocator Allocator
+ * @ingroup msgpack
+ * @{
+ */
+
+/**
+ * Memory functions used in place of malloc(), realloc() and free(), with a
+ * user context, by everything the library allocates: the buffers, zone,
+ * unpackers, packer, cursor-based readers and the objects they return.
+ * Not covered: zlib's own stream state, the pages the mmap zone provider
+ * maps, and the threads and locks of pzbuffer.
+ * realloc must accept a NULL ptr, like realloc().
+ * Objects initialized with a NULL allocator use the default one when they
+ * allocate. The default must be set before the library allocates anything
+ * that is freed afterwards, since memory goes back to the allocator that is
+ * the default when it is freed.
+ */
+typedef struct msgpack_allocator {
+    void* (*malloc)(void* ctx, size_t size);
+    void* (*realloc)(void* ctx, void* ptr, size_t size);
+    void (*free)(void* ctx, void* ptr);
+    void* ctx;
+} msgpack_allocator;
+
+/**
+ * Sets the default allocator, which must stay valid while in use. NULL
+ * restores the libc one.
+ */
+MSGPACK_DLLEXPORT
+void msgpack_allocator_set_default(const msgpack_allocator* allocator);
+
+MSGPACK_DLLEXPORT
+const msgpack_allocator* msgpack_allocator_get_default(void);
+
+/**
+ * The allocator calling malloc(), realloc() and free(), e.g. for allocators
+ * that only count.
+ */
+MSGPACK_DLLEXPORT
+const msgpack_allocator* msgpack_allocator_libc(void);
+
+static inline void* msgpack_allocator_malloc(const msgpack_allocator* allocator, size_t size)
+{
+    const msgpack_allocator* a = allocator ? allocator : msgpack_allocator_get_default();
+    return (*a->malloc)(a->ctx, size);
+}
+
+static inline void* msgpack_allocator_realloc(const msgpack_allocator* allocator,
+        void* ptr, size_t size)
+{
+    const msgpack_allocator* a = allocator ? allocator : msgpack_allocator_get_default();
+    return (*a->realloc)(a->ctx, ptr, size);
+}
+
+static inline void msgpack_allocator_free(const msgpack_allocator* allocator, void* ptr)
+{
+    const msgpack_allocator* a = allocator ? allocator : msgpack_allocator_get_default();
+    (*a->free)(a->ctx, ptr);
+}
+
+/** @} */
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* msgpack/allocator.h */
@@ -0,0 +1,138 @@
+/*
+ * MessagePack for C lazy cursor
+ *
+ *    Distributed under the Boost Software License, Version 1.0.
+ *    (See accompanying file LICENSE_1_0.txt or copy at
+ *    http://www.boost.org/LICENSE_1_0.txt)
+ */
+#ifndef MSGPACK_CURSOR_H
+#define MSGPACK_CURSOR_H
+
+#include "object.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/**
+ * @defgroup msgpack_cursor Lazy cursor
+ * @ingroup msgpack
+ * @{
+ */
+
+/**
+ * Read-only position on an object of packed data.
+ * Only the objects the cursor is moved over are decoded, and only their
+ * headers: the siblings that are stepped over are skipped without decoding
+ * and nothing is allocated. The packed data must outlive the cursor.
+ */
+typedef struct msgpack_cursor {
+    const char* data;
+    size_t len;
+    size_t pos;     /* offset of the current object */
+    size_t left;    /* objects from the current one to the end of its container */
+} msgpack_cursor;
+
+/**
+ * Points the cursor at the object at data + off.
+ */
+MSGPACK_DLLEXPORT
+void msgpack_cursor_init(msgpack_cursor* cur, const char* data, size_t len, size_t off);
+
+/**
+ * Tells whether the cursor is on an object, false after the last element
+ * of a container.
+ */
+static inline bool msgpack_cursor_valid(const msgpack_cursor* cur);
+
+/**
+ * Decodes the header of the current object.
+ * Scalars are decoded completely, str, bin and ext point into the data,
+ * arrays and maps only get their size (ptr is NULL).
+ * Returns false if the object is truncated or invalid.
+ */
+MSGPACK_DLLEXPORT
+bool msgpack_cursor_peek(const msgpack_cursor* cur, msgpack_object* obj);
+
+/**
+ * Gets the type of the current object. Returns MSGPACK_OBJECT_NIL when
+ * msgpack_cursor_peek() would fail.
+ */
+MSGPACK_DLLEXPORT
+msgpack_object_type msgpack_cursor_type(const msgpack_cursor* cur);
+
+/**
+ * Moves to the next sibling, skipping the current object without decoding it.
+ * Returns false when there is no next sibling or the data is malformed.
+ */
+MSGPACK_DLLEXPORT
+bool msgpack_cursor_next(msgpack_cursor* cur);
+
+/**
+ * Points child at the first element of the current array, or the first key
+ * of the current map; map keys and values alternate. cur is not moved.
+ * Returns false if the current object is not a container. An empty
+ * container gives a child that is not valid.
+ */
+MSGPACK_DLLEXPORT
+bool msgpack_cursor_enter(const msgpack_cursor* cur, msgpack_cursor* child);
+
+/**
+ * Tells whether the current object is a str equal to key.
+ */
+MSGPACK_DLLEXPORT
+bool msgpack_cursor_key_equals(const msgpack_cursor* cur, const char* key, size_t size);
+
+/**
+ * Looks up a str key in the current map and points value at its value.
+ * The values of the other keys are skipped without decoding.
+ */
+MSGPACK_DLLEXPORT
+bool msgpack_cursor_find_key(const msgpack_cursor* cur, const char* key, size_t size,
+        msgpack_cursor* value);
+
+/**
+ * Converters. They return false, leaving the output untouched, if the
+ * current object does not have a matching type or does not fit.
+ * msgpack_cursor_as_double() also accepts integers.
+ */
+MSGPACK_DLLEXPORT
+bool msgpack_cursor_as_int(const msgpack_cursor* cur, int64_t* v);
+MSGPACK_DLLEXPORT
+bool msgpack_cursor_as_uint(const msgpack_cursor* cur, uint64_t* v);
+MSGPACK_DLLEXPORT
+bool msgpack_cursor_as_double(const msgpack_cursor* cur, double* v);
+MSGPACK_DLLEXPORT
+bool msgpack_cursor_as_bool(const msgpack_cursor* cur, bool* v);
+MSGPACK_DLLEXPORT
+bool msgpack_cursor_as_str(const msgpack_cursor* cur, const char** ptr, uint32_t* size);
+MSGPACK_DLLEXPORT
+bool msgpack_cursor_as_bin(const msgpack_cursor* cur, const char** ptr, uint32_t* size);
+
+/**
+ * Gets the packed bytes of the current object, e.g. to forward it as is.
+ */
+MSGPACK_DLLEXPORT
+bool msgpack_cursor_raw(const msgpack_cursor* cur, const char** ptr, size_t* size);
+
+/**
+ * Unpacks the current object completely, allocating from zone.
+ */
+MSGPACK_DLLEXPORT
+bool msgpack_cursor_object(const msgpack_cursor* cur, msgpack_zone* zone, msgpack_object* obj);
+
+/** @} */
+
+
+static inline bool msgpack_cursor_valid(const msgpack_cursor* cur)
+{
+    return cur->left > 0 && cur->pos < cur->len;
+}
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* msgpack/cursor.h */
@@ -0,0 +1,107 @@
+/*
+ * MessagePack for C event-driven deserializer
+ *
+ *    Distributed under the Boost Software License, Version 1.0.
+ *    (See accompanying file LICENSE_1_0.txt or copy at
+ *    http://www.boost.org/LICENSE_1_0.txt)
+ */
+#ifndef MSGPACK_EVENT_H
+#define MSGPACK_EVENT_H
+
+#include "unpack.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/**
+ * @defgroup msgpack_event Event-driven deserializer
+ * @ingroup msgpack
+ * @{
+ */
+
+/**
+ * Callbacks of the event-driven deserializer.
+ * No msgpack_object and no msgpack_zone are created: every value is reported
+ * as soon as it has been read, str, bin and ext bodies point into the parsed
+ * data. Callbacks left NULL are skipped.
+ * A callback returning a negative value aborts the parsing, and the value is
+ * returned from msgpack_event_parser_execute() or msgpack_event_parse().
+ */
+typedef struct msgpack_event_callbacks {
+    int (*nil)(void* data);
+    int (*boolean)(void* data, bool v);
+    int (*positive_integer)(void* data, uint64_t v);
+    int (*negative_integer)(void* data, int64_t v);
+    int (*float32)(void* data, float v);
+    int (*float64)(void* data, double v);
+    int (*str)(void* data, const char* ptr, uint32_t size);
+    int (*bin)(void* data, const char* ptr, uint32_t size);
+    int (*ext)(void* data, int8_t type, const char* ptr, uint32_t size);
+
+    /** Called instead of str for the str keys of maps when not NULL. */
+    int (*key)(void* data, const char* ptr, uint32_t size);
+
+    int (*begin_array)(void* data, uint32_t size);
+    int (*begin_map)(void* data, uint32_t size);
+    /** Called after the last element, also for empty containers. */
+    int (*end_array)(void* data);
+    int (*end_map)(void* data);
+} msgpack_event_callbacks;
+
+typedef struct msgpack_event_parser {
+    void* ctx;
+} msgpack_event_parser;
+
+/**
+ * Initializes an event-driven deserializer.
+ * @param cb    callbacks, must stay valid while the parser is used
+ * @param data  user data passed to the callbacks
+ */
+MSGPACK_DLLEXPORT
+bool msgpack_event_parser_init(msgpack_event_parser* parser,
+        const msgpack_event_callbacks* cb, void* data);
+MSGPACK_DLLEXPORT
+void msgpack_event_parser_destroy(msgpack_event_parser* parser);
+
+MSGPACK_DLLEXPORT
+msgpack_event_parser* msgpack_event_parser_new(const msgpack_event_callbacks* cb, void* data);
+MSGPACK_DLLEXPORT
+void msgpack_event_parser_free(msgpack_event_parser* parser);
+
+/**
+ * Parses data from *off and reports the events of one object.
+ * Returns 1 once an object has been completed, *off is then set after it and
+ * the parser is ready for the next object. Returns 0 when more data is
+ * needed: the bytes from *off onward are not consumed yet and must be passed
+ * again, followed by the new data. Otherwise returns MSGPACK_UNPACK_PARSE_ERROR,
+ * MSGPACK_UNPACK_NOMEM_ERROR (nesting deeper than MSGPACK_EMBED_STACK_SIZE) or
+ * the negative value of a callback; msgpack_event_parser_reset() must be
+ * called before reusing the parser.
+ */
+MSGPACK_DLLEXPORT
+int msgpack_event_parser_execute(msgpack_event_parser* parser,
+        const char* data, size_t len, size_t* off);
+
+MSGPACK_DLLEXPORT
+void msgpack_event_parser_reset(msgpack_event_parser* parser);
+
+/**
+ * Reports the events of one complete object from data + *off, without any
+ * allocation. Returns MSGPACK_UNPACK_SUCCESS and sets *off after the object,
+ * MSGPACK_UNPACK_CONTINUE if the object is truncated, or an error as
+ * msgpack_event_parser_execute().
+ */
+MSGPACK_DLLEXPORT
+int msgpack_event_parse(const msgpack_event_callbacks* cb, void* user_data,
+        const char* data, size_t len, size_t* off);
+
+/** @} */
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* msgpack/event.h */
@@ -0,0 +1,97 @@
+/*
+ * MessagePack for C file descriptor buffer implementation
+ *
+ *    Distributed under the Boost Software License, Version 1.0.
+ *    (See accompanying file LICENSE_1_0.txt or copy at
+ *    http://www.boost.org/LICENSE_1_0.txt)
+ */
+#ifndef MSGPACK_FDBUFFER_H
+#define MSGPACK_FDBUFFER_H
+
+#include "vrefbuffer.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/**
+ * @defgroup msgpack_fdbuffer File descriptor buffer
+ * @ingroup msgpack_buffer
+ * @{
+ */
+
+/**
+ * Batches packed data for a file descriptor.
+ * Small writes are copied into the staging chunks of the embedded
+ * msgpack_vrefbuffer, bodies of ref_size bytes or more are kept by reference.
+ * Everything is sent with writev(2) by msgpack_fdbuffer_flush(msgpack_fdbuffer*).
+ * Referenced bodies must stay valid until the flush completes.
+ */
+typedef struct msgpack_fdbuffer {
+    int fd;
+    size_t head;
+    msgpack_vrefbuffer vbuf;
+} msgpack_fdbuffer;
+
+MSGPACK_DLLEXPORT
+bool msgpack_fdbuffer_init(msgpack_fdbuffer* fdbuf, int fd,
+        size_t ref_size, size_t chunk_size);
+MSGPACK_DLLEXPORT
+void msgpack_fdbuffer_destroy(msgpack_fdbuffer* fdbuf);
+
+static inline msgpack_fdbuffer* msgpack_fdbuffer_new(int fd, size_t ref_size, size_t chunk_size);
+static inline void msgpack_fdbuffer_free(msgpack_fdbuffer* fdbuf);
+
+static inline int msgpack_fdbuffer_write(void* data, const char* buf, size_t len);
+
+/**
+ * Writes pending data to the file descriptor.
+ * Returns 0 when everything has been written and the buffer has been cleared.
+ * Otherwise returns -1 and leaves errno set. On a non-blocking descriptor
+ * errno is EAGAIN (or EWOULDBLOCK) when the descriptor is full; call it
+ * again once the descriptor becomes writable and it resumes where the
+ * previous (possibly partial) write stopped.
+ */
+MSGPACK_DLLEXPORT
+int msgpack_fdbuffer_flush(msgpack_fdbuffer* fdbuf);
+
+/**
+ * Gets the number of bytes not yet written to the file descriptor.
+ */
+MSGPACK_DLLEXPORT
+size_t msgpack_fdbuffer_pending(const msgpack_fdbuffer* fdbuf);
+
+/** @} */
+
+
+static inline msgpack_fdbuffer* msgpack_fdbuffer_new(int fd, size_t ref_size, size_t chunk_size)
+{
+    msgpack_fdbuffer* fdbuf = (msgpack_fdbuffer*)msgpack_allocator_malloc(NULL, sizeof(msgpack_fdbuffer));
+    if (fdbuf == NULL) return NULL;
+    if(!msgpack_fdbuffer_init(fdbuf, fd, ref_size, chunk_size)) {
+        msgpack_allocator_free(NULL, fdbuf);
+        return NULL;
+    }
+    return fdbuf;
+}
+
+static inline void msgpack_fdbuffer_free(msgpack_fdbuffer* fdbuf)
+{
+    if(fdbuf == NULL) { return; }
+    msgpack_fdbuffer_destroy(fdbuf);
+    msgpack_allocator_free(NULL, fdbuf);
+}
+
+static inline int msgpack_fdbuffer_write(void* data, const char* buf, size_t len)
+{
+    msgpack_fdbuffer* fdbuf = (msgpack_fdbuffer*)data;
+    return msgpack_vrefbuffer_write(&fdbuf->vbuf, buf, len);
+}
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* msgpack/fdbuffer.h */
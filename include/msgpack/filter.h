@@ -0,0 +1,106 @@
+/*
+ * MessagePack for C record filter
+ *
+ *    Distributed under the Boost Software License, Version 1.0.
+ *    (See accompanying file LICENSE_1_0.txt or copy at
+ *    http://www.boost.org/LICENSE_1_0.txt)
+ */
+#ifndef MSGPACK_FILTER_H
+#define MSGPACK_FILTER_H
+
+#include "unpack.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/**
+ * @defgroup msgpack_filter Record filter
+ * @ingroup msgpack_unpack
+ * @{
+ */
+
+/**
+ * Conjunction of predicates evaluated on the packed bytes of records.
+ * Each predicate reads the value at a path: str map keys separated by '.',
+ * each optionally followed by "[N]" array selectors, e.g. "user.id" or
+ * "tags[0]". The empty path is the record itself. A record matches when
+ * every predicate holds; a missing path fails its predicate.
+ * Records are never unpacked: the values that are not on a path are
+ * skipped without being decoded.
+ */
+typedef struct msgpack_filter msgpack_filter;
+
+MSGPACK_DLLEXPORT
+msgpack_filter* msgpack_filter_new(void);
+MSGPACK_DLLEXPORT
+void msgpack_filter_free(msgpack_filter* filter);
+
+/**
+ * Adds "path == value". value is a scalar: nil, boolean, integer, float,
+ * str, bin or ext; its body is copied. Integers compare by value whatever
+ * their encoding, floats compare with both float32 and float64.
+ * These functions return false on a path syntax error, an unsupported
+ * value or when memory runs out.
+ */
+MSGPACK_DLLEXPORT
+bool msgpack_filter_add_equal(msgpack_filter* filter, const char* path,
+        const msgpack_object* value);
+
+/**
+ * Adds "min <= path <= max" for an integer value.
+ */
+MSGPACK_DLLEXPORT
+bool msgpack_filter_add_int_range(msgpack_filter* filter, const char* path,
+        int64_t min, int64_t max);
+
+/**
+ * Adds "path is a str starting with prefix".
+ */
+MSGPACK_DLLEXPORT
+bool msgpack_filter_add_str_prefix(msgpack_filter* filter, const char* path,
+        const char* prefix, size_t size);
+
+/**
+ * Evaluates the filter on the record at data + off, which must be complete.
+ */
+MSGPACK_DLLEXPORT
+bool msgpack_filter_match(const msgpack_filter* filter,
+        const char* data, size_t len, size_t off);
+
+/**
+ * Finds the next matching record of a sequence starting at data + *off.
+ * Returns MSGPACK_UNPACK_SUCCESS with the record in [*start, *off).
+ * Returns MSGPACK_UNPACK_CONTINUE when no complete record is left, *off
+ * being at the beginning of the truncated one, or MSGPACK_UNPACK_PARSE_ERROR
+ * with *off at the invalid record.
+ */
+MSGPACK_DLLEXPORT
+msgpack_unpack_return
+msgpack_filter_next(const msgpack_filter* filter,
+        const char* data, size_t len, size_t* off, size_t* start);
+
+/**
+ * msgpack_filter_next on the buffered data of an unpacker, so that records
+ * fed with msgpack_unpacker_buffer() and msgpack_unpacker_buffer_consumed()
+ * are filtered without being unpacked. The matching record is consumed and
+ * its bytes are available in [*ptr, *ptr + *size) until the buffer is
+ * reserved again. Do not call it while msgpack_unpacker_next() is in the
+ * middle of a record. Only the internal buffer is filtered: data queued
+ * with msgpack_unpacker_push_buffer() or msgpack_unpacker_push_iovec() is
+ * not seen, so do not use both on the same unpacker.
+ */
+MSGPACK_DLLEXPORT
+msgpack_unpack_return
+msgpack_unpacker_filter_next(msgpack_unpacker* mpac, const msgpack_filter* filter,
+        const char** ptr, size_t* size);
+
+/** @} */
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* msgpack/filter.h */
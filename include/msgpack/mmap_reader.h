@@ -0,0 +1,81 @@
+/*
+ * MessagePack for C memory-mapped file reader
+ *
+ *    Distributed under the Boost Software License, Version 1.0.
+ *    (See accompanying file LICENSE_1_0.txt or copy at
+ *    http://www.boost.org/LICENSE_1_0.txt)
+ */
+#ifndef MSGPACK_MMAP_READER_H
+#define MSGPACK_MMAP_READER_H
+
+#include "unpack.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/**
+ * @defgroup msgpack_mmap_reader Memory-mapped file reader
+ * @ingroup msgpack_unpack
+ * @{
+ */
+
+#ifndef MSGPACK_MMAP_READER_WINDOW
+#define MSGPACK_MMAP_READER_WINDOW (8*1024*1024)
+#endif
+
+/**
+ * Walks the objects of a file mapped read-only, without a read buffer:
+ * the page cache does the I/O. The pages of the next window bytes are
+ * requested ahead of the cursor, and the pages more than window bytes
+ * behind it are dropped from the mapping and the page cache.
+ */
+typedef struct msgpack_mmap_reader {
+    const char* data;
+    size_t size;
+    size_t off;         /* the next object */
+    int fd;
+    size_t window;
+    size_t advised;     /* end of the pages requested */
+    size_t dropped;     /* end of the pages dropped */
+} msgpack_mmap_reader;
+
+/**
+ * Maps the file at path, or the file open as fd, which the reader dups.
+ * window is the read-ahead size, MSGPACK_MMAP_READER_WINDOW if 0, rounded
+ * up to whole pages. Returns false and leaves errno set if the file cannot
+ * be mapped, always on Windows; closing the reader is then a no-op.
+ */
+MSGPACK_DLLEXPORT
+bool msgpack_mmap_reader_open(msgpack_mmap_reader* reader, const char* path, size_t window);
+MSGPACK_DLLEXPORT
+bool msgpack_mmap_reader_init_fd(msgpack_mmap_reader* reader, int fd, size_t window);
+
+/**
+ * Unmaps the file: the objects of the results must not be used anymore.
+ */
+MSGPACK_DLLEXPORT
+void msgpack_mmap_reader_close(msgpack_mmap_reader* reader);
+
+/**
+ * Unpacks the next object like msgpack_unpack_next(); its str, bin and ext
+ * point into the mapping, valid until msgpack_mmap_reader_close(). Pages
+ * dropped behind the cursor are read again if the objects are accessed.
+ * Returns MSGPACK_UNPACK_CONTINUE at the end of the file, or before an
+ * object the file truncates (reader->off < reader->size), and
+ * MSGPACK_UNPACK_PARSE_ERROR on invalid data. The cursor stays on the
+ * object on error.
+ */
+MSGPACK_DLLEXPORT
+msgpack_unpack_return
+msgpack_mmap_reader_next(msgpack_mmap_reader* reader, msgpack_unpacked* result);
+
+/** @} */
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* msgpack/mmap_reader.h */
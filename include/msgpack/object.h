@@ -141,6 +141,45 @@ int msgpack_object_print_buffer(char *buffer, size_t buffer_size, msgpack_object
 MSGPACK_DLLEXPORT
 bool msgpack_object_equal(const msgpack_object x, const msgpack_object y);
 
+typedef struct msgpack_object_map_slot {
+    uint32_t hash;
+    uint32_t pos;           /* index in ptr + 1, 0 for an empty slot */
+} msgpack_object_map_slot;
+
+/**
+ * Open addressing hash index of the str keys of a map.
+ */
+typedef struct msgpack_object_map_index {
+    uint32_t mask;          /* number of slots - 1 */
+    msgpack_object_map_slot* slots;
+} msgpack_object_map_index;
+
+/**
+ * Builds the index of the str keys of map in zone, so that it lives as long
+ * as an unpacked map. The map must not be modified while the index is used.
+ * Returns NULL when memory runs out.
+ */
+MSGPACK_DLLEXPORT
+msgpack_object_map_index* msgpack_object_map_index_build(msgpack_zone* zone,
+        const msgpack_object_map* map);
+
+/**
+ * Looks up the str key in map through index in O(1), or with
+ * msgpack_object_map_find_str() if index is NULL.
+ * Returns the value of the first pair with that key, or NULL.
+ */
+MSGPACK_DLLEXPORT
+const msgpack_object* msgpack_object_map_find(const msgpack_object_map* map,
+        const msgpack_object_map_index* index, const char* key, size_t len);
+
+/**
+ * Looks up the str key in map with a linear scan, which is the fastest for
+ * small maps: only the keys of the same size and first byte are compared.
+ */
+MSGPACK_DLLEXPORT
+const msgpack_object* msgpack_object_map_find_str(const msgpack_object_map* map,
+        const char* key, size_t len);
+
 /** @} */
 
 
@@ -13,6 +13,7 @@
 #include "pack_define.h"
 #include "object.h"
 #include "timestamp.h"
+#include "allocator.h"
 #include <stdlib.h>
 
 #ifdef __cplusplus
@@ -135,7 +136,7 @@ inline void msgpack_packer_init(msgpack_packer* pk, void* data, msgpack_packer_w
 
 inline msgpack_packer* msgpack_packer_new(void* data, msgpack_packer_write callback)
 {
-    msgpack_packer* pk = (msgpack_packer*)calloc(1, sizeof(msgpack_packer));
+    msgpack_packer* pk = (msgpack_packer*)msgpack_allocator_malloc(NULL, sizeof(msgpack_packer));
     if(!pk) { return NULL; }
     msgpack_packer_init(pk, data, callback);
     return pk;
@@ -143,7 +144,7 @@ inline msgpack_packer* msgpack_packer_new(void* data, msgpack_packer_write callb
 
 inline void msgpack_packer_free(msgpack_packer* pk)
 {
-    free(pk);
+    msgpack_allocator_free(NULL, pk);
 }
 
 inline int msgpack_pack_str_with_body(msgpack_packer* pk, const void* b, size_t l)
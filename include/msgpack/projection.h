@@ -0,0 +1,65 @@
+/*
+ * MessagePack for C projected unpacking
+ *
+ *    Distributed under the Boost Software License, Version 1.0.
+ *    (See accompanying file LICENSE_1_0.txt or copy at
+ *    http://www.boost.org/LICENSE_1_0.txt)
+ */
+#ifndef MSGPACK_PROJECTION_H
+#define MSGPACK_PROJECTION_H
+
+#include "unpack.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/**
+ * @defgroup msgpack_projection Projected deserializer
+ * @ingroup msgpack_unpack
+ * @{
+ */
+
+/**
+ * Compiled set of key paths.
+ * A path is a list of str map keys separated by '.', each optionally
+ * followed by array selectors: "[*]" for every element or "[N]" for the
+ * Nth one, e.g. "user.id", "events[*].ts" or "[0].name". Keys cannot
+ * contain '.' or '['. The empty path selects the whole object.
+ */
+typedef struct msgpack_projection msgpack_projection;
+
+/**
+ * Compiles paths. Returns NULL on a syntax error or when memory runs out.
+ */
+MSGPACK_DLLEXPORT
+msgpack_projection* msgpack_projection_new(const char* const* paths, size_t count);
+MSGPACK_DLLEXPORT
+void msgpack_projection_free(msgpack_projection* proj);
+
+/**
+ * Unpacks the parts of the object at data + *off selected by proj.
+ * The selected subtrees are unpacked completely into zone; everything else
+ * is skipped at the byte level without being decoded or allocated.
+ * Maps keep only the selected keys found in the data, and are dropped when
+ * none is found. Arrays selected with "[*]" keep their size, the elements
+ * without any selected content becoming nil; with "[N]" they keep only the
+ * selected elements found, in order. An element selected by both "[*]" and
+ * "[N]" gets the union of both selections. If nothing is selected, obj is
+ * nil.
+ * Returns the same values as msgpack_unpack.
+ */
+MSGPACK_DLLEXPORT
+msgpack_unpack_return
+msgpack_unpack_projected(const char* data, size_t len, size_t* off,
+        const msgpack_projection* proj, msgpack_zone* zone, msgpack_object* obj);
+
+/** @} */
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* msgpack/projection.h */
@@ -0,0 +1,662 @@
+/*
+ * MessagePack for C parallel deflate buffer implementation
+ *
+ *    Distributed under the Boost Software License, Version 1.0.
+ *    (See accompanying file LICENSE_1_0.txt or copy at
+ *    http://www.boost.org/LICENSE_1_0.txt)
+ */
+#ifndef MSGPACK_PZBUFFER_H
+#define MSGPACK_PZBUFFER_H
+
+/* POSIX threads only: the header declares nothing on Windows */
+#if !defined(_WIN32)
+
+#include "sysdep.h"
+#include "allocator.h"
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <zlib.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <time.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/**
+ * @defgroup msgpack_pzbuffer Parallel compressed buffer
+ * @ingroup msgpack_buffer
+ * @{
+ */
+
+/*
+ * The input is cut into blocks of block_size bytes. Every block is deflated
+ * by a worker thread as a raw deflate stream primed with the last 32 KiB of
+ * the previous block and ended on a byte boundary (Z_SYNC_FLUSH), the last
+ * one with Z_FINISH. The blocks are concatenated in order between a zlib
+ * header and the combined adler32, so the result is a single zlib stream
+ * that inflate() and msgpack_zbuffer readers accept.
+ *
+ * In pipelined mode (msgpack_pzbuffer_init_pipelined) a single background
+ * thread continues one zlib stream across the blocks instead, so the output
+ * is the same as msgpack_zbuffer's while the producer only copies into the
+ * block being filled. At most queue_depth full blocks wait for the
+ * compression thread; when the queue is full the producer stalls.
+ *
+ * The buffer is header-only and needs POSIX threads: programs including
+ * this header link zlib and pthreads themselves (-pthread, or
+ * Threads::Threads with CMake). The header is not available on Windows.
+ */
+
+#define MSGPACK_PZBUFFER_DICT_SIZE 32768
+
+typedef enum {
+    MSGPACK_PZBUFFER_JOB_FREE,
+    MSGPACK_PZBUFFER_JOB_QUEUED,
+    MSGPACK_PZBUFFER_JOB_DONE,
+    MSGPACK_PZBUFFER_JOB_ERROR
+} msgpack_pzbuffer_job_state;
+
+typedef struct msgpack_pzbuffer_job {
+    char* in;
+    size_t in_size;
+    const char* dict;
+    size_t dict_size;
+    char* out;
+    size_t out_size;
+    size_t out_alloc;
+    uLong check;
+    int last;
+    int first;
+    msgpack_pzbuffer_job_state state;
+} msgpack_pzbuffer_job;
+
+typedef struct msgpack_pzbuffer_stats {
+    size_t queue_depth;     /* blocks submitted and not yet collected */
+    size_t max_queue_depth;
+    size_t blocks;          /* blocks submitted */
+    size_t stalls;          /* times the producer waited for a free block */
+    uint64_t stall_ns;      /* time the producer spent waiting */
+} msgpack_pzbuffer_stats;
+
+typedef struct msgpack_pzbuffer {
+    int level;
+    size_t block_size;
+    int pipelined;
+
+    pthread_mutex_t lock;
+    pthread_cond_t work;
+    pthread_cond_t done;
+    pthread_t* threads;
+    size_t nthreads;
+    int shutdown;
+
+    msgpack_pzbuffer_job* jobs;
+    size_t njobs;
+    size_t head;    /* oldest job not yet collected */
+    size_t tail;    /* job being filled by the producer */
+    size_t next;    /* next job to be picked by a worker */
+    size_t first;   /* first job of the current stream */
+    int filling;    /* the slot of tail is owned by the producer */
+
+    uLong check;
+    int finished;
+
+    char* data;
+    size_t size;
+    size_t alloc;
+
+    msgpack_pzbuffer_stats stats;
+} msgpack_pzbuffer;
+
+#ifndef MSGPACK_PZBUFFER_BLOCK_SIZE
+#define MSGPACK_PZBUFFER_BLOCK_SIZE (128*1024)
+#endif
+
+#ifndef MSGPACK_PZBUFFER_QUEUE_DEPTH
+#define MSGPACK_PZBUFFER_QUEUE_DEPTH 2
+#endif
+
+/**
+ * Initializes a parallel compressed buffer.
+ * @param level     zlib compression level
+ * @param block_size size of the independently compressed blocks,
+ *                  0 means MSGPACK_PZBUFFER_BLOCK_SIZE
+ * @param nthreads  number of worker threads, 0 means one per online CPU
+ */
+static inline bool msgpack_pzbuffer_init(msgpack_pzbuffer* pzbuf,
+        int level, size_t block_size, size_t nthreads);
+
+/**
+ * Initializes a compressed buffer in pipelined mode. It starts one
+ * background thread and times the producer stalls with
+ * clock_gettime(CLOCK_MONOTONIC), so it has the same POSIX requirements as
+ * msgpack_pzbuffer_init().
+ * @param level     zlib compression level
+ * @param block_size size of the blocks handed to the compression thread,
+ *                  0 means MSGPACK_PZBUFFER_BLOCK_SIZE
+ * @param queue_depth number of full blocks that can wait for the compression
+ *                  thread, 0 means MSGPACK_PZBUFFER_QUEUE_DEPTH
+ */
+static inline bool msgpack_pzbuffer_init_pipelined(msgpack_pzbuffer* pzbuf,
+        int level, size_t block_size, size_t queue_depth);
+static inline void msgpack_pzbuffer_destroy(msgpack_pzbuffer* pzbuf);
+
+static inline msgpack_pzbuffer* msgpack_pzbuffer_new(int level, size_t block_size, size_t nthreads);
+static inline void msgpack_pzbuffer_free(msgpack_pzbuffer* pzbuf);
+
+static inline int msgpack_pzbuffer_write(void* data, const char* buf, size_t len);
+
+/**
+ * Compresses the pending input, waits for all the workers and terminates
+ * the stream. Returns the compressed data, or NULL on failure.
+ */
+static inline char* msgpack_pzbuffer_flush(msgpack_pzbuffer* pzbuf);
+
+static inline const char* msgpack_pzbuffer_data(const msgpack_pzbuffer* pzbuf);
+static inline size_t msgpack_pzbuffer_size(const msgpack_pzbuffer* pzbuf);
+
+static inline bool msgpack_pzbuffer_reset(msgpack_pzbuffer* pzbuf);
+/* the caller frees the result with msgpack_allocator_free(NULL, ...) */
+static inline char* msgpack_pzbuffer_release_buffer(msgpack_pzbuffer* pzbuf);
+
+/**
+ * Gets the backpressure counters, accumulated since initialization.
+ */
+static inline void msgpack_pzbuffer_get_stats(const msgpack_pzbuffer* pzbuf,
+        msgpack_pzbuffer_stats* stats);
+
+/** @} */
+
+
+static inline bool msgpack_pzbuffer_append(msgpack_pzbuffer* pzbuf, const char* buf, size_t len)
+{
+    if(pzbuf->alloc - pzbuf->size < len) {
+        size_t nsize = pzbuf->alloc ? pzbuf->alloc * 2 : pzbuf->block_size;
+        char* tmp;
+        while(nsize < pzbuf->size + len) {
+            nsize *= 2;
+        }
+        tmp = (char*)msgpack_allocator_realloc(NULL, pzbuf->data, nsize);
+        if(tmp == NULL) {
+            return false;
+        }
+        pzbuf->data = tmp;
+        pzbuf->alloc = nsize;
+    }
+    memcpy(pzbuf->data + pzbuf->size, buf, len);
+    pzbuf->size += len;
+    return true;
+}
+
+static inline bool msgpack_pzbuffer_header(msgpack_pzbuffer* pzbuf)
+{
+    /* RFC 1950: CM = deflate, CINFO = 32 KiB window, FLEVEL from the level */
+    unsigned int flg;
+    char header[2];
+    if(pzbuf->level == 1) {
+        flg = 0;
+    } else if(pzbuf->level >= 2 && pzbuf->level <= 5) {
+        flg = 1;
+    } else if(pzbuf->level == 6 || pzbuf->level == Z_DEFAULT_COMPRESSION) {
+        flg = 2;
+    } else {
+        flg = 3;
+    }
+    flg <<= 6;
+    flg += 31 - (0x78 * 256 + flg) % 31;
+    header[0] = (char)0x78;
+    header[1] = (char)flg;
+    return msgpack_pzbuffer_append(pzbuf, header, 2);
+}
+
+static inline bool msgpack_pzbuffer_run(z_stream* stream, msgpack_pzbuffer_job* job, int flush)
+{
+    int ret;
+
+    if(job->out_alloc < deflateBound(stream, (uLong)job->in_size) + 16) {
+        size_t nsize = deflateBound(stream, (uLong)job->in_size) + 16;
+        char* tmp = (char*)msgpack_allocator_realloc(NULL, job->out, nsize);
+        if(tmp == NULL) {
+            return false;
+        }
+        job->out = tmp;
+        job->out_alloc = nsize;
+    }
+
+    stream->next_in = (Bytef*)job->in;
+    stream->avail_in = (uInt)job->in_size;
+    stream->next_out = (Bytef*)job->out;
+    stream->avail_out = (uInt)job->out_alloc;
+
+    while(true) {
+        ret = deflate(stream, flush);
+        if(ret == Z_STREAM_END) {
+            break;
+        }
+        if(ret != Z_OK && ret != Z_BUF_ERROR) {
+            return false;
+        }
+        if(stream->avail_out != 0 && stream->avail_in == 0 && flush != Z_FINISH) {
+            break;
+        }
+        if(stream->avail_out == 0) {
+            size_t used = job->out_alloc;
+            char* tmp = (char*)msgpack_allocator_realloc(NULL, job->out, used * 2);
+            if(tmp == NULL) {
+                return false;
+            }
+            job->out = tmp;
+            job->out_alloc = used * 2;
+            stream->next_out = (Bytef*)(tmp + used);
+            stream->avail_out = (uInt)used;
+        }
+    }
+
+    job->out_size = (size_t)((char*)stream->next_out - job->out);
+    return true;
+}
+
+static inline bool msgpack_pzbuffer_deflate(z_stream* stream, msgpack_pzbuffer_job* job)
+{
+    if(deflateReset(stream) != Z_OK) {
+        return false;
+    }
+    if(job->dict_size > 0 &&
+            deflateSetDictionary(stream, (const Bytef*)job->dict, (uInt)job->dict_size) != Z_OK) {
+        return false;
+    }
+    if(!msgpack_pzbuffer_run(stream, job, job->last ? Z_FINISH : Z_SYNC_FLUSH)) {
+        return false;
+    }
+    job->check = adler32(adler32(0L, Z_NULL, 0), (const Bytef*)job->in, (uInt)job->in_size);
+    return true;
+}
+
+/* pipelined mode: the blocks continue the zlib stream of the previous one */
+static inline bool msgpack_pzbuffer_deflate_next(z_stream* stream, msgpack_pzbuffer_job* job)
+{
+    if(job->first && deflateReset(stream) != Z_OK) {
+        return false;
+    }
+    return msgpack_pzbuffer_run(stream, job, job->last ? Z_FINISH : Z_NO_FLUSH);
+}
+
+static inline uint64_t msgpack_pzbuffer_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+static inline void* msgpack_pzbuffer_worker(void* arg)
+{
+    msgpack_pzbuffer* pzbuf = (msgpack_pzbuffer*)arg;
+    z_stream stream;
+    bool ok;
+    bool deflated;
+
+    memset(&stream, 0, sizeof(stream));
+    ok = deflateInit2(&stream, pzbuf->level, Z_DEFLATED, pzbuf->pipelined ? 15 : -15,
+            8, Z_DEFAULT_STRATEGY) == Z_OK;
+
+    pthread_mutex_lock(&pzbuf->lock);
+    while(true) {
+        msgpack_pzbuffer_job* job;
+        while(!pzbuf->shutdown && pzbuf->next == pzbuf->tail) {
+            pthread_cond_wait(&pzbuf->work, &pzbuf->lock);
+        }
+        if(pzbuf->next == pzbuf->tail) {
+            break;
+        }
+        job = &pzbuf->jobs[pzbuf->next % pzbuf->njobs];
+        ++pzbuf->next;
+        pthread_mutex_unlock(&pzbuf->lock);
+
+        deflated = ok && (pzbuf->pipelined ?
+            msgpack_pzbuffer_deflate_next(&stream, job) :
+            msgpack_pzbuffer_deflate(&stream, job));
+
+        pthread_mutex_lock(&pzbuf->lock);
+        job->state = deflated ? MSGPACK_PZBUFFER_JOB_DONE : MSGPACK_PZBUFFER_JOB_ERROR;
+        pthread_cond_broadcast(&pzbuf->done);
+    }
+    pthread_mutex_unlock(&pzbuf->lock);
+
+    if(ok) {
+        deflateEnd(&stream);
+    }
+    return NULL;
+}
+
+/* appends the compressed blocks in order until all the jobs before 'until'
+ * are collected; the waits of the producer are counted as stalls */
+static inline bool msgpack_pzbuffer_collect(msgpack_pzbuffer* pzbuf, size_t until, int stall)
+{
+    uint64_t start = 0;
+    bool ret = true;
+
+    while(pzbuf->head != pzbuf->tail) {
+        msgpack_pzbuffer_job* job = &pzbuf->jobs[pzbuf->head % pzbuf->njobs];
+
+        pthread_mutex_lock(&pzbuf->lock);
+        while(job->state == MSGPACK_PZBUFFER_JOB_QUEUED) {
+            if(pzbuf->head >= until) {
+                pthread_mutex_unlock(&pzbuf->lock);
+                goto out;
+            }
+            if(stall && start == 0) {
+                start = msgpack_pzbuffer_now();
+            }
+            pthread_cond_wait(&pzbuf->done, &pzbuf->lock);
+        }
+        pthread_mutex_unlock(&pzbuf->lock);
+
+        if(job->state == MSGPACK_PZBUFFER_JOB_ERROR ||
+                !msgpack_pzbuffer_append(pzbuf, job->out, job->out_size)) {
+            ret = false;
+            goto out;
+        }
+        if(!pzbuf->pipelined) {
+            pzbuf->check = adler32_combine(pzbuf->check, job->check, (z_off_t)job->in_size);
+        }
+        job->state = MSGPACK_PZBUFFER_JOB_FREE;
+        ++pzbuf->head;
+    }
+
+out:
+    if(start != 0) {
+        ++pzbuf->stats.stalls;
+        pzbuf->stats.stall_ns += msgpack_pzbuffer_now() - start;
+    }
+    return ret;
+}
+
+static inline void msgpack_pzbuffer_submit(msgpack_pzbuffer* pzbuf, int last)
+{
+    msgpack_pzbuffer_job* job = &pzbuf->jobs[pzbuf->tail % pzbuf->njobs];
+
+    job->last = last;
+    job->first = pzbuf->tail == pzbuf->first;
+    job->dict = NULL;
+    job->dict_size = 0;
+    if(!pzbuf->pipelined && !job->first) {
+        /* the previous slot is not reused before this job is collected */
+        const msgpack_pzbuffer_job* prev = &pzbuf->jobs[(pzbuf->tail - 1) % pzbuf->njobs];
+        job->dict_size = prev->in_size < MSGPACK_PZBUFFER_DICT_SIZE ?
+            prev->in_size : MSGPACK_PZBUFFER_DICT_SIZE;
+        job->dict = prev->in + prev->in_size - job->dict_size;
+    }
+
+    pzbuf->filling = 0;
+
+    pthread_mutex_lock(&pzbuf->lock);
+    job->state = MSGPACK_PZBUFFER_JOB_QUEUED;
+    ++pzbuf->tail;
+    pthread_cond_signal(&pzbuf->work);
+    pthread_mutex_unlock(&pzbuf->lock);
+
+    /* before the next acquire collects: a full queue shows as njobs */
+    if(pzbuf->stats.max_queue_depth < pzbuf->tail - pzbuf->head) {
+        pzbuf->stats.max_queue_depth = pzbuf->tail - pzbuf->head;
+    }
+
+    ++pzbuf->stats.blocks;
+}
+
+/* makes the slot of pzbuf->tail available to the producer */
+static inline bool msgpack_pzbuffer_acquire(msgpack_pzbuffer* pzbuf)
+{
+    size_t until;
+    if(pzbuf->filling) {
+        return true;
+    }
+    /* the slot can be refilled once its previous job, and the next one
+     * which reads it as dictionary, have been collected; pipelined blocks
+     * have no dictionary */
+    until = pzbuf->tail + (pzbuf->pipelined ? 1 : 2);
+    until = until > pzbuf->njobs ? until - pzbuf->njobs : 0;
+    if(!msgpack_pzbuffer_collect(pzbuf, until, 1)) {
+        return false;
+    }
+    pzbuf->jobs[pzbuf->tail % pzbuf->njobs].in_size = 0;
+    pzbuf->filling = 1;
+    return true;
+}
+
+static inline bool msgpack_pzbuffer_start(msgpack_pzbuffer* pzbuf,
+        int level, size_t block_size, size_t nthreads, size_t njobs, int pipelined)
+{
+    size_t i;
+
+    memset(pzbuf, 0, sizeof(msgpack_pzbuffer));
+    if(block_size == 0) {
+        block_size = MSGPACK_PZBUFFER_BLOCK_SIZE;
+    }
+    if(block_size < MSGPACK_PZBUFFER_DICT_SIZE) {
+        block_size = MSGPACK_PZBUFFER_DICT_SIZE;
+    }
+    pzbuf->level = level;
+    pzbuf->block_size = block_size;
+    pzbuf->pipelined = pipelined;
+    pzbuf->njobs = njobs;
+    pzbuf->check = adler32(0L, Z_NULL, 0);
+
+    pzbuf->jobs = (msgpack_pzbuffer_job*)msgpack_allocator_malloc(NULL, pzbuf->njobs * sizeof(msgpack_pzbuffer_job));
+    if(pzbuf->jobs == NULL) {
+        return false;
+    }
+    memset(pzbuf->jobs, 0, pzbuf->njobs * sizeof(msgpack_pzbuffer_job));
+    for(i = 0; i < pzbuf->njobs; ++i) {
+        pzbuf->jobs[i].in = (char*)msgpack_allocator_malloc(NULL, block_size);
+        if(pzbuf->jobs[i].in == NULL) {
+            goto failed;
+        }
+    }
+    if(!pipelined && !msgpack_pzbuffer_header(pzbuf)) {
+        goto failed;
+    }
+
+    pzbuf->threads = (pthread_t*)msgpack_allocator_malloc(NULL, sizeof(pthread_t) * nthreads);
+    if(pzbuf->threads == NULL) {
+        goto failed;
+    }
+    pthread_mutex_init(&pzbuf->lock, NULL);
+    pthread_cond_init(&pzbuf->work, NULL);
+    pthread_cond_init(&pzbuf->done, NULL);
+    for(i = 0; i < nthreads; ++i) {
+        if(pthread_create(&pzbuf->threads[i], NULL, msgpack_pzbuffer_worker, pzbuf) != 0) {
+            break;
+        }
+        ++pzbuf->nthreads;
+    }
+    if(pzbuf->nthreads == 0) {
+        msgpack_pzbuffer_destroy(pzbuf);
+        return false;
+    }
+    return true;
+
+failed:
+    for(i = 0; i < pzbuf->njobs; ++i) {
+        msgpack_allocator_free(NULL, pzbuf->jobs[i].in);
+    }
+    msgpack_allocator_free(NULL, pzbuf->jobs);
+    msgpack_allocator_free(NULL, pzbuf->data);
+    return false;
+}
+
+static inline bool msgpack_pzbuffer_init(msgpack_pzbuffer* pzbuf,
+        int level, size_t block_size, size_t nthreads)
+{
+    if(nthreads == 0) {
+        long n = sysconf(_SC_NPROCESSORS_ONLN);
+        nthreads = n > 0 ? (size_t)n : 1;
+    }
+    return msgpack_pzbuffer_start(pzbuf, level, block_size, nthreads, nthreads * 2 + 1, 0);
+}
+
+static inline bool msgpack_pzbuffer_init_pipelined(msgpack_pzbuffer* pzbuf,
+        int level, size_t block_size, size_t queue_depth)
+{
+    if(queue_depth == 0) {
+        queue_depth = MSGPACK_PZBUFFER_QUEUE_DEPTH;
+    }
+    /* one more slot for the block being filled by the producer */
+    return msgpack_pzbuffer_start(pzbuf, level, block_size, 1, queue_depth + 1, 1);
+}
+
+static inline void msgpack_pzbuffer_destroy(msgpack_pzbuffer* pzbuf)
+{
+    size_t i;
+
+    pthread_mutex_lock(&pzbuf->lock);
+    pzbuf->shutdown = 1;
+    pthread_cond_broadcast(&pzbuf->work);
+    pthread_mutex_unlock(&pzbuf->lock);
+    for(i = 0; i < pzbuf->nthreads; ++i) {
+        pthread_join(pzbuf->threads[i], NULL);
+    }
+    msgpack_allocator_free(NULL, pzbuf->threads);
+    pthread_cond_destroy(&pzbuf->done);
+    pthread_cond_destroy(&pzbuf->work);
+    pthread_mutex_destroy(&pzbuf->lock);
+
+    for(i = 0; i < pzbuf->njobs; ++i) {
+        msgpack_allocator_free(NULL, pzbuf->jobs[i].in);
+        msgpack_allocator_free(NULL, pzbuf->jobs[i].out);
+    }
+    msgpack_allocator_free(NULL, pzbuf->jobs);
+    msgpack_allocator_free(NULL, pzbuf->data);
+}
+
+static inline msgpack_pzbuffer* msgpack_pzbuffer_new(int level, size_t block_size, size_t nthreads)
+{
+    msgpack_pzbuffer* pzbuf = (msgpack_pzbuffer*)msgpack_allocator_malloc(NULL, sizeof(msgpack_pzbuffer));
+    if (pzbuf == NULL) return NULL;
+    if(!msgpack_pzbuffer_init(pzbuf, level, block_size, nthreads)) {
+        msgpack_allocator_free(NULL, pzbuf);
+        return NULL;
+    }
+    return pzbuf;
+}
+
+static inline void msgpack_pzbuffer_free(msgpack_pzbuffer* pzbuf)
+{
+    if(pzbuf == NULL) { return; }
+    msgpack_pzbuffer_destroy(pzbuf);
+    msgpack_allocator_free(NULL, pzbuf);
+}
+
+static inline int msgpack_pzbuffer_write(void* data, const char* buf, size_t len)
+{
+    msgpack_pzbuffer* pzbuf = (msgpack_pzbuffer*)data;
+
+    assert(buf || len == 0);
+    if(!buf) return 0;
+    if(pzbuf->finished) return -1;
+
+    while(len > 0) {
+        msgpack_pzbuffer_job* job;
+        size_t n;
+
+        if(!msgpack_pzbuffer_acquire(pzbuf)) {
+            return -1;
+        }
+        job = &pzbuf->jobs[pzbuf->tail % pzbuf->njobs];
+        n = pzbuf->block_size - job->in_size;
+        if(n > len) {
+            n = len;
+        }
+        memcpy(job->in + job->in_size, buf, n);
+        job->in_size += n;
+        buf += n;
+        len -= n;
+
+        if(job->in_size == pzbuf->block_size) {
+            msgpack_pzbuffer_submit(pzbuf, 0);
+        }
+    }
+
+    return 0;
+}
+
+static inline char* msgpack_pzbuffer_flush(msgpack_pzbuffer* pzbuf)
+{
+    char trailer[4];
+
+    if(pzbuf->finished) {
+        return pzbuf->data;
+    }
+    if(!msgpack_pzbuffer_acquire(pzbuf)) {
+        return NULL;
+    }
+    msgpack_pzbuffer_submit(pzbuf, 1);
+    if(!msgpack_pzbuffer_collect(pzbuf, pzbuf->tail, 0)) {
+        return NULL;
+    }
+    if(pzbuf->pipelined) {
+        pzbuf->finished = 1;
+        return pzbuf->data;
+    }
+
+    trailer[0] = (char)(pzbuf->check >> 24);
+    trailer[1] = (char)(pzbuf->check >> 16);
+    trailer[2] = (char)(pzbuf->check >> 8);
+    trailer[3] = (char)pzbuf->check;
+    if(!msgpack_pzbuffer_append(pzbuf, trailer, 4)) {
+        return NULL;
+    }
+    pzbuf->finished = 1;
+    return pzbuf->data;
+}
+
+static inline const char* msgpack_pzbuffer_data(const msgpack_pzbuffer* pzbuf)
+{
+    return pzbuf->data;
+}
+
+static inline size_t msgpack_pzbuffer_size(const msgpack_pzbuffer* pzbuf)
+{
+    return pzbuf->size;
+}
+
+static inline bool msgpack_pzbuffer_reset(msgpack_pzbuffer* pzbuf)
+{
+    if(!msgpack_pzbuffer_collect(pzbuf, pzbuf->tail, 0)) {
+        return false;
+    }
+    pzbuf->filling = 0;
+    pzbuf->first = pzbuf->tail;
+    pzbuf->check = adler32(0L, Z_NULL, 0);
+    pzbuf->finished = 0;
+    pzbuf->size = 0;
+    return pzbuf->pipelined || msgpack_pzbuffer_header(pzbuf);
+}
+
+static inline char* msgpack_pzbuffer_release_buffer(msgpack_pzbuffer* pzbuf)
+{
+    char* tmp = pzbuf->data;
+    pzbuf->data = NULL;
+    pzbuf->size = 0;
+    pzbuf->alloc = 0;
+    return tmp;
+}
+
+static inline void msgpack_pzbuffer_get_stats(const msgpack_pzbuffer* pzbuf,
+        msgpack_pzbuffer_stats* stats)
+{
+    *stats = pzbuf->stats;
+    stats->queue_depth = pzbuf->tail - pzbuf->head;
+}
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* !defined(_WIN32) */
+
+#endif /* msgpack/pzbuffer.h */
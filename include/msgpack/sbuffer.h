@@ -10,6 +10,7 @@
 #ifndef MSGPACK_SBUFFER_H
 #define MSGPACK_SBUFFER_H
 
+#include "allocator.h"
 #include <stdlib.h>
 #include <string.h>
 #include <assert.h>
@@ -29,6 +30,7 @@ typedef struct msgpack_sbuffer {
     size_t size;
     char* data;
     size_t alloc;
+    const msgpack_allocator* allocator;     /* NULL for the default */
 } msgpack_sbuffer;
 
 static inline void msgpack_sbuffer_init(msgpack_sbuffer* sbuf)
@@ -36,21 +38,38 @@ static inline void msgpack_sbuffer_init(msgpack_sbuffer* sbuf)
     memset(sbuf, 0, sizeof(msgpack_sbuffer));
 }
 
+/**
+ * The data of the buffer, including the result of msgpack_sbuffer_release(),
+ * is allocated by allocator.
+ */
+static inline void msgpack_sbuffer_init_with_allocator(msgpack_sbuffer* sbuf,
+        const msgpack_allocator* allocator)
+{
+    memset(sbuf, 0, sizeof(msgpack_sbuffer));
+    sbuf->allocator = allocator;
+}
+
 static inline void msgpack_sbuffer_destroy(msgpack_sbuffer* sbuf)
 {
-    free(sbuf->data);
+    if(sbuf->data != NULL) {
+        msgpack_allocator_free(sbuf->allocator, sbuf->data);
+    }
 }
 
 static inline msgpack_sbuffer* msgpack_sbuffer_new(void)
 {
-    return (msgpack_sbuffer*)calloc(1, sizeof(msgpack_sbuffer));
+    msgpack_sbuffer* sbuf = (msgpack_sbuffer*)msgpack_allocator_malloc(NULL, sizeof(msgpack_sbuffer));
+    if(sbuf != NULL) {
+        msgpack_sbuffer_init(sbuf);
+    }
+    return sbuf;
 }
 
 static inline void msgpack_sbuffer_free(msgpack_sbuffer* sbuf)
 {
     if(sbuf == NULL) { return; }
     msgpack_sbuffer_destroy(sbuf);
-    free(sbuf);
+    msgpack_allocator_free(NULL, sbuf);
 }
 
 #ifndef MSGPACK_SBUFFER_INIT_SIZE
@@ -78,7 +97,7 @@ static inline int msgpack_sbuffer_write(void* data, const char* buf, size_t len)
             nsize = tmp_nsize;
         }
 
-        tmp = realloc(sbuf->data, nsize);
+        tmp = msgpack_allocator_realloc(sbuf->allocator, sbuf->data, nsize);
         if(!tmp) { return -1; }
 
         sbuf->data = (char*)tmp;
@@ -0,0 +1,138 @@
+/*
+ * MessagePack for C structural index
+ *
+ *    Distributed under the Boost Software License, Version 1.0.
+ *    (See accompanying file LICENSE_1_0.txt or copy at
+ *    http://www.boost.org/LICENSE_1_0.txt)
+ */
+#ifndef MSGPACK_TAPE_H
+#define MSGPACK_TAPE_H
+
+#include "unpack.h"
+#include "cursor.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/**
+ * @defgroup msgpack_tape Structural index
+ * @ingroup msgpack
+ * @{
+ */
+
+/*
+ * A tape lists the objects of a packed document in order (depth first) in
+ * one flat array. Containers also own a run of the children array holding
+ * the tape indexes of their elements (keys and values alternate for maps),
+ * so the Nth element of any container, or the entry after a subtree, is
+ * found in O(1). The tape only stores offsets: values are read from the
+ * packed data, e.g. through msgpack_tape_cursor().
+ */
+
+#define MSGPACK_TAPE_NONE ((uint32_t)-1)
+
+typedef struct msgpack_tape_entry {
+    uint64_t offset;    /* byte offset of the object */
+    uint64_t end;       /* byte offset after the object and its subtree */
+    uint32_t size;      /* elements of an array, pairs of a map, bytes of a body */
+    uint32_t next;      /* tape index after the subtree */
+    uint32_t child;     /* first slot in children, containers only */
+    uint32_t type;      /* msgpack_object_type */
+} msgpack_tape_entry;
+
+typedef struct msgpack_tape {
+    msgpack_tape_entry* entries;
+    size_t count;
+    size_t alloc;
+    uint32_t* children;
+    size_t nchildren;
+    size_t children_alloc;
+    uint64_t data_len;  /* end offset of the indexed object */
+} msgpack_tape;
+
+MSGPACK_DLLEXPORT
+void msgpack_tape_init(msgpack_tape* tape);
+MSGPACK_DLLEXPORT
+void msgpack_tape_destroy(msgpack_tape* tape);
+
+/**
+ * Indexes the object at data + off in one pass, replacing the content of tape.
+ * Returns MSGPACK_UNPACK_SUCCESS, MSGPACK_UNPACK_CONTINUE if the object is
+ * truncated, MSGPACK_UNPACK_PARSE_ERROR or MSGPACK_UNPACK_NOMEM_ERROR.
+ */
+MSGPACK_DLLEXPORT
+msgpack_unpack_return msgpack_tape_build(msgpack_tape* tape,
+        const char* data, size_t len, size_t off);
+
+static inline const msgpack_tape_entry* msgpack_tape_at(const msgpack_tape* tape, uint32_t index);
+
+/**
+ * Gets the tape index of the Nth element of the container at index; for a
+ * map, 2N is the Nth key and 2N+1 its value.
+ * Returns MSGPACK_TAPE_NONE if out of range or not a container.
+ */
+static inline uint32_t msgpack_tape_child(const msgpack_tape* tape, uint32_t index, uint32_t n);
+
+/**
+ * Looks up a str key in the map at index, comparing the keys in data.
+ * Returns the tape index of the value, or MSGPACK_TAPE_NONE.
+ */
+MSGPACK_DLLEXPORT
+uint32_t msgpack_tape_find_key(const msgpack_tape* tape, const char* data,
+        uint32_t index, const char* key, size_t size);
+
+/**
+ * Points cur at the object of the entry at index.
+ */
+MSGPACK_DLLEXPORT
+bool msgpack_tape_cursor(const msgpack_tape* tape, const char* data, uint32_t index,
+        msgpack_cursor* cur);
+
+/**
+ * Serializes the tape through a write callback such as msgpack_sbuffer_write.
+ * The format is native (byte order and layout are checked by
+ * msgpack_tape_load), meant to cache the index next to the data.
+ */
+MSGPACK_DLLEXPORT
+int msgpack_tape_save(const msgpack_tape* tape,
+        int (*write)(void* data, const char* buf, size_t len), void* data);
+
+/**
+ * Loads a tape saved by msgpack_tape_save, replacing the content of tape.
+ * Returns false if buf is not a tape of this platform or is truncated.
+ * Compare tape->data_len with the data before using the tape.
+ */
+MSGPACK_DLLEXPORT
+bool msgpack_tape_load(msgpack_tape* tape, const char* buf, size_t len);
+
+/** @} */
+
+
+static inline const msgpack_tape_entry* msgpack_tape_at(const msgpack_tape* tape, uint32_t index)
+{
+    return index < tape->count ? &tape->entries[index] : NULL;
+}
+
+static inline uint32_t msgpack_tape_child(const msgpack_tape* tape, uint32_t index, uint32_t n)
+{
+    const msgpack_tape_entry* e = msgpack_tape_at(tape, index);
+    if(e == NULL) {
+        return MSGPACK_TAPE_NONE;
+    }
+    if(e->type == MSGPACK_OBJECT_ARRAY && n < e->size) {
+        return tape->children[e->child + n];
+    }
+    if(e->type == MSGPACK_OBJECT_MAP && n < (uint64_t)e->size * 2) {
+        return tape->children[e->child + n];
+    }
+    return MSGPACK_TAPE_NONE;
+}
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* msgpack/tape.h */
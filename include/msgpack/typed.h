@@ -0,0 +1,137 @@
+/*
+ * MessagePack for C typed array decoding
+ *
+ *    Distributed under the Boost Software License, Version 1.0.
+ *    (See accompanying file LICENSE_1_0.txt or copy at
+ *    http://www.boost.org/LICENSE_1_0.txt)
+ */
+#ifndef MSGPACK_TYPED_H
+#define MSGPACK_TYPED_H
+
+#include "unpack.h"
+#include "cursor.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/**
+ * @defgroup msgpack_typed Typed arrays
+ * @ingroup msgpack_unpack
+ * @{
+ */
+
+/*
+ * Numeric arrays decoded straight into C arrays, without a msgpack_object
+ * per element. Runs of elements encoded with the same type byte are decoded
+ * by a loop specialized for that width.
+ * int64 arrays accept every integer that fits in int64_t. double and float
+ * arrays accept floats and integers, like msgpack_cursor_as_double(); float
+ * arrays round float64 elements.
+ */
+
+/**
+ * Decodes the array at data + *off into out.
+ * Returns MSGPACK_UNPACK_SUCCESS (or MSGPACK_UNPACK_EXTRA_BYTES if data
+ * follows) with *count elements and *off after the array.
+ * Otherwise *off is unchanged and:
+ * - MSGPACK_UNPACK_NOMEM_ERROR: the array has *count elements, more than cap.
+ * - MSGPACK_UNPACK_CONTINUE: the array is truncated.
+ * - MSGPACK_UNPACK_PARSE_ERROR: the data is invalid, the object is not an
+ *   array or the element at index *count does not conform; the elements
+ *   before it are decoded.
+ */
+MSGPACK_DLLEXPORT
+msgpack_unpack_return
+msgpack_unpack_int64_array(const char* data, size_t len, size_t* off,
+        int64_t* out, size_t cap, size_t* count);
+MSGPACK_DLLEXPORT
+msgpack_unpack_return
+msgpack_unpack_double_array(const char* data, size_t len, size_t* off,
+        double* out, size_t cap, size_t* count);
+MSGPACK_DLLEXPORT
+msgpack_unpack_return
+msgpack_unpack_float_array(const char* data, size_t len, size_t* off,
+        float* out, size_t cap, size_t* count);
+
+/**
+ * Decodes up to cap elements of the array at cur into out.
+ * Returns the number of elements decoded: it stops at the first element
+ * that does not conform or is truncated, so a result smaller than both cap
+ * and the array size is the index of that element.
+ * Returns 0 if cur is not on an array.
+ */
+MSGPACK_DLLEXPORT
+size_t msgpack_cursor_int64_array(const msgpack_cursor* cur, int64_t* out, size_t cap);
+MSGPACK_DLLEXPORT
+size_t msgpack_cursor_double_array(const msgpack_cursor* cur, double* out, size_t cap);
+MSGPACK_DLLEXPORT
+size_t msgpack_cursor_float_array(const msgpack_cursor* cur, float* out, size_t cap);
+
+
+/*
+ * Arrays of maps with the same str keys, decoded into one typed array per
+ * selected key (struct of arrays), e.g. [{"ts": .., "id": .., "v": ..}, ...]
+ * into int64_t ts[], int64_t id[] and double v[].
+ */
+
+typedef enum {
+    MSGPACK_COLUMN_INT64,   /* int64_t */
+    MSGPACK_COLUMN_DOUBLE,  /* double */
+    MSGPACK_COLUMN_FLOAT,   /* float */
+    MSGPACK_COLUMN_BOOL,    /* bool */
+    MSGPACK_COLUMN_STR      /* msgpack_object_str pointing into the data */
+} msgpack_column_type;
+
+typedef struct msgpack_column {
+    const char* key;
+    size_t key_size;
+    msgpack_column_type type;
+    void* values;       /* one element per row */
+    bool* present;      /* optional, see msgpack_columns_unpack */
+} msgpack_column;
+
+typedef struct msgpack_columns {
+    msgpack_column* columns;
+    size_t count;
+    uint32_t* order;    /* column of each key position, from the last rows */
+    size_t order_size;
+    size_t order_alloc;
+    size_t* seen;       /* row + 1 when the column was last set */
+} msgpack_columns;
+
+/**
+ * Binds the columns, which must outlive cols. Returns false when memory
+ * runs out.
+ */
+MSGPACK_DLLEXPORT
+bool msgpack_columns_init(msgpack_columns* cols, msgpack_column* columns, size_t count);
+MSGPACK_DLLEXPORT
+void msgpack_columns_destroy(msgpack_columns* cols);
+
+/**
+ * Decodes the array of maps at data + *off into the columns, row i going to
+ * the ith element of each column. Keys without a column are skipped.
+ * The key order of the rows is cached: while it repeats, each key is only
+ * compared with the key of the column expected at its position.
+ * A key that is missing or nil in a row is an error if the column has no
+ * present array; otherwise present[row] is set to false and the value is
+ * zeroed.
+ * Returns the same values as msgpack_unpack_int64_array, with rows in place
+ * of count: on MSGPACK_UNPACK_PARSE_ERROR, *rows is the index of the first
+ * row that does not conform.
+ */
+MSGPACK_DLLEXPORT
+msgpack_unpack_return
+msgpack_columns_unpack(msgpack_columns* cols, const char* data, size_t len, size_t* off,
+        size_t cap, size_t* rows);
+
+/** @} */
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* msgpack/typed.h */
@@ -11,7 +11,9 @@
 #define MSGPACK_UNPACKER_H
 
 #include "zone.h"
+#include "allocator.h"
 #include "object.h"
+#include "vrefbuffer.h"
 #include <string.h>
 
 #ifdef __cplusplus
@@ -28,6 +30,7 @@ extern "C" {
 typedef struct msgpack_unpacked {
     msgpack_zone* zone;
     msgpack_object data;
+    msgpack_zone_pool* pool;    /* where zone goes back, if any */
 } msgpack_unpacked;
 
 typedef enum {
@@ -44,6 +47,59 @@ msgpack_unpack_return
 msgpack_unpack_next(msgpack_unpacked* result,
         const char* data, size_t len, size_t* off);
 
+/**
+ * Skips the next complete object without building it.
+ * Returns MSGPACK_UNPACK_SUCCESS and sets *off after the object,
+ * MSGPACK_UNPACK_CONTINUE if the object is truncated (*off is unchanged), or
+ * MSGPACK_UNPACK_PARSE_ERROR on an invalid type byte.
+ */
+MSGPACK_DLLEXPORT
+msgpack_unpack_return
+msgpack_skip(const char* data, size_t len, size_t* off);
+
+/**
+ * Gets the size in bytes of the object at the beginning of data without
+ * building it. If the object is truncated, returns MSGPACK_UNPACK_CONTINUE
+ * and sets *size to a lower bound of its size, so that a reader knows how
+ * much more to wait for.
+ */
+MSGPACK_DLLEXPORT
+msgpack_unpack_return
+msgpack_measure(const char* data, size_t len, size_t* size);
+
+/**
+ * Gets the size of the block msgpack_unpack_contiguous() needs for the
+ * object at data + off, counting its arrays and maps in one pass.
+ * Returns MSGPACK_UNPACK_SUCCESS, MSGPACK_UNPACK_CONTINUE,
+ * MSGPACK_UNPACK_PARSE_ERROR or MSGPACK_UNPACK_NOMEM_ERROR.
+ */
+MSGPACK_DLLEXPORT
+msgpack_unpack_return
+msgpack_unpack_contiguous_size(const char* data, size_t len, size_t off, size_t* size);
+
+/**
+ * Unpacks like msgpack_unpack, but lays out every array and kv array of the
+ * tree in buf, in preorder: a container's elements come right before the
+ * elements of its first child container. buf must be aligned like the
+ * result of malloc and hold msgpack_unpack_contiguous_size() bytes, or
+ * MSGPACK_UNPACK_NOMEM_ERROR is returned. str, bin and ext point into data.
+ * The whole tree is freed as one block; a copy of the block needs its
+ * array and map pointers rebased.
+ */
+MSGPACK_DLLEXPORT
+msgpack_unpack_return
+msgpack_unpack_contiguous(const char* data, size_t len, size_t* off,
+        void* buf, size_t size, msgpack_object* obj);
+
+/**
+ * msgpack_unpack_contiguous with the block allocated from zone in one
+ * msgpack_zone_malloc call.
+ */
+MSGPACK_DLLEXPORT
+msgpack_unpack_return
+msgpack_unpack_contiguous_zone(const char* data, size_t len, size_t* off,
+        msgpack_zone* zone, msgpack_object* obj);
+
 /** @} */
 
 
@@ -76,6 +132,28 @@ typedef struct msgpack_unpacker {
 MSGPACK_DLLEXPORT
 bool msgpack_unpacker_init(msgpack_unpacker* mpac, size_t initial_buffer_size);
 
+/**
+ * Initializes a streaming deserializer whose buffers are allocated by
+ * allocator. Its zones come from the default allocator or its zone pool.
+ */
+MSGPACK_DLLEXPORT
+bool msgpack_unpacker_init_with_allocator(msgpack_unpacker* mpac, size_t initial_buffer_size,
+        const msgpack_allocator* allocator);
+
+/**
+ * Initializes a streaming deserializer over a fixed ring of ring_size bytes
+ * (rounded up to the page size), mapped twice back to back so that the
+ * buffer is always contiguous. The space of parsed messages is reclaimed
+ * without copying once no unpacked result references it, so
+ * msgpack_unpacker_reserve_buffer() fails instead of growing while results
+ * hold the ring full: destroy them, or msgpack_unpacker_release_zone(), and
+ * retry. A message must fit in the ring.
+ * Returns false if the ring cannot be mapped, or where the platform lacks
+ * memfd_create (only Linux has it).
+ */
+MSGPACK_DLLEXPORT
+bool msgpack_unpacker_init_ring(msgpack_unpacker* mpac, size_t ring_size);
+
 /**
  * Destroys a streaming deserializer initialized by msgpack_unpacker_init(msgpack_unpacker*, size_t).
  */
@@ -96,6 +174,55 @@ msgpack_unpacker* msgpack_unpacker_new(size_t initial_buffer_size);
 MSGPACK_DLLEXPORT
 void msgpack_unpacker_free(msgpack_unpacker* mpac);
 
+/**
+ * Makes the unpacker take the zones of its messages from pool, and
+ * msgpack_unpacked_destroy() put them back, cleared, for the next messages.
+ * The unpacker holds a reference on pool; NULL detaches it.
+ * The results must be destroyed on the thread that uses pool.
+ */
+MSGPACK_DLLEXPORT
+void msgpack_unpacker_set_zone_pool(msgpack_unpacker* mpac, msgpack_zone_pool* pool);
+
+/**
+ * Selects atomic (the default) or plain reference counting for the buffers
+ * shared by the unpacker and the results referencing them. Plain counting
+ * requires the results to be destroyed on the thread that uses the
+ * unpacker, or with external synchronization.
+ */
+MSGPACK_DLLEXPORT
+void msgpack_unpacker_set_atomic_refcount(msgpack_unpacker* mpac, bool atomic);
+
+/**
+ * Gives back a buffer pushed by msgpack_unpacker_push_buffer() or
+ * msgpack_unpacker_push_iovec(), called once per buffer.
+ */
+typedef void (*msgpack_unpacker_release)(void* ctx, const char* data, size_t size);
+
+/**
+ * Queues size bytes at data, owned by the caller, to be parsed in place
+ * by msgpack_unpacker_next() instead of copying them into the internal
+ * buffer. str, bin and ext objects point into data, and release(ctx, data,
+ * size) is called once the unpacker has parsed it and the last result
+ * referencing it is destroyed, possibly from msgpack_unpacked_destroy() or
+ * msgpack_unpacker_destroy(). release may be NULL.
+ * An element split between two buffers is copied into the zone of its
+ * result; the bytes around it are not.
+ * Do not mix with msgpack_unpacker_buffer_consumed() on the same stream.
+ * Returns false, without queuing data, if memory runs out.
+ */
+MSGPACK_DLLEXPORT
+bool msgpack_unpacker_push_buffer(msgpack_unpacker* mpac, const char* data, size_t size,
+        msgpack_unpacker_release release, void* ctx);
+
+/**
+ * Queues the iovcnt buffers of iov, e.g. filled by readv() or recvmmsg(),
+ * as msgpack_unpacker_push_buffer() does. release is called for each of
+ * them. Returns false, without queuing any of them, if memory runs out.
+ */
+MSGPACK_DLLEXPORT
+bool msgpack_unpacker_push_iovec(msgpack_unpacker* mpac, const msgpack_iovec* iov, size_t iovcnt,
+        msgpack_unpacker_release release, void* ctx);
+
 
 #ifndef MSGPACK_UNPACKER_RESERVE_SIZE
 #define MSGPACK_UNPACKER_RESERVE_SIZE (32*1024)
@@ -158,6 +285,51 @@ msgpack_unpack_return msgpack_unpacker_next_with_size(msgpack_unpacker* mpac,
                                                       msgpack_unpacked* result,
                                                       size_t *p_bytes);
 
+
+#ifndef MSGPACK_UNPACKER_READ_SIZE_MAX
+#define MSGPACK_UNPACKER_READ_SIZE_MAX (1024*1024)
+#endif
+
+typedef enum {
+    MSGPACK_UNPACKER_READ_OK            =  1,
+    MSGPACK_UNPACKER_READ_AGAIN         =  0,
+    MSGPACK_UNPACKER_READ_EOF           = -1,
+    MSGPACK_UNPACKER_READ_ERROR         = -2,
+    MSGPACK_UNPACKER_READ_NOMEM_ERROR   = -3
+} msgpack_unpacker_read_return;
+
+/**
+ * Reads from fd straight into the buffer, in one read() retried on EINTR.
+ * The read size adapts to the stream: it doubles while reads fill it and
+ * follows the sizes of the messages yielded by msgpack_unpacker_read_next(),
+ * between 4 KiB and MSGPACK_UNPACKER_READ_SIZE_MAX, capped by max_bytes
+ * unless it is 0.
+ * Returns MSGPACK_UNPACKER_READ_OK when bytes were read,
+ * MSGPACK_UNPACKER_READ_AGAIN when a non-blocking fd has none yet,
+ * MSGPACK_UNPACKER_READ_EOF at the end of the stream,
+ * MSGPACK_UNPACKER_READ_ERROR with errno set, or
+ * MSGPACK_UNPACKER_READ_NOMEM_ERROR when the buffer cannot grow.
+ * Not available on Windows, where it returns MSGPACK_UNPACKER_READ_ERROR.
+ */
+MSGPACK_DLLEXPORT
+msgpack_unpacker_read_return
+msgpack_unpacker_read_fd(msgpack_unpacker* mpac, int fd, size_t max_bytes);
+
+/**
+ * Iterates over the messages completed by the bytes read so far, like
+ * msgpack_unpacker_next(), and records their sizes for
+ * msgpack_unpacker_read_fd():
+ *
+ *   while(msgpack_unpacker_read_fd(&unp, fd, 0) == MSGPACK_UNPACKER_READ_OK) {
+ *       while(msgpack_unpacker_read_next(&unp, &result) == MSGPACK_UNPACK_SUCCESS) {
+ *           ...
+ *       }
+ *   }
+ */
+MSGPACK_DLLEXPORT
+msgpack_unpack_return msgpack_unpacker_read_next(msgpack_unpacker* mpac,
+                                                 msgpack_unpacked* result);
+
 /**
  * Initializes a msgpack_unpacked object.
  * The initialized object must be destroyed by msgpack_unpacked_destroy(msgpack_unpacker*).
@@ -257,7 +429,13 @@ static inline void msgpack_unpacked_init(msgpack_unpacked* result)
 static inline void msgpack_unpacked_destroy(msgpack_unpacked* result)
 {
     if(result->zone != NULL) {
-        msgpack_zone_free(result->zone);
+        if(result->pool != NULL) {
+            msgpack_zone_pool_put(result->pool, result->zone);
+            result->pool = NULL;
+        }
+        else {
+            msgpack_zone_free(result->zone);
+        }
         result->zone = NULL;
         memset(&result->data, 0, sizeof(msgpack_object));
     }
@@ -268,6 +446,9 @@ static inline msgpack_zone* msgpack_unpacked_release_zone(msgpack_unpacked* resu
     if(result->zone != NULL) {
         msgpack_zone* z = result->zone;
         result->zone = NULL;
+        /* the zone leaves the pool for good */
+        msgpack_zone_pool_release(result->pool);
+        result->pool = NULL;
         return z;
     }
     return NULL;
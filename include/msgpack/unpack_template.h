@@ -144,7 +144,12 @@ msgpack_unpack_func(int, _execute)(msgpack_unpack_struct(_context)* ctx, const c
         } /* FIXME */ \
         ret = msgpack_unpack_callback(func)(user, count_, &stack[top].obj); \
         if(ret < 0) { goto _failed; } \
-        if((count_) == 0) { obj = stack[top].obj; goto _push; } \
+        if((count_) == 0) { \
+            ret = msgpack_unpack_callback(func ## _end)(user, &stack[top].obj); \
+            if(ret < 0) { goto _failed; } \
+            obj = stack[top].obj; \
+            goto _push; \
+        } \
         stack[top].ct = ct_; \
         stack[top].count = count_; \
         ++top; \
@@ -391,6 +396,8 @@ msgpack_unpack_func(int, _execute)(msgpack_unpack_struct(_context)* ctx, const c
             ret = msgpack_unpack_callback(_array_item)(user, &c->obj, obj); \
             if(ret < 0) { goto _failed; }
             if(--c->count == 0) {
+                ret = msgpack_unpack_callback(_array_end)(user, &c->obj);
+                if(ret < 0) { goto _failed; }
                 obj = c->obj;
                 --top;
                 /*printf("stack pop %d\n", top);*/
@@ -405,6 +412,8 @@ msgpack_unpack_func(int, _execute)(msgpack_unpack_struct(_context)* ctx, const c
             ret = msgpack_unpack_callback(_map_item)(user, &c->obj, c->map_key, obj); \
             if(ret < 0) { goto _failed; }
             if(--c->count == 0) {
+                ret = msgpack_unpack_callback(_map_end)(user, &c->obj);
+                if(ret < 0) { goto _failed; }
                 obj = c->obj;
                 --top;
                 /*printf("stack pop %d\n", top);*/
@@ -11,6 +11,7 @@
 #define MSGPACK_VREFBUFFER_H
 
 #include "zone.h"
+#include "allocator.h"
 #include <stdlib.h>
 #include <assert.h>
 
@@ -54,6 +55,7 @@ typedef struct msgpack_vrefbuffer {
     size_t ref_size;
 
     msgpack_vrefbuffer_inner_buffer inner_buffer;
+    const msgpack_allocator* allocator;     /* NULL for the default */
 } msgpack_vrefbuffer;
 
 
@@ -71,6 +73,13 @@ bool msgpack_vrefbuffer_init(msgpack_vrefbuffer* vbuf,
 MSGPACK_DLLEXPORT
 void msgpack_vrefbuffer_destroy(msgpack_vrefbuffer* vbuf);
 
+/**
+ * The vectors and the chunks of copied data are allocated by allocator.
+ */
+MSGPACK_DLLEXPORT
+bool msgpack_vrefbuffer_init_with_allocator(msgpack_vrefbuffer* vbuf,
+        size_t ref_size, size_t chunk_size, const msgpack_allocator* allocator);
+
 static inline msgpack_vrefbuffer* msgpack_vrefbuffer_new(size_t ref_size, size_t chunk_size);
 static inline void msgpack_vrefbuffer_free(msgpack_vrefbuffer* vbuf);
 
@@ -87,6 +96,10 @@ MSGPACK_DLLEXPORT
 int msgpack_vrefbuffer_append_ref(msgpack_vrefbuffer* vbuf,
         const char* buf, size_t len);
 
+/**
+ * Moves the contents of vbuf to the end of to. Both buffers must use the
+ * same allocator.
+ */
 MSGPACK_DLLEXPORT
 int msgpack_vrefbuffer_migrate(msgpack_vrefbuffer* vbuf, msgpack_vrefbuffer* to);
 
@@ -98,10 +111,10 @@ void msgpack_vrefbuffer_clear(msgpack_vrefbuffer* vref);
 
 static inline msgpack_vrefbuffer* msgpack_vrefbuffer_new(size_t ref_size, size_t chunk_size)
 {
-    msgpack_vrefbuffer* vbuf = (msgpack_vrefbuffer*)malloc(sizeof(msgpack_vrefbuffer));
+    msgpack_vrefbuffer* vbuf = (msgpack_vrefbuffer*)msgpack_allocator_malloc(NULL, sizeof(msgpack_vrefbuffer));
     if (vbuf == NULL) return NULL;
     if(!msgpack_vrefbuffer_init(vbuf, ref_size, chunk_size)) {
-        free(vbuf);
+        msgpack_allocator_free(NULL, vbuf);
         return NULL;
     }
     return vbuf;
@@ -111,7 +124,7 @@ static inline void msgpack_vrefbuffer_free(msgpack_vrefbuffer* vbuf)
 {
     if(vbuf == NULL) { return; }
     msgpack_vrefbuffer_destroy(vbuf);
-    free(vbuf);
+    msgpack_allocator_free(NULL, vbuf);
 }
 
 static inline int msgpack_vrefbuffer_write(void* data, const char* buf, size_t len)
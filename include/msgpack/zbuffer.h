@@ -11,6 +11,7 @@
 #define MSGPACK_ZBUFFER_H
 
 #include "sysdep.h"
+#include "allocator.h"
 #include <stdlib.h>
 #include <string.h>
 #include <assert.h>
@@ -51,6 +52,7 @@ static inline size_t msgpack_zbuffer_size(const msgpack_zbuffer* zbuf);
 
 static inline bool msgpack_zbuffer_reset(msgpack_zbuffer* zbuf);
 static inline void msgpack_zbuffer_reset_buffer(msgpack_zbuffer* zbuf);
+/* the caller frees the result with msgpack_allocator_free(NULL, ...) */
 static inline char* msgpack_zbuffer_release_buffer(msgpack_zbuffer* zbuf);
 
 
@@ -69,7 +71,7 @@ static inline bool msgpack_zbuffer_init(msgpack_zbuffer* zbuf,
     memset(zbuf, 0, sizeof(msgpack_zbuffer));
     zbuf->init_size = init_size;
     if(deflateInit(&zbuf->stream, level) != Z_OK) {
-        free(zbuf->data);
+        msgpack_allocator_free(NULL, zbuf->data);
         return false;
     }
     return true;
@@ -78,15 +80,15 @@ static inline bool msgpack_zbuffer_init(msgpack_zbuffer* zbuf,
 static inline void msgpack_zbuffer_destroy(msgpack_zbuffer* zbuf)
 {
     deflateEnd(&zbuf->stream);
-    free(zbuf->data);
+    msgpack_allocator_free(NULL, zbuf->data);
 }
 
 static inline msgpack_zbuffer* msgpack_zbuffer_new(int level, size_t init_size)
 {
-    msgpack_zbuffer* zbuf = (msgpack_zbuffer*)malloc(sizeof(msgpack_zbuffer));
+    msgpack_zbuffer* zbuf = (msgpack_zbuffer*)msgpack_allocator_malloc(NULL, sizeof(msgpack_zbuffer));
     if (zbuf == NULL) return NULL;
     if(!msgpack_zbuffer_init(zbuf, level, init_size)) {
-        free(zbuf);
+        msgpack_allocator_free(NULL, zbuf);
         return NULL;
     }
     return zbuf;
@@ -96,7 +98,7 @@ static inline void msgpack_zbuffer_free(msgpack_zbuffer* zbuf)
 {
     if(zbuf == NULL) { return; }
     msgpack_zbuffer_destroy(zbuf);
-    free(zbuf);
+    msgpack_allocator_free(NULL, zbuf);
 }
 
 static inline bool msgpack_zbuffer_expand(msgpack_zbuffer* zbuf)
@@ -106,7 +108,7 @@ static inline bool msgpack_zbuffer_expand(msgpack_zbuffer* zbuf)
 
     size_t nsize = (csize == 0) ? zbuf->init_size : csize * 2;
 
-    char* tmp = (char*)realloc(zbuf->data, nsize);
+    char* tmp = (char*)msgpack_allocator_realloc(NULL, zbuf->data, nsize);
     if(tmp == NULL) {
         return false;
     }
@@ -43,10 +43,21 @@ typedef struct msgpack_zone_chunk_list {
     msgpack_zone_chunk* head;
 } msgpack_zone_chunk_list;
 
+/**
+ * Source of the chunks of a zone, in place of the default allocator.
+ * free receives the size passed to alloc.
+ */
+typedef struct msgpack_zone_chunk_provider {
+    void* (*alloc)(void* ctx, size_t size);
+    void (*free)(void* ctx, void* ptr, size_t size);
+    void* ctx;
+} msgpack_zone_chunk_provider;
+
 typedef struct msgpack_zone {
     msgpack_zone_chunk_list chunk_list;
     msgpack_zone_finalizer_array finalizer_array;
     size_t chunk_size;
+    const msgpack_zone_chunk_provider* provider;
 } msgpack_zone;
 
 #ifndef MSGPACK_ZONE_CHUNK_SIZE
@@ -63,6 +74,34 @@ msgpack_zone* msgpack_zone_new(size_t chunk_size);
 MSGPACK_DLLEXPORT
 void msgpack_zone_free(msgpack_zone* zone);
 
+/**
+ * Zones whose chunks come from provider, which must outlive them. The zone
+ * itself is still allocated by the default allocator.
+ */
+MSGPACK_DLLEXPORT
+bool msgpack_zone_init_with_provider(msgpack_zone* zone, size_t chunk_size,
+        const msgpack_zone_chunk_provider* provider);
+MSGPACK_DLLEXPORT
+msgpack_zone* msgpack_zone_new_with_provider(size_t chunk_size,
+        const msgpack_zone_chunk_provider* provider);
+
+/**
+ * Chunk provider that hands out chunks linearly from one virtual region of
+ * reserve bytes mapped with mmap(), backed by transparent huge pages when
+ * huge_pages is true and the system supports them. A chunk freed at the top
+ * of the region is reused at once; when every chunk has been freed, the
+ * pages are given back with madvise(MADV_DONTNEED) and the region starts
+ * over, still mapped. Chunks that do not fit come from the default allocator.
+ * The provider is not thread-safe; zones using it must be destroyed before
+ * msgpack_zone_mmap_provider_destroy().
+ * Returns false if memory cannot be mapped or mmap() is not available.
+ */
+MSGPACK_DLLEXPORT
+bool msgpack_zone_mmap_provider_init(msgpack_zone_chunk_provider* provider,
+        size_t reserve, bool huge_pages);
+MSGPACK_DLLEXPORT
+void msgpack_zone_mmap_provider_destroy(msgpack_zone_chunk_provider* provider);
+
 static inline void* msgpack_zone_malloc(msgpack_zone* zone, size_t size);
 static inline void* msgpack_zone_malloc_no_align(msgpack_zone* zone, size_t size);
 
@@ -77,6 +116,131 @@ bool msgpack_zone_is_empty(msgpack_zone* zone);
 MSGPACK_DLLEXPORT
 void msgpack_zone_clear(msgpack_zone* zone);
 
+/**
+ * Allocation state of a zone, for discarding what a speculative decode
+ * allocated without clearing the whole zone.
+ */
+typedef struct msgpack_zone_marker {
+    msgpack_zone_chunk* head;
+    char* ptr;
+    size_t free;
+    size_t finalizers;
+} msgpack_zone_marker;
+
+static inline msgpack_zone_marker msgpack_zone_mark(const msgpack_zone* zone);
+
+/**
+ * Calls the finalizers pushed after mark, frees the chunks allocated after
+ * it and rewinds the zone to it. A marker is invalidated by
+ * msgpack_zone_clear(), msgpack_zone_swap() and the rollback to an earlier
+ * marker.
+ */
+MSGPACK_DLLEXPORT
+void msgpack_zone_rollback(msgpack_zone* zone, const msgpack_zone_marker* mark);
+
+
+/**
+ * Cache of cleared zones, so that a stream of short-lived zones does not
+ * allocate and free a zone and its first chunk each time.
+ * A pool is reference counted: msgpack_zone_pool_new() returns the first
+ * reference and every zone taken from the pool holds one until it is put
+ * back, so the pool may be released before its zones.
+ * A pool is not thread-safe.
+ */
+typedef struct msgpack_zone_pool msgpack_zone_pool;
+
+typedef struct msgpack_zone_pool_stats {
+    size_t hits;        /* zones taken from the cache */
+    size_t misses;      /* zones created */
+    size_t returns;     /* zones put back */
+    size_t frees;       /* zones freed by a full pool or by trimming */
+    size_t cached;      /* zones in the cache */
+    size_t max_cached;  /* high-water mark of cached */
+} msgpack_zone_pool_stats;
+
+#ifndef MSGPACK_ZONE_POOL_TRIM_INTERVAL
+#define MSGPACK_ZONE_POOL_TRIM_INTERVAL 1024
+#endif
+
+/**
+ * Creates a pool of zones of chunk_size holding at most max_zones cleared
+ * zones. Every MSGPACK_ZONE_POOL_TRIM_INTERVAL returns, the zones that
+ * stayed cached during the whole interval are freed.
+ */
+MSGPACK_DLLEXPORT
+msgpack_zone_pool* msgpack_zone_pool_new(size_t chunk_size, size_t max_zones);
+MSGPACK_DLLEXPORT
+void msgpack_zone_pool_retain(msgpack_zone_pool* pool);
+MSGPACK_DLLEXPORT
+void msgpack_zone_pool_release(msgpack_zone_pool* pool);
+
+/**
+ * Takes a zone from the pool, or creates one. Returns NULL when memory runs
+ * out.
+ */
+MSGPACK_DLLEXPORT
+msgpack_zone* msgpack_zone_pool_get(msgpack_zone_pool* pool);
+
+/**
+ * Clears zone, keeping its first chunk, and caches it; a zone of another
+ * chunk size or one that does not fit is freed. Drops the reference of the
+ * zone on the pool.
+ */
+MSGPACK_DLLEXPORT
+void msgpack_zone_pool_put(msgpack_zone_pool* pool, msgpack_zone* zone);
+
+/**
+ * Frees cached zones until at most keep are left.
+ */
+MSGPACK_DLLEXPORT
+void msgpack_zone_pool_trim(msgpack_zone_pool* pool, size_t keep);
+
+MSGPACK_DLLEXPORT
+void msgpack_zone_pool_get_stats(const msgpack_zone_pool* pool, msgpack_zone_pool_stats* stats);
+
+
+/**
+ * Per-thread cache of zone chunks of MSGPACK_ZONE_CHUNK_SIZE bytes, built
+ * when the library is configured with MSGPACK_ZONE_CHUNK_CACHE (POSIX
+ * threads only). Each thread keeps up to a limit of freed chunks without
+ * locking; the excess goes to a depot shared by all threads, bounded too.
+ * Chunks left in a magazine go to the depot when their thread exits.
+ */
+typedef struct msgpack_zone_chunk_cache_stats {
+    size_t hits;            /* chunks taken from a magazine or the depot */
+    size_t misses;          /* chunks allocated */
+    size_t bytes_cached;    /* in the depot and the magazines */
+} msgpack_zone_chunk_cache_stats;
+
+#ifndef MSGPACK_ZONE_CHUNK_CACHE_THREAD_LIMIT
+#define MSGPACK_ZONE_CHUNK_CACHE_THREAD_LIMIT 16
+#endif
+
+#ifndef MSGPACK_ZONE_CHUNK_CACHE_DEPOT_LIMIT
+#define MSGPACK_ZONE_CHUNK_CACHE_DEPOT_LIMIT 256
+#endif
+
+/**
+ * Sets the number of chunks each thread and the depot may hold, and frees
+ * the depot chunks over its new limit. A thread limit of 0 disables the
+ * cache. Returns false if the cache is not built.
+ */
+MSGPACK_DLLEXPORT
+bool msgpack_zone_chunk_cache_set_limits(size_t thread_limit, size_t depot_limit);
+
+/**
+ * Moves the chunks cached by the calling thread to the depot.
+ */
+MSGPACK_DLLEXPORT
+void msgpack_zone_chunk_cache_flush(void);
+
+/**
+ * The counters of each thread are added when it visits the depot, exits or
+ * calls msgpack_zone_chunk_cache_flush(), so they lag behind busy threads.
+ */
+MSGPACK_DLLEXPORT
+void msgpack_zone_chunk_cache_get_stats(msgpack_zone_chunk_cache_stats* stats);
+
 /** @} */
 
 
@@ -148,6 +312,16 @@ static inline bool msgpack_zone_push_finalizer(msgpack_zone* zone,
     return true;
 }
 
+static inline msgpack_zone_marker msgpack_zone_mark(const msgpack_zone* zone)
+{
+    msgpack_zone_marker mark;
+    mark.head = zone->chunk_list.head;
+    mark.ptr = zone->chunk_list.ptr;
+    mark.free = zone->chunk_list.free;
+    mark.finalizers = (size_t)(zone->finalizer_array.tail - zone->finalizer_array.array);
+    return mark;
+}
+
 static inline void msgpack_zone_swap(msgpack_zone* a, msgpack_zone* b)
 {
     msgpack_zone tmp = *a;
@@ -0,0 +1,168 @@
+/*
+ * MessagePack for C inflating deserializer implementation
+ *
+ *    Distributed under the Boost Software License, Version 1.0.
+ *    (See accompanying file LICENSE_1_0.txt or copy at
+ *    http://www.boost.org/LICENSE_1_0.txt)
+ */
+#ifndef MSGPACK_ZUNPACKER_H
+#define MSGPACK_ZUNPACKER_H
+
+#include "unpack.h"
+#include <string.h>
+#include <zlib.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/**
+ * @defgroup msgpack_zunpacker Compressed streaming deserializer
+ * @ingroup msgpack_unpack
+ * @{
+ */
+
+/*
+ * Reads the zlib (or gzip) streams written by msgpack_zbuffer and
+ * msgpack_pzbuffer. The compressed input is inflated straight into the free
+ * space of the embedded msgpack_unpacker, so objects spanning several inflate
+ * outputs are completed in place without an intermediate buffer.
+ * Concatenated streams, such as the output of a msgpack_zbuffer that has been
+ * reset, are read one after the other.
+ */
+typedef struct msgpack_zunpacker {
+    msgpack_unpacker unpacker;
+    z_stream stream;
+    size_t reserve_size;    /* minimum free space inflated into at a time */
+} msgpack_zunpacker;
+
+#ifndef MSGPACK_ZUNPACKER_RESERVE_SIZE
+#define MSGPACK_ZUNPACKER_RESERVE_SIZE 4096
+#endif
+
+/**
+ * Initializes a compressed streaming deserializer.
+ * @param initial_buffer_size initial buffer size of the embedded msgpack_unpacker
+ */
+static inline bool msgpack_zunpacker_init(msgpack_zunpacker* zunp, size_t initial_buffer_size);
+static inline void msgpack_zunpacker_destroy(msgpack_zunpacker* zunp);
+
+static inline msgpack_zunpacker* msgpack_zunpacker_new(size_t initial_buffer_size);
+static inline void msgpack_zunpacker_free(msgpack_zunpacker* zunp);
+
+/**
+ * Sets the compressed input. The input is not copied: it must stay valid
+ * until msgpack_zunpacker_next returns MSGPACK_UNPACK_CONTINUE, which means
+ * it has been consumed entirely and more input is needed.
+ */
+static inline void msgpack_zunpacker_feed(msgpack_zunpacker* zunp, const char* buf, size_t len);
+
+/**
+ * Deserializes one object, inflating more input as needed.
+ * Returns MSGPACK_UNPACK_PARSE_ERROR on corrupted compressed data.
+ * @param result  pointer to an initialized msgpack_unpacked object.
+ */
+static inline msgpack_unpack_return msgpack_zunpacker_next(msgpack_zunpacker* zunp,
+        msgpack_unpacked* result);
+
+/**
+ * Gets the number of compressed bytes not consumed yet.
+ */
+static inline size_t msgpack_zunpacker_pending(const msgpack_zunpacker* zunp);
+
+/** @} */
+
+
+static inline bool msgpack_zunpacker_init(msgpack_zunpacker* zunp, size_t initial_buffer_size)
+{
+    memset(zunp, 0, sizeof(msgpack_zunpacker));
+    zunp->reserve_size = MSGPACK_ZUNPACKER_RESERVE_SIZE;
+    /* 15 + 32: zlib or gzip header, detected automatically */
+    if(inflateInit2(&zunp->stream, 15 + 32) != Z_OK) {
+        return false;
+    }
+    if(!msgpack_unpacker_init(&zunp->unpacker, initial_buffer_size)) {
+        inflateEnd(&zunp->stream);
+        return false;
+    }
+    return true;
+}
+
+static inline void msgpack_zunpacker_destroy(msgpack_zunpacker* zunp)
+{
+    msgpack_unpacker_destroy(&zunp->unpacker);
+    inflateEnd(&zunp->stream);
+}
+
+static inline msgpack_zunpacker* msgpack_zunpacker_new(size_t initial_buffer_size)
+{
+    msgpack_zunpacker* zunp = (msgpack_zunpacker*)msgpack_allocator_malloc(NULL, sizeof(msgpack_zunpacker));
+    if (zunp == NULL) return NULL;
+    if(!msgpack_zunpacker_init(zunp, initial_buffer_size)) {
+        msgpack_allocator_free(NULL, zunp);
+        return NULL;
+    }
+    return zunp;
+}
+
+static inline void msgpack_zunpacker_free(msgpack_zunpacker* zunp)
+{
+    if(zunp == NULL) { return; }
+    msgpack_zunpacker_destroy(zunp);
+    msgpack_allocator_free(NULL, zunp);
+}
+
+static inline void msgpack_zunpacker_feed(msgpack_zunpacker* zunp, const char* buf, size_t len)
+{
+    zunp->stream.next_in = (Bytef*)buf;
+    zunp->stream.avail_in = (uInt)len;
+}
+
+static inline msgpack_unpack_return msgpack_zunpacker_next(msgpack_zunpacker* zunp,
+        msgpack_unpacked* result)
+{
+    msgpack_unpacker* const mpac = &zunp->unpacker;
+
+    while(true) {
+        size_t avail;
+        int ret = msgpack_unpacker_next(mpac, result);
+        if(ret != MSGPACK_UNPACK_CONTINUE || zunp->stream.avail_in == 0) {
+            return (msgpack_unpack_return)ret;
+        }
+
+        if(!msgpack_unpacker_reserve_buffer(mpac, zunp->reserve_size)) {
+            return MSGPACK_UNPACK_NOMEM_ERROR;
+        }
+        avail = msgpack_unpacker_buffer_capacity(mpac);
+        if(avail > (uInt)-1) {
+            avail = (uInt)-1;
+        }
+        zunp->stream.next_out = (Bytef*)msgpack_unpacker_buffer(mpac);
+        zunp->stream.avail_out = (uInt)avail;
+
+        ret = inflate(&zunp->stream, Z_NO_FLUSH);
+        msgpack_unpacker_buffer_consumed(mpac, avail - zunp->stream.avail_out);
+
+        if(ret == Z_STREAM_END) {
+            /* a new stream may follow */
+            if(inflateReset(&zunp->stream) != Z_OK) {
+                return MSGPACK_UNPACK_PARSE_ERROR;
+            }
+        } else if(ret != Z_OK && ret != Z_BUF_ERROR) {
+            return MSGPACK_UNPACK_PARSE_ERROR;
+        }
+    }
+}
+
+static inline size_t msgpack_zunpacker_pending(const msgpack_zunpacker* zunp)
+{
+    return zunp->stream.avail_in;
+}
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* msgpack/zunpacker.h */
@@ -0,0 +1,48 @@
+/*
+ * MessagePack for C allocator hooks
+ *
+ *    Distributed under the Boost Software License, Version 1.0.
+ *    (See accompanying file LICENSE_1_0.txt or copy at
+ *    http://www.boost.org/LICENSE_1_0.txt)
+ */
+#include "msgpack/allocator.h"
+#include <stdlib.h>
+
+static void* libc_malloc(void* ctx, size_t size)
+{
+    (void)ctx;
+    return malloc(size);
+}
+
+static void* libc_realloc(void* ctx, void* ptr, size_t size)
+{
+    (void)ctx;
+    return realloc(ptr, size);
+}
+
+static void libc_free(void* ctx, void* ptr)
+{
+    (void)ctx;
+    free(ptr);
+}
+
+static const msgpack_allocator libc_allocator = {
+    libc_malloc, libc_realloc, libc_free, NULL
+};
+
+static const msgpack_allocator* default_allocator = &libc_allocator;
+
+void msgpack_allocator_set_default(const msgpack_allocator* allocator)
+{
+    default_allocator = allocator ? allocator : &libc_allocator;
+}
+
+const msgpack_allocator* msgpack_allocator_get_default(void)
+{
+    return default_allocator;
+}
+
+const msgpack_allocator* msgpack_allocator_libc(void)
+{
+    return &libc_allocator;
+}
@@ -0,0 +1,178 @@
+/*
+ * MessagePack for C contiguous unpacking routine
+ *
+ *    Distributed under the Boost Software License, Version 1.0.
+ *    (See accompanying file LICENSE_1_0.txt or copy at
+ *    http://www.boost.org/LICENSE_1_0.txt)
+ */
+#include "msgpack/unpack.h"
+#include "msgpack/cursor.h"
+#include "msgpack/unpack_define.h"
+#include <stdlib.h>
+
+typedef struct {
+    msgpack_object* slot;   /* next element to fill, NULL when counting */
+    size_t remaining;
+} contiguous_frame;
+
+/*
+ * Walks the valid object in [off, end) in byte order, which is preorder.
+ * A map of n pairs is an array of 2n objects: msgpack_object_kv is a key
+ * and a value object. When root is NULL only *objects is computed, else
+ * the objects are stored in root and block.
+ */
+static msgpack_unpack_return contiguous_walk(const char* data, size_t end, size_t off,
+        msgpack_object* root, msgpack_object* block, size_t* objects)
+{
+    contiguous_frame* stack;
+    size_t depth = 1;
+    size_t alloc = MSGPACK_EMBED_STACK_SIZE;
+    size_t pos = off;
+    msgpack_object tmp;
+
+    stack = (contiguous_frame*)msgpack_allocator_malloc(NULL, alloc * sizeof(contiguous_frame));
+    if(stack == NULL) {
+        return MSGPACK_UNPACK_NOMEM_ERROR;
+    }
+    stack[0].slot = root;
+    stack[0].remaining = 1;
+    *objects = 0;
+
+    while(depth > 0) {
+        contiguous_frame* f = &stack[depth - 1];
+        msgpack_cursor cur;
+        msgpack_object* o;
+        size_t n;
+
+        if(f->remaining == 0) {
+            --depth;
+            continue;
+        }
+        --f->remaining;
+        o = root != NULL ? f->slot++ : &tmp;
+
+        msgpack_cursor_init(&cur, data, end, pos);
+        msgpack_cursor_peek(&cur, o);
+        if(o->type == MSGPACK_OBJECT_ARRAY) {
+            n = o->via.array.size;
+        }
+        else if(o->type == MSGPACK_OBJECT_MAP) {
+            n = (size_t)o->via.map.size * 2;
+        }
+        else {
+            msgpack_skip(data, end, &pos);
+            continue;
+        }
+
+        {
+            msgpack_cursor child;
+            msgpack_cursor_enter(&cur, &child);
+            pos = child.pos;
+        }
+        if(n == 0) {
+            continue;
+        }
+        if(root != NULL) {
+            if(o->type == MSGPACK_OBJECT_ARRAY) {
+                o->via.array.ptr = block + *objects;
+            }
+            else {
+                o->via.map.ptr = (msgpack_object_kv*)(block + *objects);
+            }
+        }
+        *objects += n;
+
+        if(depth == alloc) {
+            contiguous_frame* nstack = (contiguous_frame*)msgpack_allocator_realloc(NULL, stack,
+                    alloc * 2 * sizeof(contiguous_frame));
+            if(nstack == NULL) {
+                msgpack_allocator_free(NULL, stack);
+                return MSGPACK_UNPACK_NOMEM_ERROR;
+            }
+            stack = nstack;
+            alloc *= 2;
+        }
+        stack[depth].slot = root != NULL ? block + *objects - n : NULL;
+        stack[depth].remaining = n;
+        ++depth;
+    }
+
+    msgpack_allocator_free(NULL, stack);
+    return MSGPACK_UNPACK_SUCCESS;
+}
+
+msgpack_unpack_return
+msgpack_unpack_contiguous_size(const char* data, size_t len, size_t off, size_t* size)
+{
+    size_t end = off;
+    size_t objects;
+    msgpack_unpack_return ret = msgpack_skip(data, len, &end);
+    if(ret != MSGPACK_UNPACK_SUCCESS) {
+        return ret;
+    }
+    ret = contiguous_walk(data, end, off, NULL, NULL, &objects);
+    if(ret != MSGPACK_UNPACK_SUCCESS) {
+        return ret;
+    }
+    *size = objects * sizeof(msgpack_object);
+    return MSGPACK_UNPACK_SUCCESS;
+}
+
+static msgpack_unpack_return contiguous_unpack(const char* data, size_t len, size_t* off,
+        void* buf, size_t size, msgpack_zone* zone, msgpack_object* obj)
+{
+    size_t noff = 0;
+    size_t end;
+    size_t objects;
+    msgpack_unpack_return ret;
+
+    if(off != NULL) { noff = *off; }
+
+    end = noff;
+    ret = msgpack_skip(data, len, &end);
+    if(ret != MSGPACK_UNPACK_SUCCESS) {
+        return ret;
+    }
+    ret = contiguous_walk(data, end, noff, NULL, NULL, &objects);
+    if(ret != MSGPACK_UNPACK_SUCCESS) {
+        return ret;
+    }
+
+    if(zone != NULL) {
+        size = objects * sizeof(msgpack_object);
+        /* msgpack_zone_malloc aligns like the unpacker's own allocations */
+        buf = size > 0 ? msgpack_zone_malloc(zone, size) : NULL;
+        if(size > 0 && buf == NULL) {
+            return MSGPACK_UNPACK_NOMEM_ERROR;
+        }
+    }
+    else if(size / sizeof(msgpack_object) < objects) {
+        return MSGPACK_UNPACK_NOMEM_ERROR;
+    }
+
+    ret = contiguous_walk(data, end, noff, obj, (msgpack_object*)buf, &objects);
+    if(ret != MSGPACK_UNPACK_SUCCESS) {
+        return ret;
+    }
+
+    if(off != NULL) { *off = end; }
+
+    if(end < len) {
+        return MSGPACK_UNPACK_EXTRA_BYTES;
+    }
+    return MSGPACK_UNPACK_SUCCESS;
+}
+
+msgpack_unpack_return
+msgpack_unpack_contiguous(const char* data, size_t len, size_t* off,
+        void* buf, size_t size, msgpack_object* obj)
+{
+    return contiguous_unpack(data, len, off, buf, size, NULL, obj);
+}
+
+msgpack_unpack_return
+msgpack_unpack_contiguous_zone(const char* data, size_t len, size_t* off,
+        msgpack_zone* zone, msgpack_object* obj)
+{
+    return contiguous_unpack(data, len, off, NULL, 0, zone, obj);
+}
@@ -0,0 +1,412 @@
+/*
+ * MessagePack for C lazy cursor
+ *
+ *    Distributed under the Boost Software License, Version 1.0.
+ *    (See accompanying file LICENSE_1_0.txt or copy at
+ *    http://www.boost.org/LICENSE_1_0.txt)
+ */
+#include "msgpack/cursor.h"
+#include "msgpack/unpack.h"
+#include "msgpack/sysdep.h"
+#include <string.h>
+
+
+static inline uint64_t cursor_load(const unsigned char* p, size_t size)
+{
+    switch(size) {
+    case 1:
+        return *p;
+    case 2: {
+        uint16_t tmp;
+        _msgpack_load16(uint16_t, p, &tmp);
+        return tmp;
+    }
+    case 4: {
+        uint32_t tmp;
+        _msgpack_load32(uint32_t, p, &tmp);
+        return tmp;
+    }
+    default: {
+        uint64_t tmp;
+        _msgpack_load64(uint64_t, p, &tmp);
+        return tmp;
+    }
+    }
+}
+
+/* decodes the header of the current object, *hdr gets its length */
+static bool cursor_head(const msgpack_cursor* cur, msgpack_object* obj, size_t* hdr)
+{
+    const unsigned char* p;
+    size_t avail;
+    size_t lsize = 0;   /* bytes of the length field of str, bin, ext, array and map */
+    unsigned int b;
+
+    if(!msgpack_cursor_valid(cur)) {
+        return false;
+    }
+    p = (const unsigned char*)cur->data + cur->pos;
+    avail = cur->len - cur->pos;
+    b = *p;
+    *hdr = 1;
+
+    if(b <= 0x7f) {
+        obj->type = MSGPACK_OBJECT_POSITIVE_INTEGER;
+        obj->via.u64 = b;
+        return true;
+    }
+    if(b >= 0xe0) {
+        obj->type = MSGPACK_OBJECT_NEGATIVE_INTEGER;
+        obj->via.i64 = (int8_t)b;
+        return true;
+    }
+    if(b <= 0x8f) {
+        obj->type = MSGPACK_OBJECT_MAP;
+        obj->via.map.size = b & 0x0f;
+        obj->via.map.ptr = NULL;
+        return true;
+    }
+    if(b <= 0x9f) {
+        obj->type = MSGPACK_OBJECT_ARRAY;
+        obj->via.array.size = b & 0x0f;
+        obj->via.array.ptr = NULL;
+        return true;
+    }
+    if(b <= 0xbf) {
+        obj->type = MSGPACK_OBJECT_STR;
+        obj->via.str.size = b & 0x1f;
+        obj->via.str.ptr = (const char*)p + 1;
+        return avail >= 1 + (size_t)obj->via.str.size;
+    }
+
+    switch(b) {
+    case 0xc0:
+        obj->type = MSGPACK_OBJECT_NIL;
+        return true;
+    case 0xc2:
+    case 0xc3:
+        obj->type = MSGPACK_OBJECT_BOOLEAN;
+        obj->via.boolean = b == 0xc3;
+        return true;
+    case 0xca:
+    case 0xcb: {
+        size_t size = b == 0xca ? 4 : 8;
+        if(avail < 1 + size) { return false; }
+        *hdr = 1 + size;
+        if(size == 4) {
+            union { uint32_t i; float f; } mem;
+            mem.i = (uint32_t)cursor_load(p + 1, 4);
+            obj->type = MSGPACK_OBJECT_FLOAT32;
+            obj->via.f64 = mem.f;
+        }
+        else {
+            union { uint64_t i; double f; } mem;
+            mem.i = cursor_load(p + 1, 8);
+            obj->type = MSGPACK_OBJECT_FLOAT64;
+            obj->via.f64 = mem.f;
+        }
+        return true;
+    }
+    case 0xcc:
+    case 0xcd:
+    case 0xce:
+    case 0xcf: {
+        size_t size = (size_t)1 << (b & 0x03);
+        if(avail < 1 + size) { return false; }
+        *hdr = 1 + size;
+        obj->type = MSGPACK_OBJECT_POSITIVE_INTEGER;
+        obj->via.u64 = cursor_load(p + 1, size);
+        return true;
+    }
+    case 0xd0:
+    case 0xd1:
+    case 0xd2:
+    case 0xd3: {
+        size_t size = (size_t)1 << (b & 0x03);
+        uint64_t u;
+        int64_t i;
+        if(avail < 1 + size) { return false; }
+        *hdr = 1 + size;
+        u = cursor_load(p + 1, size);
+        switch(size) {
+        case 1:  i = (int8_t)u;  break;
+        case 2:  i = (int16_t)u; break;
+        case 4:  i = (int32_t)u; break;
+        default: i = (int64_t)u; break;
+        }
+        if(i >= 0) {
+            obj->type = MSGPACK_OBJECT_POSITIVE_INTEGER;
+            obj->via.u64 = (uint64_t)i;
+        }
+        else {
+            obj->type = MSGPACK_OBJECT_NEGATIVE_INTEGER;
+            obj->via.i64 = i;
+        }
+        return true;
+    }
+    case 0xd4:
+    case 0xd5:
+    case 0xd6:
+    case 0xd7:
+    case 0xd8:
+        if(avail < 2) { return false; }
+        *hdr = 2;
+        obj->type = MSGPACK_OBJECT_EXT;
+        obj->via.ext.type = (int8_t)p[1];
+        obj->via.ext.size = 1u << (b - 0xd4);
+        obj->via.ext.ptr = (const char*)p + 2;
+        return avail >= 2 + (size_t)obj->via.ext.size;
+    case 0xc4:
+    case 0xc5:
+    case 0xc6:
+        obj->type = MSGPACK_OBJECT_BIN;
+        lsize = (size_t)1 << (b - 0xc4);
+        break;
+    case 0xc7:
+    case 0xc8:
+    case 0xc9:
+        obj->type = MSGPACK_OBJECT_EXT;
+        lsize = (size_t)1 << (b - 0xc7);
+        break;
+    case 0xd9:
+    case 0xda:
+    case 0xdb:
+        obj->type = MSGPACK_OBJECT_STR;
+        lsize = (size_t)1 << (b - 0xd9);
+        break;
+    case 0xdc:
+    case 0xdd:
+        obj->type = MSGPACK_OBJECT_ARRAY;
+        lsize = b == 0xdc ? 2 : 4;
+        break;
+    case 0xde:
+    case 0xdf:
+        obj->type = MSGPACK_OBJECT_MAP;
+        lsize = b == 0xde ? 2 : 4;
+        break;
+    default:
+        return false;
+    }
+
+    if(avail < 1 + lsize) { return false; }
+    *hdr = 1 + lsize;
+
+    switch(obj->type) {
+    case MSGPACK_OBJECT_ARRAY:
+        obj->via.array.size = (uint32_t)cursor_load(p + 1, lsize);
+        obj->via.array.ptr = NULL;
+        return true;
+    case MSGPACK_OBJECT_MAP:
+        obj->via.map.size = (uint32_t)cursor_load(p + 1, lsize);
+        obj->via.map.ptr = NULL;
+        return true;
+    case MSGPACK_OBJECT_EXT:
+        if(avail < 2 + lsize) { return false; }
+        *hdr = 2 + lsize;
+        obj->via.ext.type = (int8_t)p[1 + lsize];
+        obj->via.ext.size = (uint32_t)cursor_load(p + 1, lsize);
+        obj->via.ext.ptr = (const char*)p + *hdr;
+        return avail - *hdr >= obj->via.ext.size;
+    default:
+        /* str and bin share the layout */
+        obj->via.str.size = (uint32_t)cursor_load(p + 1, lsize);
+        obj->via.str.ptr = (const char*)p + *hdr;
+        return avail - *hdr >= obj->via.str.size;
+    }
+}
+
+void msgpack_cursor_init(msgpack_cursor* cur, const char* data, size_t len, size_t off)
+{
+    cur->data = data;
+    cur->len = len;
+    cur->pos = off;
+    cur->left = 1;
+}
+
+bool msgpack_cursor_peek(const msgpack_cursor* cur, msgpack_object* obj)
+{
+    size_t hdr;
+    return cursor_head(cur, obj, &hdr);
+}
+
+msgpack_object_type msgpack_cursor_type(const msgpack_cursor* cur)
+{
+    msgpack_object obj;
+    size_t hdr;
+    if(!cursor_head(cur, &obj, &hdr)) {
+        return MSGPACK_OBJECT_NIL;
+    }
+    return obj.type;
+}
+
+bool msgpack_cursor_next(msgpack_cursor* cur)
+{
+    if(!msgpack_cursor_valid(cur)) {
+        return false;
+    }
+    if(msgpack_skip(cur->data, cur->len, &cur->pos) != MSGPACK_UNPACK_SUCCESS) {
+        cur->left = 0;
+        return false;
+    }
+    --cur->left;
+    return msgpack_cursor_valid(cur);
+}
+
+bool msgpack_cursor_enter(const msgpack_cursor* cur, msgpack_cursor* child)
+{
+    msgpack_object obj;
+    size_t hdr;
+
+    if(!cursor_head(cur, &obj, &hdr)) {
+        return false;
+    }
+    child->data = cur->data;
+    child->len = cur->len;
+    child->pos = cur->pos + hdr;
+    if(obj.type == MSGPACK_OBJECT_ARRAY) {
+        child->left = obj.via.array.size;
+    }
+    else if(obj.type == MSGPACK_OBJECT_MAP) {
+        child->left = (size_t)obj.via.map.size * 2;
+    }
+    else {
+        return false;
+    }
+    return true;
+}
+
+bool msgpack_cursor_key_equals(const msgpack_cursor* cur, const char* key, size_t size)
+{
+    const char* ptr;
+    uint32_t len;
+    return msgpack_cursor_as_str(cur, &ptr, &len) &&
+        len == size && memcmp(ptr, key, size) == 0;
+}
+
+bool msgpack_cursor_find_key(const msgpack_cursor* cur, const char* key, size_t size,
+        msgpack_cursor* value)
+{
+    msgpack_cursor it;
+
+    if(msgpack_cursor_type(cur) != MSGPACK_OBJECT_MAP || !msgpack_cursor_enter(cur, &it)) {
+        return false;
+    }
+    while(msgpack_cursor_valid(&it)) {
+        bool found = msgpack_cursor_key_equals(&it, key, size);
+        if(!msgpack_cursor_next(&it)) {
+            return false;
+        }
+        if(found) {
+            *value = it;
+            return true;
+        }
+        if(!msgpack_cursor_next(&it)) {
+            return false;
+        }
+    }
+    return false;
+}
+
+bool msgpack_cursor_as_int(const msgpack_cursor* cur, int64_t* v)
+{
+    msgpack_object obj;
+    if(!msgpack_cursor_peek(cur, &obj)) {
+        return false;
+    }
+    if(obj.type == MSGPACK_OBJECT_NEGATIVE_INTEGER) {
+        *v = obj.via.i64;
+        return true;
+    }
+    if(obj.type == MSGPACK_OBJECT_POSITIVE_INTEGER && obj.via.u64 <= INT64_MAX) {
+        *v = (int64_t)obj.via.u64;
+        return true;
+    }
+    return false;
+}
+
+bool msgpack_cursor_as_uint(const msgpack_cursor* cur, uint64_t* v)
+{
+    msgpack_object obj;
+    if(!msgpack_cursor_peek(cur, &obj) || obj.type != MSGPACK_OBJECT_POSITIVE_INTEGER) {
+        return false;
+    }
+    *v = obj.via.u64;
+    return true;
+}
+
+bool msgpack_cursor_as_double(const msgpack_cursor* cur, double* v)
+{
+    msgpack_object obj;
+    if(!msgpack_cursor_peek(cur, &obj)) {
+        return false;
+    }
+    switch(obj.type) {
+    case MSGPACK_OBJECT_FLOAT32:
+    case MSGPACK_OBJECT_FLOAT64:
+        *v = obj.via.f64;
+        return true;
+    case MSGPACK_OBJECT_POSITIVE_INTEGER:
+        *v = (double)obj.via.u64;
+        return true;
+    case MSGPACK_OBJECT_NEGATIVE_INTEGER:
+        *v = (double)obj.via.i64;
+        return true;
+    default:
+        return false;
+    }
+}
+
+bool msgpack_cursor_as_bool(const msgpack_cursor* cur, bool* v)
+{
+    msgpack_object obj;
+    if(!msgpack_cursor_peek(cur, &obj) || obj.type != MSGPACK_OBJECT_BOOLEAN) {
+        return false;
+    }
+    *v = obj.via.boolean;
+    return true;
+}
+
+bool msgpack_cursor_as_str(const msgpack_cursor* cur, const char** ptr, uint32_t* size)
+{
+    msgpack_object obj;
+    if(!msgpack_cursor_peek(cur, &obj) || obj.type != MSGPACK_OBJECT_STR) {
+        return false;
+    }
+    *ptr = obj.via.str.ptr;
+    *size = obj.via.str.size;
+    return true;
+}
+
+bool msgpack_cursor_as_bin(const msgpack_cursor* cur, const char** ptr, uint32_t* size)
+{
+    msgpack_object obj;
+    if(!msgpack_cursor_peek(cur, &obj) || obj.type != MSGPACK_OBJECT_BIN) {
+        return false;
+    }
+    *ptr = obj.via.bin.ptr;
+    *size = obj.via.bin.size;
+    return true;
+}
+
+bool msgpack_cursor_raw(const msgpack_cursor* cur, const char** ptr, size_t* size)
+{
+    size_t end = cur->pos;
+    if(!msgpack_cursor_valid(cur) ||
+            msgpack_skip(cur->data, cur->len, &end) != MSGPACK_UNPACK_SUCCESS) {
+        return false;
+    }
+    *ptr = cur->data + cur->pos;
+    *size = end - cur->pos;
+    return true;
+}
+
+bool msgpack_cursor_object(const msgpack_cursor* cur, msgpack_zone* zone, msgpack_object* obj)
+{
+    size_t off = cur->pos;
+    msgpack_unpack_return ret;
+    if(!msgpack_cursor_valid(cur)) {
+        return false;
+    }
+    ret = msgpack_unpack(cur->data, cur->len, &off, zone, obj);
+    return ret == MSGPACK_UNPACK_SUCCESS || ret == MSGPACK_UNPACK_EXTRA_BYTES;
+}
@@ -0,0 +1,344 @@
+/*
+ * MessagePack for C event-driven deserializer
+ *
+ *    Distributed under the Boost Software License, Version 1.0.
+ *    (See accompanying file LICENSE_1_0.txt or copy at
+ *    http://www.boost.org/LICENSE_1_0.txt)
+ */
+#include "msgpack/event.h"
+#include "msgpack/unpack_define.h"
+#include "msgpack/util.h"
+#include <stdlib.h>
+
+
+typedef enum {
+    EVENT_ARRAY,
+    EVENT_MAP_KEY,
+    EVENT_MAP_VALUE
+} event_level;
+
+typedef struct {
+    const msgpack_event_callbacks* cb;
+    void* data;
+    unsigned int top;
+    unsigned char level[MSGPACK_EMBED_STACK_SIZE];
+} event_user;
+
+/* the template needs an object type, nothing is built */
+typedef int event_object;
+
+
+#define msgpack_unpack_struct(name) \
+    struct event_template ## name
+
+#define msgpack_unpack_func(ret, name) \
+    static inline ret event_template ## name
+
+#define msgpack_unpack_callback(name) \
+    event_callback ## name
+
+#define msgpack_unpack_object event_object
+
+#define msgpack_unpack_user event_user
+
+
+struct event_template_context;
+typedef struct event_template_context event_template_context;
+
+
+/* tells whether the value being reported is a map key */
+static inline bool event_key(event_user* u)
+{
+    if(u->top > 0 && u->level[u->top - 1] == EVENT_MAP_KEY) {
+        u->level[u->top - 1] = EVENT_MAP_VALUE;
+        return true;
+    }
+    return false;
+}
+
+static inline event_object event_callback_root(event_user* u)
+{
+    MSGPACK_UNUSED(u);
+    return 0;
+}
+
+static inline int event_callback_positive(event_user* u, uint64_t d)
+{
+    event_key(u);
+    if(u->cb->positive_integer == NULL) { return 0; }
+    return u->cb->positive_integer(u->data, d);
+}
+
+static inline int event_callback_negative(event_user* u, int64_t d)
+{
+    if(d >= 0) {
+        return event_callback_positive(u, (uint64_t)d);
+    }
+    event_key(u);
+    if(u->cb->negative_integer == NULL) { return 0; }
+    return u->cb->negative_integer(u->data, d);
+}
+
+static inline int event_callback_uint8(event_user* u, uint8_t d, event_object* o)
+{
+    MSGPACK_UNUSED(o);
+    return event_callback_positive(u, d);
+}
+
+static inline int event_callback_uint16(event_user* u, uint16_t d, event_object* o)
+{
+    MSGPACK_UNUSED(o);
+    return event_callback_positive(u, d);
+}
+
+static inline int event_callback_uint32(event_user* u, uint32_t d, event_object* o)
+{
+    MSGPACK_UNUSED(o);
+    return event_callback_positive(u, d);
+}
+
+static inline int event_callback_uint64(event_user* u, uint64_t d, event_object* o)
+{
+    MSGPACK_UNUSED(o);
+    return event_callback_positive(u, d);
+}
+
+static inline int event_callback_int8(event_user* u, int8_t d, event_object* o)
+{
+    MSGPACK_UNUSED(o);
+    return event_callback_negative(u, d);
+}
+
+static inline int event_callback_int16(event_user* u, int16_t d, event_object* o)
+{
+    MSGPACK_UNUSED(o);
+    return event_callback_negative(u, d);
+}
+
+static inline int event_callback_int32(event_user* u, int32_t d, event_object* o)
+{
+    MSGPACK_UNUSED(o);
+    return event_callback_negative(u, d);
+}
+
+static inline int event_callback_int64(event_user* u, int64_t d, event_object* o)
+{
+    MSGPACK_UNUSED(o);
+    return event_callback_negative(u, d);
+}
+
+static inline int event_callback_float(event_user* u, float d, event_object* o)
+{
+    MSGPACK_UNUSED(o);
+    event_key(u);
+    if(u->cb->float32 == NULL) { return 0; }
+    return u->cb->float32(u->data, d);
+}
+
+static inline int event_callback_double(event_user* u, double d, event_object* o)
+{
+    MSGPACK_UNUSED(o);
+    event_key(u);
+    if(u->cb->float64 == NULL) { return 0; }
+    return u->cb->float64(u->data, d);
+}
+
+static inline int event_callback_nil(event_user* u, event_object* o)
+{
+    MSGPACK_UNUSED(o);
+    event_key(u);
+    if(u->cb->nil == NULL) { return 0; }
+    return u->cb->nil(u->data);
+}
+
+static inline int event_callback_true(event_user* u, event_object* o)
+{
+    MSGPACK_UNUSED(o);
+    event_key(u);
+    if(u->cb->boolean == NULL) { return 0; }
+    return u->cb->boolean(u->data, true);
+}
+
+static inline int event_callback_false(event_user* u, event_object* o)
+{
+    MSGPACK_UNUSED(o);
+    event_key(u);
+    if(u->cb->boolean == NULL) { return 0; }
+    return u->cb->boolean(u->data, false);
+}
+
+static inline int event_callback_array(event_user* u, unsigned int n, event_object* o)
+{
+    MSGPACK_UNUSED(o);
+    event_key(u);
+    /* the template checks the depth before calling */
+    u->level[u->top++] = EVENT_ARRAY;
+    if(u->cb->begin_array == NULL) { return 0; }
+    return u->cb->begin_array(u->data, n);
+}
+
+static inline int event_callback_array_item(event_user* u, event_object* c, event_object o)
+{
+    MSGPACK_UNUSED(u);
+    MSGPACK_UNUSED(c);
+    MSGPACK_UNUSED(o);
+    return 0;
+}
+
+static inline int event_callback_array_end(event_user* u, event_object* c)
+{
+    MSGPACK_UNUSED(c);
+    --u->top;
+    if(u->cb->end_array == NULL) { return 0; }
+    return u->cb->end_array(u->data);
+}
+
+static inline int event_callback_map(event_user* u, unsigned int n, event_object* o)
+{
+    MSGPACK_UNUSED(o);
+    event_key(u);
+    u->level[u->top++] = EVENT_MAP_KEY;
+    if(u->cb->begin_map == NULL) { return 0; }
+    return u->cb->begin_map(u->data, n);
+}
+
+static inline int event_callback_map_item(event_user* u, event_object* c, event_object k, event_object v)
+{
+    MSGPACK_UNUSED(c);
+    MSGPACK_UNUSED(k);
+    MSGPACK_UNUSED(v);
+    u->level[u->top - 1] = EVENT_MAP_KEY;
+    return 0;
+}
+
+static inline int event_callback_map_end(event_user* u, event_object* c)
+{
+    MSGPACK_UNUSED(c);
+    --u->top;
+    if(u->cb->end_map == NULL) { return 0; }
+    return u->cb->end_map(u->data);
+}
+
+static inline int event_callback_str(event_user* u, const char* b, const char* p, unsigned int l, event_object* o)
+{
+    MSGPACK_UNUSED(b);
+    MSGPACK_UNUSED(o);
+    if(event_key(u) && u->cb->key != NULL) {
+        return u->cb->key(u->data, p, l);
+    }
+    if(u->cb->str == NULL) { return 0; }
+    return u->cb->str(u->data, p, l);
+}
+
+static inline int event_callback_bin(event_user* u, const char* b, const char* p, unsigned int l, event_object* o)
+{
+    MSGPACK_UNUSED(b);
+    MSGPACK_UNUSED(o);
+    event_key(u);
+    if(u->cb->bin == NULL) { return 0; }
+    return u->cb->bin(u->data, p, l);
+}
+
+static inline int event_callback_ext(event_user* u, const char* b, const char* p, unsigned int l, event_object* o)
+{
+    MSGPACK_UNUSED(b);
+    MSGPACK_UNUSED(o);
+    if (l == 0) {
+        return MSGPACK_UNPACK_PARSE_ERROR;
+    }
+    event_key(u);
+    if(u->cb->ext == NULL) { return 0; }
+    return u->cb->ext(u->data, (int8_t)*p, p + 1, l - 1);
+}
+
+#include "msgpack/unpack_template.h"
+
+
+#define CTX_CAST(m) ((event_template_context*)(m))
+
+
+static inline void event_context_init(event_template_context* ctx,
+        const msgpack_event_callbacks* cb, void* data)
+{
+    event_template_init(ctx);
+    ctx->user.cb = cb;
+    ctx->user.data = data;
+    ctx->user.top = 0;
+}
+
+bool msgpack_event_parser_init(msgpack_event_parser* parser,
+        const msgpack_event_callbacks* cb, void* data)
+{
+    void* ctx = msgpack_allocator_malloc(NULL, sizeof(event_template_context));
+    if(ctx == NULL) {
+        return false;
+    }
+    event_context_init(CTX_CAST(ctx), cb, data);
+    parser->ctx = ctx;
+    return true;
+}
+
+void msgpack_event_parser_destroy(msgpack_event_parser* parser)
+{
+    msgpack_allocator_free(NULL, parser->ctx);
+}
+
+msgpack_event_parser* msgpack_event_parser_new(const msgpack_event_callbacks* cb, void* data)
+{
+    msgpack_event_parser* parser = (msgpack_event_parser*)msgpack_allocator_malloc(NULL, sizeof(msgpack_event_parser));
+    if(parser == NULL) {
+        return NULL;
+    }
+
+    if(!msgpack_event_parser_init(parser, cb, data)) {
+        msgpack_allocator_free(NULL, parser);
+        return NULL;
+    }
+
+    return parser;
+}
+
+void msgpack_event_parser_free(msgpack_event_parser* parser)
+{
+    msgpack_event_parser_destroy(parser);
+    msgpack_allocator_free(NULL, parser);
+}
+
+int msgpack_event_parser_execute(msgpack_event_parser* parser,
+        const char* data, size_t len, size_t* off)
+{
+    int ret = event_template_execute(CTX_CAST(parser->ctx), data, len, off);
+    if(ret > 0) {
+        msgpack_event_parser_reset(parser);
+    }
+    return ret;
+}
+
+void msgpack_event_parser_reset(msgpack_event_parser* parser)
+{
+    event_template_context* ctx = CTX_CAST(parser->ctx);
+    event_context_init(ctx, ctx->user.cb, ctx->user.data);
+}
+
+int msgpack_event_parse(const msgpack_event_callbacks* cb, void* user_data,
+        const char* data, size_t len, size_t* off)
+{
+    size_t noff = *off;
+    int e;
+    event_template_context ctx;
+
+    if(len <= noff) {
+        return MSGPACK_UNPACK_CONTINUE;
+    }
+
+    event_context_init(&ctx, cb, user_data);
+    e = event_template_execute(&ctx, data, len, &noff);
+    if(e < 0) {
+        return e;
+    }
+    if(e == 0) {
+        return MSGPACK_UNPACK_CONTINUE;
+    }
+    *off = noff;
+    return MSGPACK_UNPACK_SUCCESS;
+}
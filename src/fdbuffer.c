@@ -0,0 +1,97 @@
+/*
+ * MessagePack for C file descriptor buffer implementation
+ *
+ *    Distributed under the Boost Software License, Version 1.0.
+ *    (See accompanying file LICENSE_1_0.txt or copy at
+ *    http://www.boost.org/LICENSE_1_0.txt)
+ */
+#include "msgpack/fdbuffer.h"
+#include "msgpack/util.h"
+#include <errno.h>
+#include <limits.h>
+
+#if defined(unix) || defined(__unix) || defined(__linux__) || defined(__APPLE__) || defined(__OpenBSD__) || defined(__NetBSD__) || defined(__QNX__) || defined(__QNXTO__) || defined(__HAIKU__)
+#include <unistd.h>
+#define HAVE_WRITEV 1
+#else
+#include <io.h>
+#define HAVE_WRITEV 0
+#endif
+
+#ifndef IOV_MAX
+#define IOV_MAX 1024
+#endif
+
+bool msgpack_fdbuffer_init(msgpack_fdbuffer* fdbuf, int fd,
+        size_t ref_size, size_t chunk_size)
+{
+    fdbuf->fd = fd;
+    fdbuf->head = 0;
+    return msgpack_vrefbuffer_init(&fdbuf->vbuf, ref_size, chunk_size);
+}
+
+void msgpack_fdbuffer_destroy(msgpack_fdbuffer* fdbuf)
+{
+    msgpack_vrefbuffer_destroy(&fdbuf->vbuf);
+}
+
+static inline long fdbuffer_writev(int fd, const msgpack_iovec* vec, size_t cnt)
+{
+#if HAVE_WRITEV
+    return (long)writev(fd, vec, (int)cnt);
+#else
+    MSGPACK_UNUSED(cnt);
+    return (long)_write(fd, vec->iov_base, (unsigned int)vec->iov_len);
+#endif
+}
+
+int msgpack_fdbuffer_flush(msgpack_fdbuffer* fdbuf)
+{
+    msgpack_vrefbuffer* const vbuf = &fdbuf->vbuf;
+
+    while(vbuf->array + fdbuf->head != vbuf->tail) {
+        msgpack_iovec* vec = vbuf->array + fdbuf->head;
+        size_t cnt = (size_t)(vbuf->tail - vec);
+        long n;
+
+        if(cnt > IOV_MAX) {
+            cnt = IOV_MAX;
+        }
+
+        n = fdbuffer_writev(fdbuf->fd, vec, cnt);
+        if(n < 0) {
+            if(errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+
+        // skip the fully written vectors and shrink the partially written one
+        // in place; its end is kept, so msgpack_vrefbuffer_append_copy can
+        // still coalesce new data into it.
+        while(vec != vbuf->tail && (size_t)n >= vec->iov_len) {
+            n -= (long)vec->iov_len;
+            ++vec;
+        }
+        if(vec != vbuf->tail) {
+            vec->iov_base = (char*)vec->iov_base + n;
+            vec->iov_len -= (size_t)n;
+        }
+        fdbuf->head = (size_t)(vec - vbuf->array);
+    }
+
+    msgpack_vrefbuffer_clear(vbuf);
+    fdbuf->head = 0;
+
+    return 0;
+}
+
+size_t msgpack_fdbuffer_pending(const msgpack_fdbuffer* fdbuf)
+{
+    const msgpack_iovec* vec = fdbuf->vbuf.array + fdbuf->head;
+    size_t len = 0;
+    for(; vec != fdbuf->vbuf.tail; ++vec) {
+        len += vec->iov_len;
+    }
+    return len;
+}
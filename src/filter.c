@@ -0,0 +1,400 @@
+/*
+ * MessagePack for C record filter
+ *
+ *    Distributed under the Boost Software License, Version 1.0.
+ *    (See accompanying file LICENSE_1_0.txt or copy at
+ *    http://www.boost.org/LICENSE_1_0.txt)
+ */
+#include "msgpack/filter.h"
+#include "msgpack/cursor.h"
+#include <stdlib.h>
+#include <string.h>
+
+typedef enum {
+    FILTER_EQUAL,
+    FILTER_INT_RANGE,
+    FILTER_STR_PREFIX
+} filter_kind;
+
+typedef struct {
+    uint32_t key;       /* offset in pool */
+    uint32_t key_size;
+    uint32_t index;
+    bool is_index;
+} filter_segment;
+
+typedef struct {
+    uint32_t segment;   /* first segment of the path */
+    uint32_t nsegments;
+    filter_kind kind;
+    msgpack_object value;   /* FILTER_EQUAL, the body is in pool */
+    uint32_t body;      /* offset in pool */
+    uint32_t body_size;
+    int64_t min;
+    int64_t max;
+} filter_predicate;
+
+struct msgpack_filter {
+    filter_predicate* predicates;
+    size_t count;
+    size_t alloc;
+    filter_segment* segments;
+    size_t nsegments;
+    size_t segments_alloc;
+    char* pool;
+    size_t pool_size;
+    size_t pool_alloc;
+};
+
+
+static bool filter_grow(void** array, size_t* alloc, size_t need, size_t size)
+{
+    size_t nalloc;
+    void* tmp;
+
+    if(need <= *alloc) {
+        return true;
+    }
+    nalloc = *alloc ? *alloc * 2 : 16;
+    while(nalloc < need) {
+        nalloc *= 2;
+    }
+    tmp = msgpack_allocator_realloc(NULL, *array, nalloc * size);
+    if(tmp == NULL) {
+        return false;
+    }
+    *array = tmp;
+    *alloc = nalloc;
+    return true;
+}
+
+static bool filter_intern(msgpack_filter* filter, const char* p, size_t size, uint32_t* off)
+{
+    if(size > UINT32_MAX - filter->pool_size ||
+            !filter_grow((void**)&filter->pool, &filter->pool_alloc,
+                filter->pool_size + size, 1)) {
+        return false;
+    }
+    if(size > 0) {
+        memcpy(filter->pool + filter->pool_size, p, size);
+    }
+    *off = (uint32_t)filter->pool_size;
+    filter->pool_size += size;
+    return true;
+}
+
+static bool filter_add_segment(msgpack_filter* filter, const filter_segment* s)
+{
+    if(!filter_grow((void**)&filter->segments, &filter->segments_alloc,
+                filter->nsegments + 1, sizeof(filter_segment))) {
+        return false;
+    }
+    filter->segments[filter->nsegments++] = *s;
+    return true;
+}
+
+/* parses path into new segments and a new predicate, the caller fills the rest */
+static filter_predicate* filter_add(msgpack_filter* filter, const char* path, filter_kind kind)
+{
+    const char* p = path;
+    size_t first = filter->nsegments;
+    size_t pool_size = filter->pool_size;
+    filter_predicate* pred;
+    filter_segment s;
+
+    while(*p != '\0') {
+        memset(&s, 0, sizeof(s));
+        if(*p == '[') {
+            const char* digits = ++p;
+            s.is_index = true;
+            while(*p >= '0' && *p <= '9') {
+                if(s.index > (UINT32_MAX - 9) / 10) {
+                    goto error;
+                }
+                s.index = s.index * 10 + (uint32_t)(*p - '0');
+                ++p;
+            }
+            if(p == digits || *p != ']') {
+                goto error;
+            }
+            ++p;
+        }
+        else {
+            const char* key = p;
+            while(*p != '\0' && *p != '.' && *p != '[') {
+                ++p;
+            }
+            if(p == key) {
+                goto error;
+            }
+            s.key_size = (uint32_t)(p - key);
+            if(!filter_intern(filter, key, s.key_size, &s.key)) {
+                goto error;
+            }
+        }
+        if(!filter_add_segment(filter, &s)) {
+            goto error;
+        }
+        if(*p == '.') {
+            ++p;
+            if(*p == '\0' || *p == '.' || *p == '[') {
+                goto error;
+            }
+        }
+    }
+
+    if(!filter_grow((void**)&filter->predicates, &filter->alloc,
+                filter->count + 1, sizeof(filter_predicate))) {
+        goto error;
+    }
+    pred = &filter->predicates[filter->count];
+    memset(pred, 0, sizeof(filter_predicate));
+    pred->segment = (uint32_t)first;
+    pred->nsegments = (uint32_t)(filter->nsegments - first);
+    pred->kind = kind;
+    return pred;
+
+error:
+    filter->nsegments = first;
+    filter->pool_size = pool_size;
+    return NULL;
+}
+
+msgpack_filter* msgpack_filter_new(void)
+{
+    msgpack_filter* filter = (msgpack_filter*)msgpack_allocator_malloc(NULL, sizeof(msgpack_filter));
+    if(filter == NULL) {
+        return NULL;
+    }
+    memset(filter, 0, sizeof(msgpack_filter));
+    return filter;
+}
+
+void msgpack_filter_free(msgpack_filter* filter)
+{
+    if(filter == NULL) { return; }
+    msgpack_allocator_free(NULL, filter->predicates);
+    msgpack_allocator_free(NULL, filter->segments);
+    msgpack_allocator_free(NULL, filter->pool);
+    msgpack_allocator_free(NULL, filter);
+}
+
+bool msgpack_filter_add_equal(msgpack_filter* filter, const char* path,
+        const msgpack_object* value)
+{
+    filter_predicate* pred;
+    msgpack_object v = *value;
+    const char* body = NULL;
+    uint32_t body_size = 0;
+
+    switch(v.type) {
+    case MSGPACK_OBJECT_NIL:
+    case MSGPACK_OBJECT_BOOLEAN:
+    case MSGPACK_OBJECT_POSITIVE_INTEGER:
+    case MSGPACK_OBJECT_FLOAT32:
+    case MSGPACK_OBJECT_FLOAT64:
+        break;
+    case MSGPACK_OBJECT_NEGATIVE_INTEGER:
+        /* the unpacker always gives non-negative values as positive integers */
+        if(v.via.i64 >= 0) {
+            v.type = MSGPACK_OBJECT_POSITIVE_INTEGER;
+        }
+        break;
+    case MSGPACK_OBJECT_STR:
+        body = v.via.str.ptr;
+        body_size = v.via.str.size;
+        break;
+    case MSGPACK_OBJECT_BIN:
+        body = v.via.bin.ptr;
+        body_size = v.via.bin.size;
+        break;
+    case MSGPACK_OBJECT_EXT:
+        body = v.via.ext.ptr;
+        body_size = v.via.ext.size;
+        break;
+    default:
+        return false;
+    }
+
+    pred = filter_add(filter, path, FILTER_EQUAL);
+    if(pred == NULL) {
+        return false;
+    }
+    if(!filter_intern(filter, body, body_size, &pred->body)) {
+        return false;
+    }
+    pred->body_size = body_size;
+    pred->value = v;
+    ++filter->count;
+    return true;
+}
+
+bool msgpack_filter_add_int_range(msgpack_filter* filter, const char* path,
+        int64_t min, int64_t max)
+{
+    filter_predicate* pred = filter_add(filter, path, FILTER_INT_RANGE);
+    if(pred == NULL) {
+        return false;
+    }
+    pred->min = min;
+    pred->max = max;
+    ++filter->count;
+    return true;
+}
+
+bool msgpack_filter_add_str_prefix(msgpack_filter* filter, const char* path,
+        const char* prefix, size_t size)
+{
+    filter_predicate* pred;
+
+    if(size > UINT32_MAX) {
+        return false;
+    }
+    pred = filter_add(filter, path, FILTER_STR_PREFIX);
+    if(pred == NULL) {
+        return false;
+    }
+    if(!filter_intern(filter, prefix, size, &pred->body)) {
+        return false;
+    }
+    pred->body_size = (uint32_t)size;
+    ++filter->count;
+    return true;
+}
+
+
+static bool filter_resolve(const msgpack_filter* filter, const filter_predicate* pred,
+        msgpack_cursor* cur)
+{
+    const filter_segment* s = filter->segments + pred->segment;
+    const filter_segment* const end = s + pred->nsegments;
+
+    for(; s != end; ++s) {
+        msgpack_cursor child;
+        if(s->is_index) {
+            uint32_t i;
+            if(msgpack_cursor_type(cur) != MSGPACK_OBJECT_ARRAY ||
+                    !msgpack_cursor_enter(cur, &child)) {
+                return false;
+            }
+            for(i = 0; i < s->index; ++i) {
+                if(!msgpack_cursor_next(&child)) {
+                    return false;
+                }
+            }
+            if(!msgpack_cursor_valid(&child)) {
+                return false;
+            }
+        }
+        else if(!msgpack_cursor_find_key(cur, filter->pool + s->key, s->key_size, &child)) {
+            return false;
+        }
+        *cur = child;
+    }
+    return true;
+}
+
+static bool filter_equal(const msgpack_filter* filter, const filter_predicate* pred,
+        const msgpack_cursor* cur)
+{
+    msgpack_object o;
+    const char* body = filter->pool + pred->body;
+
+    if(!msgpack_cursor_peek(cur, &o)) {
+        return false;
+    }
+    switch(pred->value.type) {
+    case MSGPACK_OBJECT_FLOAT32:
+    case MSGPACK_OBJECT_FLOAT64:
+        return (o.type == MSGPACK_OBJECT_FLOAT32 || o.type == MSGPACK_OBJECT_FLOAT64) &&
+            o.via.f64 == pred->value.via.f64;
+    case MSGPACK_OBJECT_STR:
+    case MSGPACK_OBJECT_BIN:
+        return o.type == pred->value.type && o.via.str.size == pred->body_size &&
+            memcmp(o.via.str.ptr, body, pred->body_size) == 0;
+    case MSGPACK_OBJECT_EXT:
+        return o.type == MSGPACK_OBJECT_EXT && o.via.ext.type == pred->value.via.ext.type &&
+            o.via.ext.size == pred->body_size &&
+            memcmp(o.via.ext.ptr, body, pred->body_size) == 0;
+    default:
+        return msgpack_object_equal(o, pred->value);
+    }
+}
+
+bool msgpack_filter_match(const msgpack_filter* filter,
+        const char* data, size_t len, size_t off)
+{
+    size_t i;
+
+    for(i = 0; i < filter->count; ++i) {
+        const filter_predicate* pred = &filter->predicates[i];
+        msgpack_cursor cur;
+        int64_t v;
+        const char* ptr;
+        uint32_t size;
+
+        msgpack_cursor_init(&cur, data, len, off);
+        if(!filter_resolve(filter, pred, &cur)) {
+            return false;
+        }
+        switch(pred->kind) {
+        case FILTER_EQUAL:
+            if(!filter_equal(filter, pred, &cur)) {
+                return false;
+            }
+            break;
+        case FILTER_INT_RANGE:
+            if(!msgpack_cursor_as_int(&cur, &v) || v < pred->min || v > pred->max) {
+                return false;
+            }
+            break;
+        case FILTER_STR_PREFIX:
+            if(!msgpack_cursor_as_str(&cur, &ptr, &size) || size < pred->body_size ||
+                    memcmp(ptr, filter->pool + pred->body, pred->body_size) != 0) {
+                return false;
+            }
+            break;
+        }
+    }
+    return true;
+}
+
+msgpack_unpack_return
+msgpack_filter_next(const msgpack_filter* filter,
+        const char* data, size_t len, size_t* off, size_t* start)
+{
+    size_t pos = *off;
+
+    while(pos < len) {
+        size_t end = pos;
+        msgpack_unpack_return ret = msgpack_skip(data, len, &end);
+        if(ret != MSGPACK_UNPACK_SUCCESS) {
+            *off = pos;
+            return ret;
+        }
+        if(msgpack_filter_match(filter, data, end, pos)) {
+            *start = pos;
+            *off = end;
+            return MSGPACK_UNPACK_SUCCESS;
+        }
+        pos = end;
+    }
+    *off = pos;
+    return MSGPACK_UNPACK_CONTINUE;
+}
+
+msgpack_unpack_return
+msgpack_unpacker_filter_next(msgpack_unpacker* mpac, const msgpack_filter* filter,
+        const char** ptr, size_t* size)
+{
+    size_t start = 0;
+    size_t off = mpac->off;
+    msgpack_unpack_return ret = msgpack_filter_next(filter, mpac->buffer, mpac->used, &off, &start);
+
+    mpac->off = off;
+    if(ret == MSGPACK_UNPACK_SUCCESS) {
+        *ptr = mpac->buffer + start;
+        *size = off - start;
+    }
+    return ret;
+}
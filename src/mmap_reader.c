@@ -0,0 +1,204 @@
+/*
+ * MessagePack for C memory-mapped file reader
+ *
+ *    Distributed under the Boost Software License, Version 1.0.
+ *    (See accompanying file LICENSE_1_0.txt or copy at
+ *    http://www.boost.org/LICENSE_1_0.txt)
+ */
+#include "msgpack/mmap_reader.h"
+#include "msgpack/util.h"
+#include <errno.h>
+
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#if !defined(_WIN32)
+
+static inline size_t mmap_reader_page(void)
+{
+    return (size_t)sysconf(_SC_PAGESIZE);
+}
+
+/* leaves the reader safe to close if opening fails */
+static void mmap_reader_reset(msgpack_mmap_reader* reader)
+{
+    reader->data = NULL;
+    reader->size = 0;
+    reader->off = 0;
+    reader->fd = -1;
+}
+
+/* takes fd */
+static bool mmap_reader_map(msgpack_mmap_reader* reader, int fd, size_t window)
+{
+    struct stat st;
+    void* map = NULL;
+    size_t page = mmap_reader_page();
+
+    if(fstat(fd, &st) != 0) {
+        close(fd);
+        return false;
+    }
+    if(st.st_size < 0 || (unsigned long long)st.st_size > (unsigned long long)SIZE_MAX) {
+        close(fd);
+        errno = EFBIG;
+        return false;
+    }
+    if(st.st_size > 0) {
+        map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        if(map == MAP_FAILED) {
+            int e = errno;
+            close(fd);
+            errno = e;
+            return false;
+        }
+#if defined(MADV_SEQUENTIAL)
+        madvise(map, (size_t)st.st_size, MADV_SEQUENTIAL);
+#endif
+    }
+
+    reader->data = (const char*)map;
+    reader->size = (size_t)st.st_size;
+    reader->off = 0;
+    reader->fd = fd;
+    /* whole pages, so that advised and dropped stay page aligned */
+    reader->window = window != 0 ? window : MSGPACK_MMAP_READER_WINDOW;
+    reader->window = (reader->window + page - 1) & ~(page - 1);
+    reader->advised = 0;
+    reader->dropped = 0;
+    return true;
+}
+
+bool msgpack_mmap_reader_open(msgpack_mmap_reader* reader, const char* path, size_t window)
+{
+    int fd;
+    mmap_reader_reset(reader);
+    fd = open(path, O_RDONLY);
+    if(fd < 0) {
+        return false;
+    }
+    return mmap_reader_map(reader, fd, window);
+}
+
+bool msgpack_mmap_reader_init_fd(msgpack_mmap_reader* reader, int fd, size_t window)
+{
+    int own;
+    mmap_reader_reset(reader);
+    own = dup(fd);
+    if(own < 0) {
+        return false;
+    }
+    return mmap_reader_map(reader, own, window);
+}
+
+void msgpack_mmap_reader_close(msgpack_mmap_reader* reader)
+{
+    if(reader->data != NULL) {
+        munmap((void*)reader->data, reader->size);
+        reader->data = NULL;
+    }
+    if(reader->fd >= 0) {
+        close(reader->fd);
+        reader->fd = -1;
+    }
+}
+
+/* requests the next window of pages */
+static void mmap_reader_advise(msgpack_mmap_reader* reader)
+{
+    size_t page = mmap_reader_page();
+    size_t len;
+
+    if(reader->advised < reader->off) {
+        /* an object larger than the window */
+        reader->advised = reader->off & ~(page - 1);
+    }
+    len = reader->size - reader->advised;
+    if(len > reader->window) {
+        len = reader->window;
+    }
+#if defined(MADV_WILLNEED)
+    madvise((void*)(reader->data + reader->advised), len, MADV_WILLNEED);
+#endif
+    reader->advised += len;
+}
+
+/*
+ * Drops the pages a window behind the cursor. The mapping is read-only, so
+ * the objects still pointing there fault the pages back in from the file.
+ */
+static void mmap_reader_drop(msgpack_mmap_reader* reader)
+{
+    size_t page = mmap_reader_page();
+    size_t end = (reader->off - reader->window) & ~(page - 1);
+    size_t len = end - reader->dropped;
+
+#if defined(MADV_DONTNEED)
+    madvise((void*)(reader->data + reader->dropped), len, MADV_DONTNEED);
+#endif
+#if defined(POSIX_FADV_DONTNEED)
+    posix_fadvise(reader->fd, (off_t)reader->dropped, (off_t)len, POSIX_FADV_DONTNEED);
+#endif
+    reader->dropped = end;
+}
+
+msgpack_unpack_return
+msgpack_mmap_reader_next(msgpack_mmap_reader* reader, msgpack_unpacked* result)
+{
+    size_t off = reader->off;
+    msgpack_unpack_return ret;
+
+    if(reader->advised < reader->size && reader->off + reader->window / 2 >= reader->advised) {
+        mmap_reader_advise(reader);
+    }
+
+    ret = msgpack_unpack_next(result, reader->data, reader->size, &off);
+    if(ret != MSGPACK_UNPACK_SUCCESS) {
+        return ret;
+    }
+    reader->off = off;
+
+    if(reader->off - reader->dropped >= 2 * reader->window) {
+        mmap_reader_drop(reader);
+    }
+    return ret;
+}
+
+#else  /* _WIN32 */
+
+bool msgpack_mmap_reader_open(msgpack_mmap_reader* reader, const char* path, size_t window)
+{
+    MSGPACK_UNUSED(reader);
+    MSGPACK_UNUSED(path);
+    MSGPACK_UNUSED(window);
+    errno = ENOSYS;
+    return false;
+}
+
+bool msgpack_mmap_reader_init_fd(msgpack_mmap_reader* reader, int fd, size_t window)
+{
+    MSGPACK_UNUSED(reader);
+    MSGPACK_UNUSED(fd);
+    MSGPACK_UNUSED(window);
+    errno = ENOSYS;
+    return false;
+}
+
+void msgpack_mmap_reader_close(msgpack_mmap_reader* reader)
+{
+    MSGPACK_UNUSED(reader);
+}
+
+msgpack_unpack_return
+msgpack_mmap_reader_next(msgpack_mmap_reader* reader, msgpack_unpacked* result)
+{
+    MSGPACK_UNUSED(reader);
+    MSGPACK_UNUSED(result);
+    return MSGPACK_UNPACK_PARSE_ERROR;
+}
+
+#endif /* _WIN32 */
@@ -548,3 +548,101 @@ bool msgpack_object_equal(const msgpack_object x, const msgpack_object y)
         return false;
     }
 }
+
+static uint32_t msgpack_object_map_hash(const char* key, size_t len)
+{
+    /* FNV-1a */
+    uint32_t h = 2166136261U;
+    size_t i;
+    for(i = 0; i < len; ++i) {
+        h ^= (unsigned char)key[i];
+        h *= 16777619U;
+    }
+    return h;
+}
+
+msgpack_object_map_index* msgpack_object_map_index_build(msgpack_zone* zone,
+        const msgpack_object_map* map)
+{
+    msgpack_object_map_index* index;
+    size_t nslots = 8;
+    uint32_t i;
+
+    /* at most half full so that probes stay short */
+    while(nslots < (size_t)map->size * 2) {
+        nslots *= 2;
+    }
+    if(nslots > (size_t)UINT32_MAX ||
+            nslots > ((size_t)-1 - sizeof(msgpack_object_map_index)) / sizeof(msgpack_object_map_slot)) {
+        return NULL;
+    }
+
+    index = (msgpack_object_map_index*)msgpack_zone_malloc(zone,
+            sizeof(msgpack_object_map_index) + nslots * sizeof(msgpack_object_map_slot));
+    if(index == NULL) {
+        return NULL;
+    }
+    index->mask = (uint32_t)(nslots - 1);
+    index->slots = (msgpack_object_map_slot*)(index + 1);
+    memset(index->slots, 0, nslots * sizeof(msgpack_object_map_slot));
+
+    for(i = 0; i < map->size; ++i) {
+        const msgpack_object* k = &map->ptr[i].key;
+        uint32_t h;
+        uint32_t s;
+
+        if(k->type != MSGPACK_OBJECT_STR) {
+            continue;
+        }
+        h = msgpack_object_map_hash(k->via.str.ptr, k->via.str.size);
+        for(s = h & index->mask; index->slots[s].pos != 0; s = (s + 1) & index->mask) {
+            const msgpack_object* o = &map->ptr[index->slots[s].pos - 1].key;
+            if(index->slots[s].hash == h && o->via.str.size == k->via.str.size &&
+                    memcmp(o->via.str.ptr, k->via.str.ptr, k->via.str.size) == 0) {
+                break;
+            }
+        }
+        /* the first pair of a duplicated key wins, like a linear scan */
+        if(index->slots[s].pos == 0) {
+            index->slots[s].hash = h;
+            index->slots[s].pos = i + 1;
+        }
+    }
+    return index;
+}
+
+const msgpack_object* msgpack_object_map_find(const msgpack_object_map* map,
+        const msgpack_object_map_index* index, const char* key, size_t len)
+{
+    uint32_t h;
+    uint32_t s;
+
+    if(index == NULL) {
+        return msgpack_object_map_find_str(map, key, len);
+    }
+    h = msgpack_object_map_hash(key, len);
+    for(s = h & index->mask; index->slots[s].pos != 0; s = (s + 1) & index->mask) {
+        const msgpack_object_kv* kv = &map->ptr[index->slots[s].pos - 1];
+        if(index->slots[s].hash == h && kv->key.via.str.size == len &&
+                memcmp(kv->key.via.str.ptr, key, len) == 0) {
+            return &kv->val;
+        }
+    }
+    return NULL;
+}
+
+const msgpack_object* msgpack_object_map_find_str(const msgpack_object_map* map,
+        const char* key, size_t len)
+{
+    const msgpack_object_kv* p = map->ptr;
+    const msgpack_object_kv* const pend = map->ptr + map->size;
+
+    for(; p < pend; ++p) {
+        if(p->key.type == MSGPACK_OBJECT_STR && p->key.via.str.size == len &&
+                (len == 0 || (p->key.via.str.ptr[0] == key[0] &&
+                 memcmp(p->key.via.str.ptr, key, len) == 0))) {
+            return &p->val;
+        }
+    }
+    return NULL;
+}
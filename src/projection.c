@@ -0,0 +1,456 @@
+/*
+ * MessagePack for C projected unpacking
+ *
+ *    Distributed under the Boost Software License, Version 1.0.
+ *    (See accompanying file LICENSE_1_0.txt or copy at
+ *    http://www.boost.org/LICENSE_1_0.txt)
+ */
+#include "msgpack/projection.h"
+#include "msgpack/cursor.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define PROJECTION_NONE ((uint32_t)-1)
+
+typedef enum {
+    PROJECTION_ROOT,
+    PROJECTION_KEY,
+    PROJECTION_ANY,
+    PROJECTION_INDEX
+} projection_kind;
+
+typedef struct {
+    uint32_t first_child;
+    uint32_t next_sibling;
+    uint32_t key;       /* offset in names, PROJECTION_KEY */
+    uint32_t key_size;
+    uint32_t index;     /* PROJECTION_INDEX */
+    unsigned char kind;
+    bool terminal;
+} projection_node;
+
+struct msgpack_projection {
+    projection_node* nodes;
+    size_t count;
+    size_t alloc;
+    char* names;
+    size_t names_size;
+    size_t names_alloc;
+};
+
+
+static bool projection_grow(void** array, size_t* alloc, size_t need, size_t size)
+{
+    size_t nalloc;
+    void* tmp;
+
+    if(need <= *alloc) {
+        return true;
+    }
+    nalloc = *alloc ? *alloc * 2 : 16;
+    while(nalloc < need) {
+        nalloc *= 2;
+    }
+    tmp = msgpack_allocator_realloc(NULL, *array, nalloc * size);
+    if(tmp == NULL) {
+        return false;
+    }
+    *array = tmp;
+    *alloc = nalloc;
+    return true;
+}
+
+/* finds or adds the child of parent matching the segment */
+static uint32_t projection_child(msgpack_projection* proj, uint32_t parent,
+        projection_kind kind, const char* key, size_t key_size, uint32_t index)
+{
+    uint32_t c;
+    projection_node* n;
+
+    for(c = proj->nodes[parent].first_child; c != PROJECTION_NONE; c = proj->nodes[c].next_sibling) {
+        n = &proj->nodes[c];
+        if(n->kind != kind) {
+            continue;
+        }
+        if(kind == PROJECTION_ANY ||
+                (kind == PROJECTION_INDEX && n->index == index) ||
+                (kind == PROJECTION_KEY && n->key_size == key_size &&
+                 memcmp(proj->names + n->key, key, key_size) == 0)) {
+            return c;
+        }
+    }
+
+    if(!projection_grow((void**)&proj->nodes, &proj->alloc,
+                proj->count + 1, sizeof(projection_node))) {
+        return PROJECTION_NONE;
+    }
+    c = (uint32_t)proj->count++;
+    n = &proj->nodes[c];
+    memset(n, 0, sizeof(projection_node));
+    n->first_child = PROJECTION_NONE;
+    n->next_sibling = proj->nodes[parent].first_child;
+    n->kind = (unsigned char)kind;
+    n->index = index;
+    if(kind == PROJECTION_KEY) {
+        if(!projection_grow((void**)&proj->names, &proj->names_alloc,
+                    proj->names_size + key_size, 1)) {
+            --proj->count;
+            return PROJECTION_NONE;
+        }
+        n->key = (uint32_t)proj->names_size;
+        n->key_size = (uint32_t)key_size;
+        memcpy(proj->names + proj->names_size, key, key_size);
+        proj->names_size += key_size;
+    }
+    proj->nodes[parent].first_child = c;
+    return c;
+}
+
+static bool projection_add(msgpack_projection* proj, const char* path)
+{
+    const char* p = path;
+    uint32_t node = 0;
+
+    while(*p != '\0') {
+        if(*p == '[') {
+            uint32_t index = 0;
+            projection_kind kind;
+            ++p;
+            if(*p == '*') {
+                kind = PROJECTION_ANY;
+                ++p;
+            }
+            else {
+                const char* digits = p;
+                kind = PROJECTION_INDEX;
+                while(*p >= '0' && *p <= '9') {
+                    if(index > (UINT32_MAX - 9) / 10) {
+                        return false;
+                    }
+                    index = index * 10 + (uint32_t)(*p - '0');
+                    ++p;
+                }
+                if(p == digits) {
+                    return false;
+                }
+            }
+            if(*p != ']') {
+                return false;
+            }
+            ++p;
+            node = projection_child(proj, node, kind, NULL, 0, index);
+        }
+        else {
+            const char* key = p;
+            while(*p != '\0' && *p != '.' && *p != '[') {
+                ++p;
+            }
+            if(p == key) {
+                return false;
+            }
+            node = projection_child(proj, node, PROJECTION_KEY, key, (size_t)(p - key), 0);
+        }
+        if(node == PROJECTION_NONE) {
+            return false;
+        }
+        if(*p == '.') {
+            ++p;
+            if(*p == '\0' || *p == '.' || *p == '[') {
+                return false;
+            }
+        }
+    }
+    proj->nodes[node].terminal = true;
+    return true;
+}
+
+/* adds the selection of src to dst */
+static bool projection_merge(msgpack_projection* proj, uint32_t dst, uint32_t src)
+{
+    uint32_t c;
+
+    if(proj->nodes[src].terminal) {
+        proj->nodes[dst].terminal = true;
+    }
+    for(c = proj->nodes[src].first_child; c != PROJECTION_NONE; c = proj->nodes[c].next_sibling) {
+        projection_node n = proj->nodes[c];
+        uint32_t d;
+        /* the key is read from names while a copy may be appended to it */
+        if(n.kind == PROJECTION_KEY &&
+                !projection_grow((void**)&proj->names, &proj->names_alloc,
+                    proj->names_size + n.key_size, 1)) {
+            return false;
+        }
+        d = projection_child(proj, dst, (projection_kind)n.kind,
+                proj->names + n.key, n.key_size, n.index);
+        if(d == PROJECTION_NONE || !projection_merge(proj, d, c)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/* gives each [N] element the union of its own and the [*] selections */
+static bool projection_union(msgpack_projection* proj, uint32_t node)
+{
+    uint32_t any = PROJECTION_NONE;
+    uint32_t c;
+
+    for(c = proj->nodes[node].first_child; c != PROJECTION_NONE; c = proj->nodes[c].next_sibling) {
+        if(proj->nodes[c].kind == PROJECTION_ANY) {
+            any = c;
+        }
+    }
+    for(c = proj->nodes[node].first_child; c != PROJECTION_NONE; c = proj->nodes[c].next_sibling) {
+        if(any != PROJECTION_NONE && proj->nodes[c].kind == PROJECTION_INDEX &&
+                !projection_merge(proj, c, any)) {
+            return false;
+        }
+        if(!projection_union(proj, c)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+msgpack_projection* msgpack_projection_new(const char* const* paths, size_t count)
+{
+    size_t i;
+    msgpack_projection* proj = (msgpack_projection*)msgpack_allocator_malloc(NULL, sizeof(msgpack_projection));
+    if(proj == NULL) {
+        return NULL;
+    }
+    memset(proj, 0, sizeof(msgpack_projection));
+    if(!projection_grow((void**)&proj->nodes, &proj->alloc, 1, sizeof(projection_node))) {
+        msgpack_allocator_free(NULL, proj);
+        return NULL;
+    }
+    memset(&proj->nodes[0], 0, sizeof(projection_node));
+    proj->nodes[0].first_child = PROJECTION_NONE;
+    proj->nodes[0].next_sibling = PROJECTION_NONE;
+    proj->nodes[0].kind = PROJECTION_ROOT;
+    proj->count = 1;
+
+    for(i = 0; i < count; ++i) {
+        if(!projection_add(proj, paths[i])) {
+            msgpack_projection_free(proj);
+            return NULL;
+        }
+    }
+    if(!projection_union(proj, 0)) {
+        msgpack_projection_free(proj);
+        return NULL;
+    }
+    return proj;
+}
+
+void msgpack_projection_free(msgpack_projection* proj)
+{
+    if(proj == NULL) { return; }
+    msgpack_allocator_free(NULL, proj->nodes);
+    msgpack_allocator_free(NULL, proj->names);
+    msgpack_allocator_free(NULL, proj);
+}
+
+
+/* 1: something was selected into out, 0: nothing, negative: error */
+static int projection_apply(const msgpack_projection* proj, uint32_t node,
+        const msgpack_cursor* cur, msgpack_zone* zone, msgpack_object* out);
+
+static int projection_map(const msgpack_projection* proj, const projection_node* n,
+        const msgpack_cursor* cur, uint32_t size, msgpack_zone* zone, msgpack_object* out)
+{
+    msgpack_cursor it;
+    msgpack_object_kv* kv;
+    size_t keys = 0;
+    size_t cap;
+    uint32_t c;
+    uint32_t count = 0;
+
+    for(c = n->first_child; c != PROJECTION_NONE; c = proj->nodes[c].next_sibling) {
+        if(proj->nodes[c].kind == PROJECTION_KEY) {
+            ++keys;
+        }
+    }
+    /* a key may repeat in the data, at most size pairs are selected */
+    cap = keys < size ? keys : size;
+    if(cap == 0) {
+        return 0;
+    }
+    kv = (msgpack_object_kv*)msgpack_zone_malloc(zone, cap * sizeof(msgpack_object_kv));
+    if(kv == NULL) {
+        return MSGPACK_UNPACK_NOMEM_ERROR;
+    }
+
+    msgpack_cursor_enter(cur, &it);
+    while(msgpack_cursor_valid(&it) && count < cap) {
+        const char* ptr;
+        uint32_t len;
+        uint32_t match = PROJECTION_NONE;
+
+        if(msgpack_cursor_as_str(&it, &ptr, &len)) {
+            for(c = n->first_child; c != PROJECTION_NONE; c = proj->nodes[c].next_sibling) {
+                const projection_node* k = &proj->nodes[c];
+                if(k->kind == PROJECTION_KEY && k->key_size == len &&
+                        memcmp(proj->names + k->key, ptr, len) == 0) {
+                    match = c;
+                    break;
+                }
+            }
+        }
+        if(match != PROJECTION_NONE) {
+            msgpack_cursor_peek(&it, &kv[count].key);
+        }
+        msgpack_cursor_next(&it);
+        if(match != PROJECTION_NONE) {
+            int ret = projection_apply(proj, match, &it, zone, &kv[count].val);
+            if(ret < 0) {
+                return ret;
+            }
+            if(ret > 0) {
+                ++count;
+            }
+        }
+        msgpack_cursor_next(&it);
+    }
+
+    if(count == 0) {
+        return 0;
+    }
+    out->type = MSGPACK_OBJECT_MAP;
+    out->via.map.size = count;
+    out->via.map.ptr = kv;
+    return 1;
+}
+
+static int projection_array(const msgpack_projection* proj, const projection_node* n,
+        const msgpack_cursor* cur, uint32_t size, msgpack_zone* zone, msgpack_object* out)
+{
+    msgpack_cursor it;
+    msgpack_object* elems;
+    uint32_t any = PROJECTION_NONE;
+    uint32_t last = 0;
+    size_t cap = 0;
+    uint32_t c;
+    uint32_t i;
+    uint32_t count = 0;
+    bool found = false;
+
+    for(c = n->first_child; c != PROJECTION_NONE; c = proj->nodes[c].next_sibling) {
+        const projection_node* e = &proj->nodes[c];
+        if(e->kind == PROJECTION_ANY) {
+            any = c;
+        }
+        else if(e->kind == PROJECTION_INDEX && e->index < size) {
+            ++cap;
+            if(last < e->index + 1) {
+                last = e->index + 1;
+            }
+        }
+    }
+    if(any != PROJECTION_NONE) {
+        cap = size;
+        last = size;
+    }
+    if(cap == 0) {
+        return 0;
+    }
+    elems = (msgpack_object*)msgpack_zone_malloc(zone, cap * sizeof(msgpack_object));
+    if(elems == NULL) {
+        return MSGPACK_UNPACK_NOMEM_ERROR;
+    }
+
+    msgpack_cursor_enter(cur, &it);
+    /* the elements after the last selected one are not even visited */
+    for(i = 0; i < last && msgpack_cursor_valid(&it); ++i) {
+        uint32_t match = any;
+        int ret;
+
+        for(c = n->first_child; c != PROJECTION_NONE; c = proj->nodes[c].next_sibling) {
+            if(proj->nodes[c].kind == PROJECTION_INDEX && proj->nodes[c].index == i) {
+                match = c;
+                break;
+            }
+        }
+        if(match != PROJECTION_NONE) {
+            ret = projection_apply(proj, match, &it, zone, &elems[count]);
+            if(ret < 0) {
+                return ret;
+            }
+            if(ret > 0) {
+                found = true;
+                ++count;
+            }
+            else if(any != PROJECTION_NONE) {
+                elems[count++].type = MSGPACK_OBJECT_NIL;
+            }
+        }
+        msgpack_cursor_next(&it);
+    }
+
+    if(!found) {
+        return 0;
+    }
+    out->type = MSGPACK_OBJECT_ARRAY;
+    out->via.array.size = count;
+    out->via.array.ptr = elems;
+    return 1;
+}
+
+static int projection_apply(const msgpack_projection* proj, uint32_t node,
+        const msgpack_cursor* cur, msgpack_zone* zone, msgpack_object* out)
+{
+    const projection_node* n = &proj->nodes[node];
+    msgpack_object head;
+
+    if(n->terminal) {
+        return msgpack_cursor_object(cur, zone, out) ? 1 : MSGPACK_UNPACK_NOMEM_ERROR;
+    }
+    if(!msgpack_cursor_peek(cur, &head)) {
+        return MSGPACK_UNPACK_PARSE_ERROR;
+    }
+    switch(head.type) {
+    case MSGPACK_OBJECT_MAP:
+        return projection_map(proj, n, cur, head.via.map.size, zone, out);
+    case MSGPACK_OBJECT_ARRAY:
+        return projection_array(proj, n, cur, head.via.array.size, zone, out);
+    default:
+        return 0;
+    }
+}
+
+msgpack_unpack_return
+msgpack_unpack_projected(const char* data, size_t len, size_t* off,
+        const msgpack_projection* proj, msgpack_zone* zone, msgpack_object* obj)
+{
+    size_t noff = 0;
+    size_t end;
+    msgpack_unpack_return ret;
+    msgpack_cursor cur;
+    int e;
+
+    if(off != NULL) { noff = *off; }
+
+    /* validates the whole object first, the projection can then trust it */
+    end = noff;
+    ret = msgpack_skip(data, len, &end);
+    if(ret != MSGPACK_UNPACK_SUCCESS) {
+        return ret;
+    }
+
+    msgpack_cursor_init(&cur, data, end, noff);
+    e = projection_apply(proj, 0, &cur, zone, obj);
+    if(e < 0) {
+        return (msgpack_unpack_return)e;
+    }
+    if(e == 0) {
+        obj->type = MSGPACK_OBJECT_NIL;
+    }
+
+    if(off != NULL) { *off = end; }
+
+    if(end < len) {
+        return MSGPACK_UNPACK_EXTRA_BYTES;
+    }
+    return MSGPACK_UNPACK_SUCCESS;
+}
@@ -0,0 +1,202 @@
+/*
+ * MessagePack for C object skipping routine
+ *
+ *    Distributed under the Boost Software License, Version 1.0.
+ *    (See accompanying file LICENSE_1_0.txt or copy at
+ *    http://www.boost.org/LICENSE_1_0.txt)
+ */
+#include "msgpack/unpack.h"
+#include "msgpack/sysdep.h"
+
+
+typedef enum {
+    SKIP_FIXED,     /* size bytes follow the type byte */
+    SKIP_BODY,      /* size bytes of length, then the body */
+    SKIP_EXT,       /* size bytes of length, the ext type, then the body */
+    SKIP_ARRAY,     /* size bytes of element count */
+    SKIP_MAP,       /* size bytes of pair count */
+    SKIP_INVALID
+} skip_kind;
+
+/* 0xc0 - 0xdf */
+static const struct {
+    unsigned char kind;
+    unsigned char size;
+} skip_table[32] = {
+    { SKIP_FIXED,    0 },   /* nil */
+    { SKIP_INVALID,  0 },   /* never used */
+    { SKIP_FIXED,    0 },   /* false */
+    { SKIP_FIXED,    0 },   /* true */
+    { SKIP_BODY,     1 },   /* bin 8 */
+    { SKIP_BODY,     2 },   /* bin 16 */
+    { SKIP_BODY,     4 },   /* bin 32 */
+    { SKIP_EXT,      1 },   /* ext 8 */
+    { SKIP_EXT,      2 },   /* ext 16 */
+    { SKIP_EXT,      4 },   /* ext 32 */
+    { SKIP_FIXED,    4 },   /* float */
+    { SKIP_FIXED,    8 },   /* double */
+    { SKIP_FIXED,    1 },   /* uint 8 */
+    { SKIP_FIXED,    2 },   /* uint 16 */
+    { SKIP_FIXED,    4 },   /* uint 32 */
+    { SKIP_FIXED,    8 },   /* uint 64 */
+    { SKIP_FIXED,    1 },   /* int 8 */
+    { SKIP_FIXED,    2 },   /* int 16 */
+    { SKIP_FIXED,    4 },   /* int 32 */
+    { SKIP_FIXED,    8 },   /* int 64 */
+    { SKIP_FIXED,    2 },   /* fixext 1 */
+    { SKIP_FIXED,    3 },   /* fixext 2 */
+    { SKIP_FIXED,    5 },   /* fixext 4 */
+    { SKIP_FIXED,    9 },   /* fixext 8 */
+    { SKIP_FIXED,   17 },   /* fixext 16 */
+    { SKIP_BODY,     1 },   /* str 8 */
+    { SKIP_BODY,     2 },   /* str 16 */
+    { SKIP_BODY,     4 },   /* str 32 */
+    { SKIP_ARRAY,    2 },   /* array 16 */
+    { SKIP_ARRAY,    4 },   /* array 32 */
+    { SKIP_MAP,      2 },   /* map 16 */
+    { SKIP_MAP,      4 }    /* map 32 */
+};
+
+static inline uint32_t skip_load(const unsigned char* p, unsigned int size)
+{
+    switch(size) {
+    case 1:
+        return *p;
+    case 2: {
+        uint16_t tmp;
+        _msgpack_load16(uint16_t, p, &tmp);
+        return tmp;
+    }
+    default: {
+        uint32_t tmp;
+        _msgpack_load32(uint32_t, p, &tmp);
+        return tmp;
+    }
+    }
+}
+
+/*
+ * Only the number of objects still to be skipped is tracked: an array adds
+ * its elements and a map twice its pairs, so no stack is needed.
+ * On MSGPACK_UNPACK_CONTINUE, *need is the number of bytes missing at least.
+ */
+static msgpack_unpack_return skip_object(const unsigned char* p, const unsigned char* const pe,
+        const unsigned char** end, size_t* need)
+{
+    uint64_t remaining = 1;
+
+    while(remaining > 0) {
+        unsigned int b;
+        size_t avail = (size_t)(pe - p);
+        size_t step;
+
+        if(avail == 0) {
+            *need = 1;
+            return MSGPACK_UNPACK_CONTINUE;
+        }
+        b = *p;
+        --remaining;
+
+        if(b <= 0x7f || b >= 0xe0) {        /* positive/negative fixint */
+            ++p;
+            continue;
+        }
+        if(b <= 0x8f) {                     /* fixmap */
+            remaining += 2 * (b & 0x0f);
+            ++p;
+            continue;
+        }
+        if(b <= 0x9f) {                     /* fixarray */
+            remaining += b & 0x0f;
+            ++p;
+            continue;
+        }
+        if(b <= 0xbf) {                     /* fixstr */
+            step = 1 + (b & 0x1f);
+        }
+        else {
+            unsigned int size = skip_table[b - 0xc0].size;
+            uint32_t n;
+
+            switch(skip_table[b - 0xc0].kind) {
+            case SKIP_FIXED:
+                step = 1 + size;
+                break;
+            case SKIP_INVALID:
+                return MSGPACK_UNPACK_PARSE_ERROR;
+            default:
+                if(avail < 1 + size) {
+                    *need = 1 + size - avail;
+                    return MSGPACK_UNPACK_CONTINUE;
+                }
+                n = skip_load(p + 1, size);
+                switch(skip_table[b - 0xc0].kind) {
+                case SKIP_BODY:
+                    step = 1 + size + (size_t)n;
+                    break;
+                case SKIP_EXT:
+                    step = 2 + size + (size_t)n;
+                    break;
+                case SKIP_ARRAY:
+                    remaining += n;
+                    step = 1 + size;
+                    break;
+                default:    /* SKIP_MAP */
+                    remaining += 2 * (uint64_t)n;
+                    step = 1 + size;
+                    break;
+                }
+                break;
+            }
+        }
+
+        if(avail < step) {
+            *need = step - avail;
+            return MSGPACK_UNPACK_CONTINUE;
+        }
+        p += step;
+    }
+
+    *end = p;
+    return MSGPACK_UNPACK_SUCCESS;
+}
+
+msgpack_unpack_return
+msgpack_skip(const char* data, size_t len, size_t* off)
+{
+    const unsigned char* const base = (const unsigned char*)data;
+    const unsigned char* end;
+    size_t need;
+    msgpack_unpack_return ret;
+
+    if(len <= *off) {
+        return MSGPACK_UNPACK_CONTINUE;
+    }
+    ret = skip_object(base + *off, base + len, &end, &need);
+    if(ret == MSGPACK_UNPACK_SUCCESS) {
+        *off = (size_t)(end - base);
+    }
+    return ret;
+}
+
+msgpack_unpack_return
+msgpack_measure(const char* data, size_t len, size_t* size)
+{
+    const unsigned char* const base = (const unsigned char*)data;
+    const unsigned char* end;
+    size_t need = 1;
+    msgpack_unpack_return ret;
+
+    if(len == 0) {
+        *size = 1;
+        return MSGPACK_UNPACK_CONTINUE;
+    }
+    ret = skip_object(base, base + len, &end, &need);
+    if(ret == MSGPACK_UNPACK_SUCCESS) {
+        *size = (size_t)(end - base);
+    }
+    else if(ret == MSGPACK_UNPACK_CONTINUE) {
+        *size = len + need;
+    }
+    return ret;
+}
@@ -3,12 +3,29 @@
 #include <stdio.h>
 #include <msgpack.h>
 
+// a str/bin body which is not copied into sb, it has to be emitted at offset
+typedef struct _msgpack_sprintf_ref
+{
+    size_t offset;  // position in sb where the body belongs
+    const char *ptr;
+    size_t size;
+} msgpack_sprintf_ref;
+
+typedef struct _msgpack_sprintf_refs
+{
+    msgpack_sprintf_ref *array;
+    size_t count;
+    size_t alloc;
+    size_t ref_size;    // bodies of ref_size bytes or more are referenced
+} msgpack_sprintf_refs;
+
 // due msgpack nature.. it holds some data before finalize the object
 typedef struct _msgpack_sprintf_context
 {
     msgpack_packer *pk; // msgpack_packer object used to write
     msgpack_sbuffer *sb;    // msgpack_packer data is sbuf object .. used as backup
-    va_list         ap;
+    va_list         *ap;    // shared with nested objects
+    msgpack_sprintf_refs *refs; // NULL when bodies are always copied
 
     int flags;  // is an array or a map?
     size_t size;   // size reflects sb->size when the function is called
@@ -148,6 +165,53 @@ static void msgpack_sprintf_bulk(msgpack_packer *dst, msgpack_packer *src)
     msgpack_sbuffer_write(dst->data, sbuf_src->data, sbuf_src->size);
 }
 
+static int msgpack_sprintf_push_ref(msgpack_sprintf_refs *refs, size_t offset, const char *ptr, size_t size)
+{
+    if (refs->count == refs->alloc)
+    {
+        size_t nalloc = refs->alloc ? refs->alloc * 2 : 8;
+        msgpack_sprintf_ref *tmp = (msgpack_sprintf_ref *)msgpack_allocator_realloc(NULL, refs->array, sizeof(msgpack_sprintf_ref) * nalloc);
+        if (tmp == NULL)
+            return -1;
+        refs->array = tmp;
+        refs->alloc = nalloc;
+    }
+
+    refs->array[refs->count].offset = offset;
+    refs->array[refs->count].ptr = ptr;
+    refs->array[refs->count].size = size;
+    ++refs->count;
+    return 0;
+}
+
+/// @brief write a str or bin, the body is referenced instead of copied when
+/// the context collects references and the body is large enough (or forced by '&')
+/// @param ctx current context
+/// @param type MSGPACK_OBJECT_STR or MSGPACK_OBJECT_BIN
+/// @param ptr body
+/// @param size body length
+/// @param ref non zero if '&' was specified
+/// @return 0 on success
+static int msgpack_sprintf_pack_body(msgpack_sprintf_context *ctx, int type, const void *ptr, size_t size, int ref)
+{
+    msgpack_packer *pk = ctx->pk;
+
+    if (ctx->refs != NULL && size > 0 && (ref || size >= ctx->refs->ref_size))
+    {
+        int r = (type == MSGPACK_OBJECT_STR) ? msgpack_pack_str(pk, size) : msgpack_pack_bin(pk, size);
+        if (r != 0)
+            return r;
+        if (msgpack_sprintf_push_ref(ctx->refs, ctx->sb->size, (const char *)ptr, size) == 0)
+            return 0;
+        // out of memory for the reference.. fall back to a copy
+        return (type == MSGPACK_OBJECT_STR) ? msgpack_pack_str_body(pk, ptr, size) : msgpack_pack_bin_body(pk, ptr, size);
+    }
+
+    if (type == MSGPACK_OBJECT_STR)
+        return msgpack_pack_str_with_body(pk, ptr, size);
+    return msgpack_pack_bin_with_body(pk, ptr, size);
+}
+
 /**
  * parse the element after '%' and
  * @param pk
@@ -155,8 +219,10 @@ static void msgpack_sprintf_bulk(msgpack_packer *dst, msgpack_packer *src)
  * @param args
  * @return
  */
-static const char* msgpack_sprintf_pack_arg(msgpack_packer *pk, const char *fmt, va_list *ap)
+static const char* msgpack_sprintf_pack_arg(msgpack_sprintf_context *ctx, const char *fmt)
 {
+    msgpack_packer *pk = ctx->pk;
+    va_list *ap = ctx->ap;
     uint16_t u16;
     float f32; double f64;
     int32_t i32;
@@ -166,21 +232,27 @@ static const char* msgpack_sprintf_pack_arg(msgpack_packer *pk, const char *fmt,
     msgpack_packer new_pk;
     msgpack_sbuffer sbuf;
     uint8_t half = 0;
-    int loop_done;
+    uint8_t ref = 0;
+    uint8_t prefix;
 
     do
     {
         fmt++;
+        prefix = 0;
         switch(*fmt)
         {
             case 'h': half = 1; // half prefix
+                prefix = 1;
+                break;
+            case '&': ref = 1; // reference prefix, the body is not copied
+                prefix = 1;
                 break;
             case 's':
                 ptr = va_arg(*ap, void *);
                 if (ptr == NULL)
                     msgpack_pack_nil(pk);
                 else
-                    msgpack_pack_str_with_body(pk, ptr, strlen((const char *)ptr));
+                    msgpack_sprintf_pack_body(ctx, MSGPACK_OBJECT_STR, ptr, strlen((const char *)ptr), ref);
                 break;
             case 'S': // not yet supported;
                 break;
@@ -202,29 +274,28 @@ static const char* msgpack_sprintf_pack_arg(msgpack_packer *pk, const char *fmt,
             case 'p': // binary 8/16/32
                 ptr = va_arg(*ap, void *); // fetch pointer
                 u32 = va_arg(*ap, uint32_t);   // fetch size
-                msgpack_pack_bin_with_body(pk, ptr, u32);
+                msgpack_sprintf_pack_body(ctx, MSGPACK_OBJECT_BIN, ptr, u32, ref);
                 break;
             case 'f': // float
                 if (half)
                 {
-                    u16 = va_arg(*ap, uint16_t);    // BFLOAT16 .. easily mapped to float32
+                    u16 = (uint16_t)va_arg(*ap, int);    // BFLOAT16 .. easily mapped to float32, promoted to int
                     f32 = 0.0;
-                    u32 = (uint32_t)(u16 << 16);
-#if (MSGPACK_ENDIAN_LITTLE_BYTE == 1)
-                    u32 = _msgpack_be32(u32);
-#endif
+                    u32 = (uint32_t)u16 << 16;     // the high half of a float32, in host order
                     memcpy(&f32, &u32, sizeof(u32));
+                    msgpack_pack_float(pk, f32);
                 }
                 else
                 {
-                    f32 = va_arg(*ap, float);
+                    f32 = (float)va_arg(*ap, double);   // promoted to double
                     msgpack_pack_float(pk, f32);
                 }
+                half = 0;
                 break;
             case 'e': // float64
                 if (half)
                 {
-                    u16 = va_arg(*ap, uint16_t);
+                    u16 = (uint16_t)va_arg(*ap, int);
                     f32 = 0.0;
                     hf_to_float32(&f32, u16);
                     msgpack_pack_float(pk, f32);
@@ -238,7 +309,7 @@ static const char* msgpack_sprintf_pack_arg(msgpack_packer *pk, const char *fmt,
                 break;
             case 'i': //int
                 if (half)
-                    i32 = (int32_t)(va_arg(*ap, int16_t));
+                    i32 = (int16_t)va_arg(*ap, int);
                 else
                     i32 = va_arg(*ap, int);
                 msgpack_pack_int(pk, (int)i32);
@@ -246,7 +317,7 @@ static const char* msgpack_sprintf_pack_arg(msgpack_packer *pk, const char *fmt,
                 break;
             case 'u': //uint
                 if (half)
-                    u32 = (uint32_t)(va_arg(*ap, uint16_t));
+                    u32 = (uint16_t)va_arg(*ap, int);
                 else
                     u32 = va_arg(*ap, uint32_t);
                 msgpack_pack_unsigned_int(pk, u32);
@@ -265,7 +336,7 @@ static const char* msgpack_sprintf_pack_arg(msgpack_packer *pk, const char *fmt,
                 half = 0;
                 break;
         }
-    } while(half != 0);
+    } while(prefix != 0);
 
     return fmt;
 }
@@ -288,6 +359,7 @@ static const char *msgpack_sprintf_obj(msgpack_sprintf_context *ctx, const char
     tmp.size = ctx->sb->size;
     tmp.sb = ctx->sb;
     tmp.ap = ctx->ap;
+    tmp.refs = ctx->refs;
 
     if (ctx->flags == MSGPACK_OBJECT_MAP)
         msgpack_pack_map(ctx->pk, 65537); // force msgpack to write a map32
@@ -328,8 +400,8 @@ static const char *msgpack_sprintf_obj(msgpack_sprintf_context *ctx, const char
                 case '%':
                     if (fmt[1] == '!' && ctx->flags == MSGPACK_OBJECT_ARRAY)
                     {
-                        callback = va_arg(tmp.ap, msgpack_sprintf_callback);
-                        ptr = va_arg(tmp.ap, void*);
+                        callback = va_arg(*tmp.ap, msgpack_sprintf_callback);
+                        ptr = va_arg(*tmp.ap, void*);
                         msgpack_sbuffer_init(&sbuf);
                         msgpack_packer_init(&new_pk, &sbuf, msgpack_sbuffer_write);
 
@@ -346,7 +418,7 @@ static const char *msgpack_sprintf_obj(msgpack_sprintf_context *ctx, const char
                     }
                     else
                     {
-                        fmt = msgpack_sprintf_pack_arg(tmp.pk, fmt, &tmp.ap);
+                        fmt = msgpack_sprintf_pack_arg(&tmp, fmt);
                         done = 1;
                         ++object_size;
                     }
@@ -377,12 +449,11 @@ static const char *msgpack_sprintf_obj(msgpack_sprintf_context *ctx, const char
         } while(done == 0);
     }
 
-    ctx->ap = tmp.ap;
-
     if (object_size >= 0)  // we have a valid size.. so we can adjust the buffer
     {
         size_t data_off = tmp.size + 5;
         size_t data_len = ctx->sb->size - tmp.size - 5;
+        size_t i;
 
         ctx->sb->size = tmp.size;   // reset the pointer
 
@@ -391,7 +462,12 @@ static const char *msgpack_sprintf_obj(msgpack_sprintf_context *ctx, const char
         else
             msgpack_pack_array(ctx->pk, object_size);
 
-        memcpy(ctx->sb->data + ctx->sb->size, ctx->sb->data + data_off, data_len);  // transfer the bytes
+        memmove(ctx->sb->data + ctx->sb->size, ctx->sb->data + data_off, data_len);  // transfer the bytes
+
+        // references taken inside the sequence move back with their bytes
+        for (i = ctx->refs ? ctx->refs->count : 0; i > 0 && ctx->refs->array[i - 1].offset >= data_off; --i)
+            ctx->refs->array[i - 1].offset -= data_off - ctx->sb->size;
+
         ctx->sb->size += data_len;
     }
     else
@@ -399,32 +475,27 @@ static const char *msgpack_sprintf_obj(msgpack_sprintf_context *ctx, const char
         size_t clear_off = ctx->sb->size;
         ctx->sb->size = tmp.size;
 
+        while (ctx->refs && ctx->refs->count > 0 && ctx->refs->array[ctx->refs->count - 1].offset > tmp.size)
+            --ctx->refs->count;
+
         memset(ctx->sb->data + ctx->sb->size, 0, clear_off - tmp.size);
     }
     return fmt;
 }
 
-int msgpack_sprintf(msgpack_packer* pk, const char *fmt, ...)
+static void msgpack_sprintf_root(msgpack_sprintf_context *ctx, const char *fmt)
 {
-    msgpack_sprintf_context ctx;
-
-    ctx.pk = pk;
-    ctx.size = 0;
-    ctx.flags = 0;
-    ctx.sb = (msgpack_sbuffer *) pk->data;  // to improve map/array serialization, I need to rewrite data structure
-    va_start(ctx.ap, fmt);
-
     for(; *fmt != '\0'; ++fmt)
     {
         switch(*fmt)
         {
             case '[':
-                ctx.flags = MSGPACK_OBJECT_ARRAY;
-                fmt = msgpack_sprintf_obj(&ctx, ++fmt);
+                ctx->flags = MSGPACK_OBJECT_ARRAY;
+                fmt = msgpack_sprintf_obj(ctx, ++fmt);
                 break;
             case '{':
-                ctx.flags = MSGPACK_OBJECT_MAP;
-                fmt = msgpack_sprintf_obj(&ctx, ++fmt);
+                ctx->flags = MSGPACK_OBJECT_MAP;
+                fmt = msgpack_sprintf_obj(ctx, ++fmt);
                 break;
             case ' ':
                 break;
@@ -432,5 +503,69 @@ int msgpack_sprintf(msgpack_packer* pk, const char *fmt, ...)
                 break;
         }
     }
+}
+
+int msgpack_sprintf(msgpack_packer* pk, const char *fmt, ...)
+{
+    msgpack_sprintf_context ctx;
+    va_list ap;
+
+    ctx.pk = pk;
+    ctx.size = 0;
+    ctx.flags = 0;
+    ctx.sb = (msgpack_sbuffer *) pk->data;  // to improve map/array serialization, I need to rewrite data structure
+    ctx.refs = NULL;
+    ctx.ap = &ap;
+    va_start(ap, fmt);
+
+    msgpack_sprintf_root(&ctx, fmt);
+
+    va_end(ap);
     return 0;
+}
+
+int msgpack_sprintf_vrefbuffer(msgpack_vrefbuffer* vbuf, const char *fmt, ...)
+{
+    msgpack_sprintf_context ctx;
+    msgpack_sprintf_refs refs;
+    msgpack_sbuffer sbuf;
+    msgpack_packer pk;
+    va_list ap;
+    size_t pos = 0;
+    size_t i;
+    int ret = 0;
+
+    msgpack_sbuffer_init(&sbuf);
+    msgpack_packer_init(&pk, &sbuf, msgpack_sbuffer_write);
+
+    memset(&refs, 0, sizeof(refs));
+    refs.ref_size = vbuf->ref_size;
+
+    ctx.pk = &pk;
+    ctx.size = 0;
+    ctx.flags = 0;
+    ctx.sb = &sbuf;
+    ctx.refs = &refs;
+    ctx.ap = &ap;
+    va_start(ap, fmt);
+
+    msgpack_sprintf_root(&ctx, fmt);
+
+    va_end(ap);
+
+    // the envelope is copied, the referenced bodies are placed in between
+    for (i = 0; i < refs.count && ret == 0; ++i)
+    {
+        if (refs.array[i].offset > pos)
+            ret = msgpack_vrefbuffer_append_copy(vbuf, sbuf.data + pos, refs.array[i].offset - pos);
+        if (ret == 0)
+            ret = msgpack_vrefbuffer_append_ref(vbuf, refs.array[i].ptr, refs.array[i].size);
+        pos = refs.array[i].offset;
+    }
+    if (ret == 0 && sbuf.size > pos)
+        ret = msgpack_vrefbuffer_append_copy(vbuf, sbuf.data + pos, sbuf.size - pos);
+
+    msgpack_allocator_free(NULL, refs.array);
+    msgpack_sbuffer_destroy(&sbuf);
+    return ret;
 }
\ No newline at end of file
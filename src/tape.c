@@ -0,0 +1,307 @@
+/*
+ * MessagePack for C structural index
+ *
+ *    Distributed under the Boost Software License, Version 1.0.
+ *    (See accompanying file LICENSE_1_0.txt or copy at
+ *    http://www.boost.org/LICENSE_1_0.txt)
+ */
+#include "msgpack/tape.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define TAPE_INIT_SIZE 64
+
+static const char tape_magic[8] = { 'M', 'P', 'T', 'A', 'P', 'E', '\0', '\1' };
+
+typedef struct {
+    char magic[8];
+    uint32_t order;
+    uint32_t entry_size;
+    uint64_t data_len;
+    uint64_t count;
+    uint64_t nchildren;
+} tape_header;
+
+typedef struct {
+    uint32_t index;     /* tape index of the container */
+    uint32_t child;     /* next slot to fill in children */
+    size_t remaining;
+} tape_frame;
+
+
+void msgpack_tape_init(msgpack_tape* tape)
+{
+    memset(tape, 0, sizeof(msgpack_tape));
+}
+
+void msgpack_tape_destroy(msgpack_tape* tape)
+{
+    msgpack_allocator_free(NULL, tape->entries);
+    msgpack_allocator_free(NULL, tape->children);
+}
+
+static bool tape_reserve(void** array, size_t* alloc, size_t need, size_t size)
+{
+    size_t nalloc;
+    void* tmp;
+
+    if(need <= *alloc) {
+        return true;
+    }
+    nalloc = *alloc ? *alloc * 2 : TAPE_INIT_SIZE;
+    while(nalloc < need) {
+        nalloc *= 2;
+    }
+    if(nalloc > (size_t)-1 / size) {
+        return false;
+    }
+    tmp = msgpack_allocator_realloc(NULL, *array, nalloc * size);
+    if(tmp == NULL) {
+        return false;
+    }
+    *array = tmp;
+    *alloc = nalloc;
+    return true;
+}
+
+/* tells why the object at pos cannot be read */
+static msgpack_unpack_return tape_error(const char* data, size_t len, size_t pos)
+{
+    msgpack_unpack_return ret = msgpack_skip(data, len, &pos);
+    return ret == MSGPACK_UNPACK_CONTINUE ? MSGPACK_UNPACK_CONTINUE : MSGPACK_UNPACK_PARSE_ERROR;
+}
+
+msgpack_unpack_return msgpack_tape_build(msgpack_tape* tape,
+        const char* data, size_t len, size_t off)
+{
+    tape_frame* stack = NULL;
+    size_t depth = 0;
+    size_t stack_alloc = 0;
+    size_t pos = off;
+    msgpack_unpack_return ret = MSGPACK_UNPACK_SUCCESS;
+
+    tape->count = 0;
+    tape->nchildren = 0;
+    tape->data_len = 0;
+
+    if(!tape_reserve((void**)&stack, &stack_alloc, 1, sizeof(tape_frame))) {
+        return MSGPACK_UNPACK_NOMEM_ERROR;
+    }
+    /* the root is the only element of a pseudo container */
+    stack[0].index = MSGPACK_TAPE_NONE;
+    stack[0].child = 0;
+    stack[0].remaining = 1;
+    depth = 1;
+
+    while(depth > 0) {
+        tape_frame* f = &stack[depth - 1];
+        msgpack_cursor cur;
+        msgpack_object obj;
+        msgpack_tape_entry* e;
+        uint32_t index;
+
+        if(f->remaining == 0) {
+            if(f->index != MSGPACK_TAPE_NONE) {
+                e = &tape->entries[f->index];
+                e->end = pos;
+                e->next = (uint32_t)tape->count;
+            }
+            --depth;
+            continue;
+        }
+        --f->remaining;
+
+        msgpack_cursor_init(&cur, data, len, pos);
+        if(!msgpack_cursor_peek(&cur, &obj)) {
+            ret = tape_error(data, len, pos);
+            goto out;
+        }
+        if(tape->count >= MSGPACK_TAPE_NONE ||
+                !tape_reserve((void**)&tape->entries, &tape->alloc,
+                    tape->count + 1, sizeof(msgpack_tape_entry))) {
+            ret = MSGPACK_UNPACK_NOMEM_ERROR;
+            goto out;
+        }
+        index = (uint32_t)tape->count++;
+        if(f->index != MSGPACK_TAPE_NONE) {
+            tape->children[f->child++] = index;
+        }
+
+        e = &tape->entries[index];
+        e->offset = pos;
+        e->type = obj.type;
+        e->child = 0;
+
+        if(obj.type == MSGPACK_OBJECT_ARRAY || obj.type == MSGPACK_OBJECT_MAP) {
+            msgpack_cursor first;
+            size_t n = obj.type == MSGPACK_OBJECT_ARRAY ?
+                obj.via.array.size : (size_t)obj.via.map.size * 2;
+
+            msgpack_cursor_enter(&cur, &first);
+            pos = first.pos;
+            /* every element takes at least one byte */
+            if(n > len - pos) {
+                ret = MSGPACK_UNPACK_CONTINUE;
+                goto out;
+            }
+            if(!tape_reserve((void**)&tape->children, &tape->children_alloc,
+                        tape->nchildren + n, sizeof(uint32_t)) ||
+                    !tape_reserve((void**)&stack, &stack_alloc, depth + 1, sizeof(tape_frame))) {
+                ret = MSGPACK_UNPACK_NOMEM_ERROR;
+                goto out;
+            }
+            e->size = obj.via.array.size;
+            e->child = (uint32_t)tape->nchildren;
+            tape->nchildren += n;
+
+            stack[depth].index = index;
+            stack[depth].child = e->child;
+            stack[depth].remaining = n;
+            ++depth;
+        }
+        else {
+            switch(obj.type) {
+            case MSGPACK_OBJECT_STR:
+            case MSGPACK_OBJECT_BIN:
+                e->size = obj.via.str.size;
+                break;
+            case MSGPACK_OBJECT_EXT:
+                e->size = obj.via.ext.size;
+                break;
+            default:
+                e->size = 0;
+                break;
+            }
+            msgpack_skip(data, len, &pos);
+            e->end = pos;
+            e->next = index + 1;
+        }
+    }
+    tape->data_len = pos;
+
+out:
+    msgpack_allocator_free(NULL, stack);
+    if(ret != MSGPACK_UNPACK_SUCCESS) {
+        tape->count = 0;
+        tape->nchildren = 0;
+    }
+    return ret;
+}
+
+uint32_t msgpack_tape_find_key(const msgpack_tape* tape, const char* data,
+        uint32_t index, const char* key, size_t size)
+{
+    const msgpack_tape_entry* e = msgpack_tape_at(tape, index);
+    const uint32_t* it;
+    const uint32_t* end;
+
+    if(e == NULL || e->type != MSGPACK_OBJECT_MAP) {
+        return MSGPACK_TAPE_NONE;
+    }
+    it = tape->children + e->child;
+    end = it + (size_t)e->size * 2;
+    for(; it != end; it += 2) {
+        const msgpack_tape_entry* k = &tape->entries[*it];
+        /* the body ends the key, its header is before it */
+        if(k->type == MSGPACK_OBJECT_STR && k->size == size &&
+                memcmp(data + k->end - size, key, size) == 0) {
+            return it[1];
+        }
+    }
+    return MSGPACK_TAPE_NONE;
+}
+
+bool msgpack_tape_cursor(const msgpack_tape* tape, const char* data, uint32_t index,
+        msgpack_cursor* cur)
+{
+    const msgpack_tape_entry* e = msgpack_tape_at(tape, index);
+    if(e == NULL) {
+        return false;
+    }
+    msgpack_cursor_init(cur, data, (size_t)e->end, (size_t)e->offset);
+    return true;
+}
+
+int msgpack_tape_save(const msgpack_tape* tape,
+        int (*write)(void* data, const char* buf, size_t len), void* data)
+{
+    tape_header h;
+    int ret;
+
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, tape_magic, sizeof(h.magic));
+    h.order = 0x01020304;
+    h.entry_size = sizeof(msgpack_tape_entry);
+    h.data_len = tape->data_len;
+    h.count = tape->count;
+    h.nchildren = tape->nchildren;
+
+    ret = write(data, (const char*)&h, sizeof(h));
+    if(ret != 0) { return ret; }
+    ret = write(data, (const char*)tape->entries, tape->count * sizeof(msgpack_tape_entry));
+    if(ret != 0) { return ret; }
+    return write(data, (const char*)tape->children, tape->nchildren * sizeof(uint32_t));
+}
+
+bool msgpack_tape_load(msgpack_tape* tape, const char* buf, size_t len)
+{
+    tape_header h;
+    size_t entries_size;
+    size_t children_size;
+    size_t i;
+
+    if(len < sizeof(h)) {
+        return false;
+    }
+    memcpy(&h, buf, sizeof(h));
+    if(memcmp(h.magic, tape_magic, sizeof(h.magic)) != 0 ||
+            h.order != 0x01020304 || h.entry_size != sizeof(msgpack_tape_entry) ||
+            h.count >= MSGPACK_TAPE_NONE || h.nchildren >= h.count + 1 ||
+            h.count > (size_t)-1 / sizeof(msgpack_tape_entry) / 2) {
+        return false;
+    }
+    entries_size = (size_t)h.count * sizeof(msgpack_tape_entry);
+    children_size = (size_t)h.nchildren * sizeof(uint32_t);
+    if(len - sizeof(h) < entries_size + children_size) {
+        return false;
+    }
+
+    tape->count = 0;
+    tape->nchildren = 0;
+    if(!tape_reserve((void**)&tape->entries, &tape->alloc,
+                (size_t)h.count, sizeof(msgpack_tape_entry)) ||
+            !tape_reserve((void**)&tape->children, &tape->children_alloc,
+                (size_t)h.nchildren, sizeof(uint32_t))) {
+        return false;
+    }
+    memcpy(tape->entries, buf + sizeof(h), entries_size);
+    memcpy(tape->children, buf + sizeof(h) + entries_size, children_size);
+
+    /* msgpack_tape_child trusts the indexes */
+    for(i = 0; i < h.nchildren; ++i) {
+        if(tape->children[i] >= h.count) {
+            return false;
+        }
+    }
+    /* and the readers the offsets, once data_len is checked */
+    for(i = 0; i < h.count; ++i) {
+        const msgpack_tape_entry* e = &tape->entries[i];
+        if(e->end > h.data_len || e->offset >= e->end ||
+                e->next <= i || e->next > h.count) {
+            return false;
+        }
+        if((e->type == MSGPACK_OBJECT_ARRAY && e->child + (uint64_t)e->size > h.nchildren) ||
+                (e->type == MSGPACK_OBJECT_MAP && e->child + (uint64_t)e->size * 2 > h.nchildren)) {
+            return false;
+        }
+        if((e->type == MSGPACK_OBJECT_STR || e->type == MSGPACK_OBJECT_BIN ||
+                    e->type == MSGPACK_OBJECT_EXT) && e->size > e->end - e->offset) {
+            return false;
+        }
+    }
+
+    tape->count = (size_t)h.count;
+    tape->nchildren = (size_t)h.nchildren;
+    tape->data_len = h.data_len;
+    return true;
+}
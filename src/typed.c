@@ -0,0 +1,543 @@
+/*
+ * MessagePack for C typed array decoding
+ *
+ *    Distributed under the Boost Software License, Version 1.0.
+ *    (See accompanying file LICENSE_1_0.txt or copy at
+ *    http://www.boost.org/LICENSE_1_0.txt)
+ */
+#include "msgpack/typed.h"
+#include "msgpack/sysdep.h"
+#include <stdlib.h>
+#include <string.h>
+
+
+typedef enum {
+    TYPED_INT64,
+    TYPED_DOUBLE,
+    TYPED_FLOAT
+} typed_kind;
+
+#define COLUMNS_NONE ((uint32_t)-1)
+
+#define TYPED_FIXINT(b) ((b) <= 0x7f || (b) >= 0xe0)
+
+/*
+ * Decodes the elements while they have the type byte tag and fit before end.
+ * Each run loop only checks the type byte, so a long run of same width
+ * elements is a plain load, byte swap and store sequence.
+ */
+#define TYPED_RUN(tag, width, store) \
+    while(i < n && (size_t)(end - p) > (width) && *p == (tag)) { \
+        store; \
+        p += 1 + (width); \
+        ++i; \
+    }
+
+static inline double typed_load_float(const unsigned char* p)
+{
+    union { uint32_t i; float f; } mem;
+    _msgpack_load32(uint32_t, p, &mem.i);
+    return mem.f;
+}
+
+static inline double typed_load_double(const unsigned char* p)
+{
+    union { uint64_t i; double f; } mem;
+    _msgpack_load64(uint64_t, p, &mem.i);
+#if defined(__arm__) && !(__ARM_EABI__) && !defined(TARGET_OS_IPHONE)
+    /* arm-oabi stores the words of a double swapped */
+    mem.i = (mem.i & 0xFFFFFFFFUL) << 32UL | (mem.i >> 32UL);
+#endif
+    return mem.f;
+}
+
+static size_t typed_int64(const unsigned char** pp, const unsigned char* end,
+        int64_t* out, size_t n)
+{
+    const unsigned char* p = *pp;
+    size_t i = 0;
+
+    while(i < n && p < end) {
+        size_t start = i;
+
+        if(TYPED_FIXINT(*p)) {
+            do {
+                out[i++] = (int8_t)*p++;
+            } while(i < n && p < end && TYPED_FIXINT(*p));
+            continue;
+        }
+
+        switch(*p) {
+        case 0xcc:
+            TYPED_RUN(0xcc, 1, out[i] = p[1]);
+            break;
+        case 0xcd:
+            TYPED_RUN(0xcd, 2, { uint16_t v; _msgpack_load16(uint16_t, p + 1, &v); out[i] = v; });
+            break;
+        case 0xce:
+            TYPED_RUN(0xce, 4, { uint32_t v; _msgpack_load32(uint32_t, p + 1, &v); out[i] = v; });
+            break;
+        case 0xcf:
+            while(i < n && (size_t)(end - p) > 8 && *p == 0xcf) {
+                uint64_t v;
+                _msgpack_load64(uint64_t, p + 1, &v);
+                if(v > (uint64_t)INT64_MAX) {
+                    break;
+                }
+                out[i++] = (int64_t)v;
+                p += 9;
+            }
+            break;
+        case 0xd0:
+            TYPED_RUN(0xd0, 1, out[i] = (int8_t)p[1]);
+            break;
+        case 0xd1:
+            TYPED_RUN(0xd1, 2, { int16_t v; _msgpack_load16(int16_t, p + 1, &v); out[i] = v; });
+            break;
+        case 0xd2:
+            TYPED_RUN(0xd2, 4, { int32_t v; _msgpack_load32(int32_t, p + 1, &v); out[i] = v; });
+            break;
+        case 0xd3:
+            TYPED_RUN(0xd3, 8, { int64_t v; _msgpack_load64(int64_t, p + 1, &v); out[i] = v; });
+            break;
+        default:
+            break;
+        }
+        if(i == start) {
+            break;
+        }
+    }
+    *pp = p;
+    return i;
+}
+
+/* decodes one non fixint integer as a double, returns its size or 0 */
+static size_t typed_int_as_double(const unsigned char* p, const unsigned char* end, double* v)
+{
+    size_t avail = (size_t)(end - p);
+
+    switch(*p) {
+    case 0xcc:
+        if(avail < 2) { return 0; }
+        *v = p[1];
+        return 2;
+    case 0xcd:
+        if(avail < 3) { return 0; }
+        { uint16_t t; _msgpack_load16(uint16_t, p + 1, &t); *v = t; }
+        return 3;
+    case 0xce:
+        if(avail < 5) { return 0; }
+        { uint32_t t; _msgpack_load32(uint32_t, p + 1, &t); *v = t; }
+        return 5;
+    case 0xcf:
+        if(avail < 9) { return 0; }
+        { uint64_t t; _msgpack_load64(uint64_t, p + 1, &t); *v = (double)t; }
+        return 9;
+    case 0xd0:
+        if(avail < 2) { return 0; }
+        *v = (int8_t)p[1];
+        return 2;
+    case 0xd1:
+        if(avail < 3) { return 0; }
+        { int16_t t; _msgpack_load16(int16_t, p + 1, &t); *v = t; }
+        return 3;
+    case 0xd2:
+        if(avail < 5) { return 0; }
+        { int32_t t; _msgpack_load32(int32_t, p + 1, &t); *v = t; }
+        return 5;
+    case 0xd3:
+        if(avail < 9) { return 0; }
+        { int64_t t; _msgpack_load64(int64_t, p + 1, &t); *v = (double)t; }
+        return 9;
+    default:
+        return 0;
+    }
+}
+
+/* exactly one of d and f is not NULL */
+static inline size_t typed_real(const unsigned char** pp, const unsigned char* end,
+        double* d, float* f, size_t n)
+{
+    const unsigned char* p = *pp;
+    size_t i = 0;
+
+    while(i < n && p < end) {
+        size_t start = i;
+
+        switch(*p) {
+        case 0xca:
+            if(d != NULL) {
+                TYPED_RUN(0xca, 4, d[i] = typed_load_float(p + 1));
+            }
+            else {
+                TYPED_RUN(0xca, 4, f[i] = (float)typed_load_float(p + 1));
+            }
+            break;
+        case 0xcb:
+            if(d != NULL) {
+                TYPED_RUN(0xcb, 8, d[i] = typed_load_double(p + 1));
+            }
+            else {
+                TYPED_RUN(0xcb, 8, f[i] = (float)typed_load_double(p + 1));
+            }
+            break;
+        default:
+            if(TYPED_FIXINT(*p)) {
+                do {
+                    if(d != NULL) { d[i] = (int8_t)*p; }
+                    else { f[i] = (int8_t)*p; }
+                    ++i;
+                    ++p;
+                } while(i < n && p < end && TYPED_FIXINT(*p));
+            }
+            else {
+                double v;
+                size_t size = typed_int_as_double(p, end, &v);
+                if(size > 0) {
+                    if(d != NULL) { d[i] = v; }
+                    else { f[i] = (float)v; }
+                    ++i;
+                    p += size;
+                }
+            }
+            break;
+        }
+        if(i == start) {
+            break;
+        }
+    }
+    *pp = p;
+    return i;
+}
+
+static size_t typed_decode(typed_kind kind, const unsigned char** pp, const unsigned char* end,
+        void* out, size_t n)
+{
+    switch(kind) {
+    case TYPED_INT64:
+        return typed_int64(pp, end, (int64_t*)out, n);
+    case TYPED_DOUBLE:
+        return typed_real(pp, end, (double*)out, NULL, n);
+    default:
+        return typed_real(pp, end, NULL, (float*)out, n);
+    }
+}
+
+static size_t typed_cursor(const msgpack_cursor* cur, typed_kind kind, void* out, size_t cap)
+{
+    msgpack_cursor child;
+    const unsigned char* p;
+    size_t n;
+
+    if(msgpack_cursor_type(cur) != MSGPACK_OBJECT_ARRAY ||
+            !msgpack_cursor_enter(cur, &child)) {
+        return 0;
+    }
+    n = child.left < cap ? child.left : cap;
+    p = (const unsigned char*)child.data + child.pos;
+    return typed_decode(kind, &p, (const unsigned char*)child.data + child.len, out, n);
+}
+
+static msgpack_unpack_return typed_unpack(const char* data, size_t len, size_t* off,
+        typed_kind kind, void* out, size_t cap, size_t* count)
+{
+    size_t noff = 0;
+    msgpack_cursor cur;
+    msgpack_cursor child;
+    msgpack_object head;
+    const unsigned char* p;
+    size_t decoded;
+    msgpack_unpack_return ret;
+
+    if(off != NULL) { noff = *off; }
+    *count = 0;
+
+    msgpack_cursor_init(&cur, data, len, noff);
+    if(!msgpack_cursor_peek(&cur, &head)) {
+        ret = msgpack_skip(data, len, &noff);
+        return ret == MSGPACK_UNPACK_CONTINUE ? MSGPACK_UNPACK_CONTINUE : MSGPACK_UNPACK_PARSE_ERROR;
+    }
+    if(head.type != MSGPACK_OBJECT_ARRAY) {
+        return MSGPACK_UNPACK_PARSE_ERROR;
+    }
+    if(head.via.array.size > cap) {
+        *count = head.via.array.size;
+        return MSGPACK_UNPACK_NOMEM_ERROR;
+    }
+
+    msgpack_cursor_enter(&cur, &child);
+    p = (const unsigned char*)data + child.pos;
+    decoded = typed_decode(kind, &p, (const unsigned char*)data + len, out, head.via.array.size);
+    *count = decoded;
+
+    if(decoded < head.via.array.size) {
+        /* tells a truncated array from a non-conforming element */
+        ret = msgpack_skip(data, len, &noff);
+        return ret == MSGPACK_UNPACK_CONTINUE ? MSGPACK_UNPACK_CONTINUE : MSGPACK_UNPACK_PARSE_ERROR;
+    }
+
+    noff = (size_t)(p - (const unsigned char*)data);
+    if(off != NULL) { *off = noff; }
+
+    if(noff < len) {
+        return MSGPACK_UNPACK_EXTRA_BYTES;
+    }
+    return MSGPACK_UNPACK_SUCCESS;
+}
+
+
+msgpack_unpack_return
+msgpack_unpack_int64_array(const char* data, size_t len, size_t* off,
+        int64_t* out, size_t cap, size_t* count)
+{
+    return typed_unpack(data, len, off, TYPED_INT64, out, cap, count);
+}
+
+msgpack_unpack_return
+msgpack_unpack_double_array(const char* data, size_t len, size_t* off,
+        double* out, size_t cap, size_t* count)
+{
+    return typed_unpack(data, len, off, TYPED_DOUBLE, out, cap, count);
+}
+
+msgpack_unpack_return
+msgpack_unpack_float_array(const char* data, size_t len, size_t* off,
+        float* out, size_t cap, size_t* count)
+{
+    return typed_unpack(data, len, off, TYPED_FLOAT, out, cap, count);
+}
+
+size_t msgpack_cursor_int64_array(const msgpack_cursor* cur, int64_t* out, size_t cap)
+{
+    return typed_cursor(cur, TYPED_INT64, out, cap);
+}
+
+size_t msgpack_cursor_double_array(const msgpack_cursor* cur, double* out, size_t cap)
+{
+    return typed_cursor(cur, TYPED_DOUBLE, out, cap);
+}
+
+size_t msgpack_cursor_float_array(const msgpack_cursor* cur, float* out, size_t cap)
+{
+    return typed_cursor(cur, TYPED_FLOAT, out, cap);
+}
+
+
+bool msgpack_columns_init(msgpack_columns* cols, msgpack_column* columns, size_t count)
+{
+    memset(cols, 0, sizeof(msgpack_columns));
+    if(count >= COLUMNS_NONE) {
+        return false;
+    }
+    cols->seen = (size_t*)msgpack_allocator_malloc(NULL, (count > 0 ? count : 1) * sizeof(size_t));
+    if(cols->seen == NULL) {
+        return false;
+    }
+    memset(cols->seen, 0, (count > 0 ? count : 1) * sizeof(size_t));
+    cols->columns = columns;
+    cols->count = count;
+    return true;
+}
+
+void msgpack_columns_destroy(msgpack_columns* cols)
+{
+    msgpack_allocator_free(NULL, cols->order);
+    msgpack_allocator_free(NULL, cols->seen);
+}
+
+static size_t columns_value_size(msgpack_column_type type)
+{
+    switch(type) {
+    case MSGPACK_COLUMN_INT64:
+        return sizeof(int64_t);
+    case MSGPACK_COLUMN_DOUBLE:
+        return sizeof(double);
+    case MSGPACK_COLUMN_FLOAT:
+        return sizeof(float);
+    case MSGPACK_COLUMN_BOOL:
+        return sizeof(bool);
+    default:
+        return sizeof(msgpack_object_str);
+    }
+}
+
+static uint32_t columns_find(const msgpack_columns* cols, const char* key, uint32_t size)
+{
+    size_t c;
+    for(c = 0; c < cols->count; ++c) {
+        const msgpack_column* col = &cols->columns[c];
+        if(col->key_size == size && memcmp(col->key, key, size) == 0) {
+            return (uint32_t)c;
+        }
+    }
+    return COLUMNS_NONE;
+}
+
+static bool columns_grow_order(msgpack_columns* cols)
+{
+    size_t nalloc = cols->order_alloc ? cols->order_alloc * 2 : 16;
+    uint32_t* tmp = (uint32_t*)msgpack_allocator_realloc(NULL, cols->order, nalloc * sizeof(uint32_t));
+    if(tmp == NULL) {
+        return false;
+    }
+    cols->order = tmp;
+    cols->order_alloc = nalloc;
+    return true;
+}
+
+/* the column of the key at position j, from the cached order if it repeats */
+static uint32_t columns_lookup(msgpack_columns* cols, size_t j, const char* key, uint32_t size)
+{
+    uint32_t c;
+
+    if(j < cols->order_size) {
+        c = cols->order[j];
+        if(c != COLUMNS_NONE && cols->columns[c].key_size == size &&
+                memcmp(cols->columns[c].key, key, size) == 0) {
+            return c;
+        }
+    }
+
+    c = columns_find(cols, key, size);
+    /* a failed allocation only costs the cache */
+    if(j < cols->order_size) {
+        cols->order[j] = c;
+    }
+    else if(j == cols->order_size &&
+            (j < cols->order_alloc || columns_grow_order(cols))) {
+        cols->order[cols->order_size++] = c;
+    }
+    return c;
+}
+
+/* false if the value does not conform; nil leaves the column unset */
+static bool columns_set(msgpack_columns* cols, uint32_t c, const msgpack_cursor* cur, size_t row)
+{
+    const msgpack_column* col = &cols->columns[c];
+    double d;
+
+    if(msgpack_cursor_type(cur) == MSGPACK_OBJECT_NIL) {
+        return true;
+    }
+    switch(col->type) {
+    case MSGPACK_COLUMN_INT64:
+        if(!msgpack_cursor_as_int(cur, (int64_t*)col->values + row)) { return false; }
+        break;
+    case MSGPACK_COLUMN_DOUBLE:
+        if(!msgpack_cursor_as_double(cur, (double*)col->values + row)) { return false; }
+        break;
+    case MSGPACK_COLUMN_FLOAT:
+        if(!msgpack_cursor_as_double(cur, &d)) { return false; }
+        ((float*)col->values)[row] = (float)d;
+        break;
+    case MSGPACK_COLUMN_BOOL:
+        if(!msgpack_cursor_as_bool(cur, (bool*)col->values + row)) { return false; }
+        break;
+    case MSGPACK_COLUMN_STR: {
+        msgpack_object_str* s = (msgpack_object_str*)col->values + row;
+        if(!msgpack_cursor_as_str(cur, &s->ptr, &s->size)) { return false; }
+        break;
+    }
+    }
+    cols->seen[c] = row + 1;
+    return true;
+}
+
+/* decodes the map at row.pos, *end gets the offset after it */
+static bool columns_row(msgpack_columns* cols, const msgpack_cursor* row, size_t r, size_t* end)
+{
+    msgpack_cursor it;
+    size_t j;
+    size_t c;
+
+    if(msgpack_cursor_type(row) != MSGPACK_OBJECT_MAP || !msgpack_cursor_enter(row, &it)) {
+        return false;
+    }
+    for(j = 0; msgpack_cursor_valid(&it); ++j) {
+        const char* key;
+        uint32_t size;
+        uint32_t col = COLUMNS_NONE;
+
+        if(msgpack_cursor_as_str(&it, &key, &size)) {
+            col = columns_lookup(cols, j, key, size);
+        }
+        msgpack_cursor_next(&it);
+        if(col != COLUMNS_NONE && !columns_set(cols, col, &it, r)) {
+            return false;
+        }
+        msgpack_cursor_next(&it);
+    }
+    *end = it.pos;
+
+    for(c = 0; c < cols->count; ++c) {
+        const msgpack_column* col = &cols->columns[c];
+        if(cols->seen[c] == r + 1) {
+            if(col->present != NULL) { col->present[r] = true; }
+            continue;
+        }
+        if(col->present == NULL) {
+            return false;
+        }
+        col->present[r] = false;
+        memset((char*)col->values + r * columns_value_size(col->type), 0,
+                columns_value_size(col->type));
+    }
+    return true;
+}
+
+msgpack_unpack_return
+msgpack_columns_unpack(msgpack_columns* cols, const char* data, size_t len, size_t* off,
+        size_t cap, size_t* rows)
+{
+    size_t noff = 0;
+    size_t end;
+    size_t pos;
+    size_t r;
+    size_t c;
+    msgpack_cursor cur;
+    msgpack_cursor row;
+    msgpack_object head;
+    msgpack_unpack_return ret;
+
+    if(off != NULL) { noff = *off; }
+    *rows = 0;
+
+    /* validates the whole array first, the rows are then decoded without checks */
+    end = noff;
+    ret = msgpack_skip(data, len, &end);
+    if(ret != MSGPACK_UNPACK_SUCCESS) {
+        return ret;
+    }
+
+    msgpack_cursor_init(&cur, data, end, noff);
+    if(!msgpack_cursor_peek(&cur, &head) || head.type != MSGPACK_OBJECT_ARRAY) {
+        return MSGPACK_UNPACK_PARSE_ERROR;
+    }
+    if(head.via.array.size > cap) {
+        *rows = head.via.array.size;
+        return MSGPACK_UNPACK_NOMEM_ERROR;
+    }
+
+    /* seen holds row numbers of the previous call */
+    for(c = 0; c < cols->count; ++c) {
+        cols->seen[c] = 0;
+    }
+
+    msgpack_cursor_enter(&cur, &row);
+    pos = row.pos;
+    for(r = 0; r < head.via.array.size; ++r) {
+        msgpack_cursor_init(&row, data, end, pos);
+        if(!columns_row(cols, &row, r, &pos)) {
+            *rows = r;
+            return MSGPACK_UNPACK_PARSE_ERROR;
+        }
+    }
+    *rows = r;
+
+    if(off != NULL) { *off = end; }
+
+    if(end < len) {
+        return MSGPACK_UNPACK_EXTRA_BYTES;
+    }
+    return MSGPACK_UNPACK_SUCCESS;
+}
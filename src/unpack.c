@@ -7,6 +7,9 @@
  *    (See accompanying file LICENSE_1_0.txt or copy at
  *    http://www.boost.org/LICENSE_1_0.txt)
  */
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE     /* memfd_create */
+#endif
 #include "msgpack/unpack.h"
 #include "msgpack/unpack_define.h"
 #include "msgpack/util.h"
@@ -16,10 +19,31 @@
 #include _msgpack_atomic_counter_header
 #endif
 
+#if !defined(_WIN32)
+#include <errno.h>
+#include <unistd.h>
+#endif
+
+#if defined(__linux__)
+#include <sys/mman.h>
+#if defined(MFD_CLOEXEC)
+#define UNPACKER_RING 1
+#endif
+#endif
+
+
+struct unpack_borrowed;
 
 typedef struct {
     msgpack_zone** z;
     bool referenced;
+    msgpack_zone_pool* pool;    /* where new zones come from, if any */
+    msgpack_zone_pool* z_pool;  /* the pool *z came from */
+    struct unpack_borrowed* borrowed;       /* pushed buffers to parse */
+    struct unpack_borrowed* borrowed_tail;
+    size_t borrowed_size;                   /* bytes left in them */
+    size_t read_size;       /* of the next msgpack_unpacker_read_fd */
+    size_t message_avg;     /* moving average of the message sizes */
 } unpack_user;
 
 
@@ -48,6 +72,22 @@ static int template_execute(
     template_context* ctx, const char* data, size_t len, size_t* off);
 
 
+/* makes sure the objects have a zone */
+static inline bool unpack_zone(unpack_user* u)
+{
+    if(*u->z != NULL) {
+        return true;
+    }
+    if(u->pool != NULL) {
+        *u->z = msgpack_zone_pool_get(u->pool);
+        u->z_pool = *u->z != NULL ? u->pool : NULL;
+    }
+    else {
+        *u->z = msgpack_zone_new(MSGPACK_ZONE_CHUNK_SIZE);
+    }
+    return *u->z != NULL;
+}
+
 static inline msgpack_object template_callback_root(unpack_user* u)
 {
     msgpack_object o;
@@ -204,11 +244,8 @@ static inline int template_callback_array(unpack_user* u, unsigned int n, msgpac
 
     size = n * sizeof(msgpack_object);
 
-    if (*u->z == NULL) {
-        *u->z = msgpack_zone_new(MSGPACK_ZONE_CHUNK_SIZE);
-        if(*u->z == NULL) {
-            return MSGPACK_UNPACK_NOMEM_ERROR;
-        }
+    if(!unpack_zone(u)) {
+        return MSGPACK_UNPACK_NOMEM_ERROR;
     }
 
     // Unsure whether size = 0 should be an error, and if so, what to return
@@ -229,6 +266,13 @@ static inline int template_callback_array_item(unpack_user* u, msgpack_object* c
     return 0;
 }
 
+static inline int template_callback_array_end(unpack_user* u, msgpack_object* c)
+{
+    MSGPACK_UNUSED(u);
+    MSGPACK_UNUSED(c);
+    return 0;
+}
+
 static inline int template_callback_map(unpack_user* u, unsigned int n, msgpack_object* o)
 {
     size_t size;
@@ -248,11 +292,8 @@ static inline int template_callback_map(unpack_user* u, unsigned int n, msgpack_
 
     size = n * sizeof(msgpack_object_kv);
 
-    if (*u->z == NULL) {
-        *u->z = msgpack_zone_new(MSGPACK_ZONE_CHUNK_SIZE);
-        if(*u->z == NULL) {
-            return MSGPACK_UNPACK_NOMEM_ERROR;
-        }
+    if(!unpack_zone(u)) {
+        return MSGPACK_UNPACK_NOMEM_ERROR;
     }
 
     // Should size = 0 be an error? If so, what error to return?
@@ -275,14 +316,18 @@ static inline int template_callback_map_item(unpack_user* u, msgpack_object* c,
     return 0;
 }
 
+static inline int template_callback_map_end(unpack_user* u, msgpack_object* c)
+{
+    MSGPACK_UNUSED(u);
+    MSGPACK_UNUSED(c);
+    return 0;
+}
+
 static inline int template_callback_str(unpack_user* u, const char* b, const char* p, unsigned int l, msgpack_object* o)
 {
     MSGPACK_UNUSED(b);
-    if (*u->z == NULL) {
-        *u->z = msgpack_zone_new(MSGPACK_ZONE_CHUNK_SIZE);
-        if(*u->z == NULL) {
-            return MSGPACK_UNPACK_NOMEM_ERROR;
-        }
+    if(!unpack_zone(u)) {
+        return MSGPACK_UNPACK_NOMEM_ERROR;
     }
     o->type = MSGPACK_OBJECT_STR;
     o->via.str.ptr = p;
@@ -294,11 +339,8 @@ static inline int template_callback_str(unpack_user* u, const char* b, const cha
 static inline int template_callback_bin(unpack_user* u, const char* b, const char* p, unsigned int l, msgpack_object* o)
 {
     MSGPACK_UNUSED(b);
-    if (*u->z == NULL) {
-        *u->z = msgpack_zone_new(MSGPACK_ZONE_CHUNK_SIZE);
-        if(*u->z == NULL) {
-            return MSGPACK_UNPACK_NOMEM_ERROR;
-        }
+    if(!unpack_zone(u)) {
+        return MSGPACK_UNPACK_NOMEM_ERROR;
     }
     o->type = MSGPACK_OBJECT_BIN;
     o->via.bin.ptr = p;
@@ -313,11 +355,8 @@ static inline int template_callback_ext(unpack_user* u, const char* b, const cha
     if (l == 0) {
         return MSGPACK_UNPACK_PARSE_ERROR;
     }
-    if (*u->z == NULL) {
-        *u->z = msgpack_zone_new(MSGPACK_ZONE_CHUNK_SIZE);
-        if(*u->z == NULL) {
-            return MSGPACK_UNPACK_NOMEM_ERROR;
-        }
+    if(!unpack_zone(u)) {
+        return MSGPACK_UNPACK_NOMEM_ERROR;
     }
     o->type = MSGPACK_OBJECT_EXT;
     o->via.ext.type = *p;
@@ -333,26 +372,72 @@ static inline int template_callback_ext(unpack_user* u, const char* b, const cha
 #define CTX_CAST(m) ((template_context*)(m))
 #define CTX_REFERENCED(mpac) CTX_CAST((mpac)->ctx)->user.referenced
 
-#define COUNTER_SIZE (sizeof(_msgpack_atomic_counter_t))
+/* the head of every buffer, the last result referencing it frees it */
+typedef struct {
+    _msgpack_atomic_counter_t count;
+    const msgpack_allocator* allocator;
+    bool atomic;    /* false: results stay on the unpacker thread */
+    size_t ring;        /* ring size, 0 for a heap buffer */
+    size_t ring_base;   /* offset of the ring, mapped twice in a row */
+    size_t ring_mark;   /* first byte results may reference */
+    size_t start;       /* offset of the message being parsed */
+} buffer_header;
+
+static void ring_unmap(buffer_header* h);
 
+#define COUNTER_SIZE (sizeof(buffer_header))
 
-static inline void init_count(void* buffer)
+
+static inline void init_count(void* buffer, const msgpack_allocator* allocator, bool atomic)
 {
+    buffer_header* h = (buffer_header*)buffer;
     *(volatile _msgpack_atomic_counter_t*)buffer = 1;
+    h->allocator = allocator;
+    h->atomic = atomic;
+    h->ring = 0;
+    h->ring_base = 0;
+    h->ring_mark = 0;
+    h->start = COUNTER_SIZE;
+}
+
+static inline const msgpack_allocator* buffer_allocator(void* buffer)
+{
+    return ((buffer_header*)buffer)->allocator;
+}
+
+/* true when the last reference is gone */
+static inline bool drop_count(buffer_header* h)
+{
+    if(h->atomic) {
+        // atomic --*(_msgpack_atomic_counter_t*)buffer == 0
+        return _msgpack_sync_decr_and_fetch((volatile _msgpack_atomic_counter_t*)h) == 0;
+    }
+    return --h->count == 0;
 }
 
 static inline void decr_count(void* buffer)
 {
-    // atomic if(--*(_msgpack_atomic_counter_t*)buffer == 0) { free(buffer); }
-    if(_msgpack_sync_decr_and_fetch((volatile _msgpack_atomic_counter_t*)buffer) == 0) {
-        free(buffer);
+    buffer_header* h = (buffer_header*)buffer;
+    if(!drop_count(h)) {
+        return;
     }
+    if(h->ring != 0) {
+        ring_unmap(h);
+        return;
+    }
+    msgpack_allocator_free(h->allocator, buffer);
 }
 
 static inline void incr_count(void* buffer)
 {
-    // atomic ++*(_msgpack_atomic_counter_t*)buffer;
-    _msgpack_sync_incr_and_fetch((volatile _msgpack_atomic_counter_t*)buffer);
+    buffer_header* h = (buffer_header*)buffer;
+    if(h->atomic) {
+        // atomic ++*(_msgpack_atomic_counter_t*)buffer;
+        _msgpack_sync_incr_and_fetch((volatile _msgpack_atomic_counter_t*)buffer);
+    }
+    else {
+        ++h->count;
+    }
 }
 
 static inline _msgpack_atomic_counter_t get_count(void* buffer)
@@ -361,6 +446,12 @@ static inline _msgpack_atomic_counter_t get_count(void* buffer)
 }
 
 bool msgpack_unpacker_init(msgpack_unpacker* mpac, size_t initial_buffer_size)
+{
+    return msgpack_unpacker_init_with_allocator(mpac, initial_buffer_size, NULL);
+}
+
+bool msgpack_unpacker_init_with_allocator(msgpack_unpacker* mpac, size_t initial_buffer_size,
+        const msgpack_allocator* allocator)
 {
     char* buffer;
     void* ctx;
@@ -369,14 +460,14 @@ bool msgpack_unpacker_init(msgpack_unpacker* mpac, size_t initial_buffer_size)
         initial_buffer_size = COUNTER_SIZE;
     }
 
-    buffer = (char*)malloc(initial_buffer_size);
+    buffer = (char*)msgpack_allocator_malloc(allocator, initial_buffer_size);
     if(buffer == NULL) {
         return false;
     }
 
-    ctx = malloc(sizeof(template_context));
+    ctx = msgpack_allocator_malloc(allocator, sizeof(template_context));
     if(ctx == NULL) {
-        free(buffer);
+        msgpack_allocator_free(allocator, buffer);
         return false;
     }
 
@@ -389,31 +480,184 @@ bool msgpack_unpacker_init(msgpack_unpacker* mpac, size_t initial_buffer_size)
     mpac->z = NULL;
     mpac->ctx = ctx;
 
-    init_count(mpac->buffer);
+    init_count(mpac->buffer, allocator, true);
 
     template_init(CTX_CAST(mpac->ctx));
     CTX_CAST(mpac->ctx)->user.z = &mpac->z;
     CTX_CAST(mpac->ctx)->user.referenced = false;
+    CTX_CAST(mpac->ctx)->user.pool = NULL;
+    CTX_CAST(mpac->ctx)->user.z_pool = NULL;
+    CTX_CAST(mpac->ctx)->user.borrowed = NULL;
+    CTX_CAST(mpac->ctx)->user.borrowed_tail = NULL;
+    CTX_CAST(mpac->ctx)->user.borrowed_size = 0;
+    CTX_CAST(mpac->ctx)->user.read_size = MSGPACK_UNPACKER_RESERVE_SIZE;
+    CTX_CAST(mpac->ctx)->user.message_avg = 0;
 
     return true;
 }
 
+/*
+ * A pushed buffer: the unpacker holds a reference while it is queued, and
+ * the zone of each result with an object pointing into it one more.
+ */
+typedef struct unpack_borrowed {
+    buffer_header header;
+    struct unpack_borrowed* next;
+    const char* data;
+    size_t size;
+    size_t off;
+    msgpack_unpacker_release release;
+    void* ctx;
+} unpack_borrowed;
+
+static void borrowed_decr(void* borrowed)
+{
+    unpack_borrowed* b = (unpack_borrowed*)borrowed;
+    if(!drop_count(&b->header)) {
+        return;
+    }
+    if(b->release != NULL) {
+        b->release(b->ctx, b->data, b->size);
+    }
+    msgpack_allocator_free(b->header.allocator, b);
+}
+
+/* drops the head of the queue */
+static inline void borrowed_pop(unpack_user* u)
+{
+    unpack_borrowed* b = u->borrowed;
+    u->borrowed = b->next;
+    if(u->borrowed == NULL) {
+        u->borrowed_tail = NULL;
+    }
+    u->borrowed_size -= b->size - b->off;
+    borrowed_decr(b);
+}
+
+static void borrowed_clear(unpack_user* u)
+{
+    while(u->borrowed != NULL) {
+        borrowed_pop(u);
+    }
+}
+
 void msgpack_unpacker_destroy(msgpack_unpacker* mpac)
 {
-    msgpack_zone_free(mpac->z);
-    free(mpac->ctx);
+    unpack_user* u = &CTX_CAST(mpac->ctx)->user;
+    if(mpac->z != NULL && u->z_pool != NULL) {
+        msgpack_zone_pool_put(u->z_pool, mpac->z);
+    }
+    else {
+        msgpack_zone_free(mpac->z);
+    }
+    msgpack_zone_pool_release(u->pool);
+    borrowed_clear(u);
+    msgpack_allocator_free(buffer_allocator(mpac->buffer), mpac->ctx);
     decr_count(mpac->buffer);
 }
 
+void msgpack_unpacker_set_zone_pool(msgpack_unpacker* mpac, msgpack_zone_pool* pool)
+{
+    unpack_user* u = &CTX_CAST(mpac->ctx)->user;
+    if(pool != NULL) {
+        msgpack_zone_pool_retain(pool);
+    }
+    msgpack_zone_pool_release(u->pool);
+    u->pool = pool;
+}
+
+void msgpack_unpacker_set_atomic_refcount(msgpack_unpacker* mpac, bool atomic)
+{
+    ((buffer_header*)mpac->buffer)->atomic = atomic;
+}
+
+static unpack_borrowed* borrowed_new(msgpack_unpacker* mpac, const char* data, size_t size,
+        msgpack_unpacker_release release, void* ctx)
+{
+    buffer_header* h = (buffer_header*)mpac->buffer;
+    unpack_borrowed* b = (unpack_borrowed*)msgpack_allocator_malloc(h->allocator,
+            sizeof(unpack_borrowed));
+    if(b == NULL) {
+        return NULL;
+    }
+    init_count(b, h->allocator, h->atomic);
+    b->next = NULL;
+    b->data = data;
+    b->size = size;
+    b->off = 0;
+    b->release = release;
+    b->ctx = ctx;
+    return b;
+}
+
+static void borrowed_append(unpack_user* u, unpack_borrowed* first, unpack_borrowed* last,
+        size_t size)
+{
+    if(u->borrowed_tail != NULL) {
+        u->borrowed_tail->next = first;
+    }
+    else {
+        u->borrowed = first;
+    }
+    u->borrowed_tail = last;
+    u->borrowed_size += size;
+}
+
+bool msgpack_unpacker_push_buffer(msgpack_unpacker* mpac, const char* data, size_t size,
+        msgpack_unpacker_release release, void* ctx)
+{
+    unpack_borrowed* b = borrowed_new(mpac, data, size, release, ctx);
+    if(b == NULL) {
+        return false;
+    }
+    borrowed_append(&CTX_CAST(mpac->ctx)->user, b, b, size);
+    return true;
+}
+
+bool msgpack_unpacker_push_iovec(msgpack_unpacker* mpac, const msgpack_iovec* iov, size_t iovcnt,
+        msgpack_unpacker_release release, void* ctx)
+{
+    unpack_borrowed* first = NULL;
+    unpack_borrowed* last = NULL;
+    size_t size = 0;
+    size_t i;
+
+    for(i = 0; i < iovcnt; ++i) {
+        unpack_borrowed* b = borrowed_new(mpac, (const char*)iov[i].iov_base, iov[i].iov_len,
+                release, ctx);
+        if(b == NULL) {
+            while(first != NULL) {
+                b = first->next;
+                msgpack_allocator_free(first->header.allocator, first);
+                first = b;
+            }
+            return false;
+        }
+        if(last != NULL) {
+            last->next = b;
+        }
+        else {
+            first = b;
+        }
+        last = b;
+        size += iov[i].iov_len;
+    }
+    if(first != NULL) {
+        borrowed_append(&CTX_CAST(mpac->ctx)->user, first, last, size);
+    }
+    return true;
+}
+
 msgpack_unpacker* msgpack_unpacker_new(size_t initial_buffer_size)
 {
-    msgpack_unpacker* mpac = (msgpack_unpacker*)malloc(sizeof(msgpack_unpacker));
+    msgpack_unpacker* mpac = (msgpack_unpacker*)msgpack_allocator_malloc(NULL,
+            sizeof(msgpack_unpacker));
     if(mpac == NULL) {
         return NULL;
     }
 
     if(!msgpack_unpacker_init(mpac, initial_buffer_size)) {
-        free(mpac);
+        msgpack_allocator_free(NULL, mpac);
         return NULL;
     }
 
@@ -423,11 +667,137 @@ msgpack_unpacker* msgpack_unpacker_new(size_t initial_buffer_size)
 void msgpack_unpacker_free(msgpack_unpacker* mpac)
 {
     msgpack_unpacker_destroy(mpac);
-    free(mpac);
+    msgpack_allocator_free(NULL, mpac);
 }
 
+#if defined(UNPACKER_RING)
+
+static void ring_unmap(buffer_header* h)
+{
+    munmap(h, h->ring_base + 2 * h->ring);
+}
+
+/*
+ * [header page][ring][ring again]: the second mapping of the memfd makes
+ * any ring_size bytes from an offset in the first one contiguous.
+ */
+static char* ring_map(size_t* ring_size, size_t* base)
+{
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    size_t size = (*ring_size + page - 1) & ~(page - 1);
+    char* map;
+    int fd;
+
+    if(size == 0 || size > (SIZE_MAX - page) / 2) {
+        return NULL;
+    }
+    fd = memfd_create("msgpack-unpacker", MFD_CLOEXEC);
+    if(fd < 0) {
+        return NULL;
+    }
+    if(ftruncate(fd, (off_t)size) != 0) {
+        close(fd);
+        return NULL;
+    }
+    map = (char*)mmap(NULL, page + 2 * size, PROT_READ | PROT_WRITE,
+            MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if(map == (char*)MAP_FAILED) {
+        close(fd);
+        return NULL;
+    }
+    if(mmap(map + page, size, PROT_READ | PROT_WRITE,
+                MAP_SHARED | MAP_FIXED, fd, 0) == MAP_FAILED ||
+            mmap(map + page + size, size, PROT_READ | PROT_WRITE,
+                MAP_SHARED | MAP_FIXED, fd, 0) == MAP_FAILED) {
+        munmap(map, page + 2 * size);
+        close(fd);
+        return NULL;
+    }
+    close(fd);
+    *ring_size = size;
+    *base = page;
+    return map;
+}
+
+bool msgpack_unpacker_init_ring(msgpack_unpacker* mpac, size_t ring_size)
+{
+    size_t base;
+    char* buffer = ring_map(&ring_size, &base);
+    buffer_header* h;
+
+    if(buffer == NULL) {
+        return false;
+    }
+    if(!msgpack_unpacker_init(mpac, 0)) {
+        munmap(buffer, base + 2 * ring_size);
+        return false;
+    }
+
+    /* the ctx stays with the default allocator, see msgpack_unpacker_destroy */
+    msgpack_allocator_free(NULL, mpac->buffer);
+    h = (buffer_header*)buffer;
+    init_count(buffer, NULL, true);
+    h->ring = ring_size;
+    h->ring_base = base;
+    h->ring_mark = base;
+    h->start = base;
+
+    mpac->buffer = buffer;
+    mpac->used = base;
+    mpac->off = base;
+    mpac->free = ring_size;
+    mpac->initial_buffer_size = ring_size;
+    return true;
+}
+
+/* reclaims the bytes no result references */
+static bool ring_expand(msgpack_unpacker* mpac, size_t size)
+{
+    buffer_header* h = (buffer_header*)mpac->buffer;
+
+    if(get_count(mpac->buffer) == 1) {
+        if(CTX_REFERENCED(mpac)) {
+            h->ring_mark = h->start;
+        }
+        else {
+            h->ring_mark = mpac->off;
+            h->start = mpac->off;
+        }
+    }
+    if(h->ring_mark >= h->ring_base + h->ring) {
+        /* the same bytes one ring lower */
+        mpac->off -= h->ring;
+        mpac->used -= h->ring;
+        h->ring_mark -= h->ring;
+        h->start -= h->ring;
+    }
+    mpac->free = h->ring - (mpac->used - h->ring_mark);
+    return mpac->free >= size;
+}
+
+#else  /* UNPACKER_RING */
+
+static void ring_unmap(buffer_header* h)
+{
+    (void)h;
+}
+
+bool msgpack_unpacker_init_ring(msgpack_unpacker* mpac, size_t ring_size)
+{
+    (void)mpac;
+    (void)ring_size;
+    return false;
+}
+
+#endif /* UNPACKER_RING */
+
 bool msgpack_unpacker_expand_buffer(msgpack_unpacker* mpac, size_t size)
 {
+#if defined(UNPACKER_RING)
+    if(((buffer_header*)mpac->buffer)->ring != 0) {
+        return ring_expand(mpac, size);
+    }
+#endif
     if(mpac->used == mpac->off && get_count(mpac->buffer) == 1
             && !CTX_REFERENCED(mpac)) {
         // rewind buffer
@@ -452,7 +822,8 @@ bool msgpack_unpacker_expand_buffer(msgpack_unpacker* mpac, size_t size)
             next_size = tmp_next_size;
         }
 
-        tmp = (char*)realloc(mpac->buffer, next_size);
+        tmp = (char*)msgpack_allocator_realloc(buffer_allocator(mpac->buffer),
+                mpac->buffer, next_size);
         if(tmp == NULL) {
             return false;
         }
@@ -462,6 +833,7 @@ bool msgpack_unpacker_expand_buffer(msgpack_unpacker* mpac, size_t size)
 
     } else {
         char* tmp;
+        const msgpack_allocator* allocator = buffer_allocator(mpac->buffer);
         size_t next_size = mpac->initial_buffer_size;  // include COUNTER_SIZE
         size_t not_parsed = mpac->used - mpac->off;
         while(next_size < size + not_parsed + COUNTER_SIZE) {
@@ -473,18 +845,18 @@ bool msgpack_unpacker_expand_buffer(msgpack_unpacker* mpac, size_t size)
             next_size = tmp_next_size;
         }
 
-        tmp = (char*)malloc(next_size);
+        tmp = (char*)msgpack_allocator_malloc(allocator, next_size);
         if(tmp == NULL) {
             return false;
         }
 
-        init_count(tmp);
+        init_count(tmp, allocator, ((buffer_header*)mpac->buffer)->atomic);
 
         memcpy(tmp+COUNTER_SIZE, mpac->buffer+mpac->off, not_parsed);
 
         if(CTX_REFERENCED(mpac)) {
             if(!msgpack_zone_push_finalizer(mpac->z, decr_count, mpac->buffer)) {
-                free(tmp);
+                msgpack_allocator_free(allocator, tmp);
                 return false;
             }
             CTX_REFERENCED(mpac) = false;
@@ -501,10 +873,115 @@ bool msgpack_unpacker_expand_buffer(msgpack_unpacker* mpac, size_t size)
     return true;
 }
 
+/* the result zone keeps b until its objects pointing into b are gone */
+static inline int borrowed_reference(unpack_user* u, unpack_borrowed* b)
+{
+    if(!u->referenced) {
+        return 0;
+    }
+    if(!msgpack_zone_push_finalizer(*u->z, borrowed_decr, b)) {
+        return MSGPACK_UNPACK_NOMEM_ERROR;
+    }
+    incr_count(&b->header);
+    u->referenced = false;
+    return 0;
+}
+
+/*
+ * Gathers the trail bytes of the element split between the head buffer and
+ * the next ones, and parses it. The element goes on the stack unless it is
+ * the body of a str, bin or ext, whose object points into the copy.
+ */
+static int borrowed_execute_split(msgpack_unpacker* mpac)
+{
+    template_context* ctx = CTX_CAST(mpac->ctx);
+    unpack_user* u = &ctx->user;
+    size_t need = ctx->trail;
+    char small[32];
+    char* tmp = small;
+    size_t got = 0;
+    size_t off = 0;
+    int ret;
+
+    if(need > sizeof(small) || ctx->cs == MSGPACK_ACS_STR_VALUE ||
+            ctx->cs == MSGPACK_ACS_BIN_VALUE || ctx->cs == MSGPACK_ACS_EXT_VALUE) {
+        if(!unpack_zone(u)) {
+            return MSGPACK_UNPACK_NOMEM_ERROR;
+        }
+        tmp = (char*)msgpack_zone_malloc_no_align(*u->z, need);
+        if(tmp == NULL) {
+            return MSGPACK_UNPACK_NOMEM_ERROR;
+        }
+    }
+    while(got < need) {
+        unpack_borrowed* b = u->borrowed;
+        size_t n = b->size - b->off;
+        if(n > need - got) {
+            n = need - got;
+        }
+        memcpy(tmp + got, b->data + b->off, n);
+        got += n;
+        b->off += n;
+        u->borrowed_size -= n;
+        if(b->off == b->size) {
+            borrowed_pop(u);
+        }
+    }
+
+    ret = template_execute(ctx, tmp, need, &off);
+    mpac->parsed += off;
+    /* the zone owns the copy */
+    u->referenced = false;
+    return ret;
+}
+
+static int borrowed_execute(msgpack_unpacker* mpac)
+{
+    template_context* ctx = CTX_CAST(mpac->ctx);
+    unpack_user* u = &ctx->user;
+    unpack_borrowed* b;
+    size_t off;
+    int ret;
+    int e;
+
+    while((b = u->borrowed) != NULL) {
+        if(b->off == b->size) {
+            borrowed_pop(u);
+            continue;
+        }
+        if(ctx->cs != MSGPACK_CS_HEADER && ctx->trail > b->size - b->off) {
+            if(ctx->trail > u->borrowed_size) {
+                return 0;
+            }
+            ret = borrowed_execute_split(mpac);
+            if(ret != 0) {
+                return ret;
+            }
+            continue;
+        }
+        off = b->off;
+        ret = template_execute(ctx, b->data, b->size, &b->off);
+        mpac->parsed += b->off - off;
+        u->borrowed_size -= b->off - off;
+        e = borrowed_reference(u, b);
+        if(e < 0) {
+            return e;
+        }
+        if(ret != 0) {
+            return ret;
+        }
+    }
+    return 0;
+}
+
 int msgpack_unpacker_execute(msgpack_unpacker* mpac)
 {
     size_t off = mpac->off;
-    int ret = template_execute(CTX_CAST(mpac->ctx),
+    int ret;
+    if(CTX_CAST(mpac->ctx)->user.borrowed != NULL) {
+        return borrowed_execute(mpac);
+    }
+    ret = template_execute(CTX_CAST(mpac->ctx),
             mpac->buffer, mpac->used, &mpac->off);
     if(mpac->off > off) {
         mpac->parsed += mpac->off - off;
@@ -517,10 +994,12 @@ msgpack_object msgpack_unpacker_data(msgpack_unpacker* mpac)
     return template_data(CTX_CAST(mpac->ctx));
 }
 
-msgpack_zone* msgpack_unpacker_release_zone(msgpack_unpacker* mpac)
+/* *pool gets the pool the zone goes back to */
+static msgpack_zone* unpacker_release_zone(msgpack_unpacker* mpac, msgpack_zone_pool** pool)
 {
     msgpack_zone* old = mpac->z;
 
+    *pool = NULL;
     if (old == NULL) return NULL;
     if(!msgpack_unpacker_flush_zone(mpac)) {
         return NULL;
@@ -528,10 +1007,21 @@ msgpack_zone* msgpack_unpacker_release_zone(msgpack_unpacker* mpac)
 
     mpac->z = NULL;
     CTX_CAST(mpac->ctx)->user.z = &mpac->z;
+    *pool = CTX_CAST(mpac->ctx)->user.z_pool;
+    CTX_CAST(mpac->ctx)->user.z_pool = NULL;
 
     return old;
 }
 
+msgpack_zone* msgpack_unpacker_release_zone(msgpack_unpacker* mpac)
+{
+    msgpack_zone_pool* pool = NULL;
+    msgpack_zone* z = unpacker_release_zone(mpac, &pool);
+    /* the caller frees the zone with msgpack_zone_free */
+    msgpack_zone_pool_release(pool);
+    return z;
+}
+
 void msgpack_unpacker_reset_zone(msgpack_unpacker* mpac)
 {
     msgpack_zone_clear(mpac->z);
@@ -556,6 +1046,7 @@ void msgpack_unpacker_reset(msgpack_unpacker* mpac)
     template_init(CTX_CAST(mpac->ctx));
     // don't reset referenced flag
     mpac->parsed = 0;
+    ((buffer_header*)mpac->buffer)->start = mpac->off;
 }
 
 static inline msgpack_unpack_return unpacker_next(msgpack_unpacker* mpac,
@@ -576,7 +1067,7 @@ static inline msgpack_unpack_return unpacker_next(msgpack_unpacker* mpac,
     if(ret == 0) {
         return MSGPACK_UNPACK_CONTINUE;
     }
-    result->zone = msgpack_unpacker_release_zone(mpac);
+    result->zone = unpacker_release_zone(mpac, &result->pool);
     result->data = msgpack_unpacker_data(mpac);
 
     return MSGPACK_UNPACK_SUCCESS;
@@ -613,6 +1104,92 @@ msgpack_unpacker_next_with_size(msgpack_unpacker* mpac,
     return ret;
 }
 
+#define UNPACKER_READ_SIZE_MIN 4096
+/* messages a read aims to bring in */
+#define UNPACKER_READ_MESSAGES 16
+
+/* grows while reads fill their size, shrinks slowly otherwise */
+static void unpacker_adapt_read_size(unpack_user* u, size_t size, size_t n)
+{
+    size_t next = u->message_avg * UNPACKER_READ_MESSAGES;
+    if(n == size) {
+        if(next < size * 2) {
+            next = size * 2;
+        }
+    }
+    else if(next < size / 2) {
+        next = size / 2;
+    }
+    if(next < UNPACKER_READ_SIZE_MIN) {
+        next = UNPACKER_READ_SIZE_MIN;
+    }
+    if(next > MSGPACK_UNPACKER_READ_SIZE_MAX) {
+        next = MSGPACK_UNPACKER_READ_SIZE_MAX;
+    }
+    u->read_size = next;
+}
+
+msgpack_unpacker_read_return
+msgpack_unpacker_read_fd(msgpack_unpacker* mpac, int fd, size_t max_bytes)
+{
+#if !defined(_WIN32)
+    unpack_user* u = &CTX_CAST(mpac->ctx)->user;
+    size_t size = u->read_size;
+    ssize_t n;
+
+    if(max_bytes != 0 && size > max_bytes) {
+        size = max_bytes;
+    }
+    if(!msgpack_unpacker_reserve_buffer(mpac, size)) {
+        /* a ring held by results, or no memory to grow: read what fits */
+        if(mpac->free == 0) {
+            return MSGPACK_UNPACKER_READ_NOMEM_ERROR;
+        }
+        size = mpac->free;
+    }
+
+    do {
+        n = read(fd, msgpack_unpacker_buffer(mpac), size);
+    } while(n < 0 && errno == EINTR);
+
+    if(n < 0) {
+        if(errno == EAGAIN || errno == EWOULDBLOCK) {
+            return MSGPACK_UNPACKER_READ_AGAIN;
+        }
+        return MSGPACK_UNPACKER_READ_ERROR;
+    }
+    if(n == 0) {
+        return MSGPACK_UNPACKER_READ_EOF;
+    }
+    msgpack_unpacker_buffer_consumed(mpac, (size_t)n);
+    unpacker_adapt_read_size(u, size, (size_t)n);
+    return MSGPACK_UNPACKER_READ_OK;
+#else
+    MSGPACK_UNUSED(mpac);
+    MSGPACK_UNUSED(fd);
+    MSGPACK_UNUSED(max_bytes);
+    return MSGPACK_UNPACKER_READ_ERROR;
+#endif
+}
+
+msgpack_unpack_return msgpack_unpacker_read_next(msgpack_unpacker* mpac,
+                                                 msgpack_unpacked* result)
+{
+    unpack_user* u = &CTX_CAST(mpac->ctx)->user;
+    size_t size = 0;
+    msgpack_unpack_return ret = msgpack_unpacker_next_with_size(mpac, result, &size);
+
+    if(ret == MSGPACK_UNPACK_SUCCESS) {
+        if(u->message_avg == 0) {
+            u->message_avg = size;
+        }
+        else {
+            u->message_avg = u->message_avg - u->message_avg / 8 + size / 8;
+        }
+    }
+    return ret;
+}
+
 msgpack_unpack_return
 msgpack_unpack(const char* data, size_t len, size_t* off,
         msgpack_zone* result_zone, msgpack_object* result)
@@ -631,6 +1208,8 @@ msgpack_unpack(const char* data, size_t len, size_t* off,
 
         ctx.user.z = &result_zone;
         ctx.user.referenced = false;
+        ctx.user.pool = NULL;
+        ctx.user.z_pool = NULL;
 
         e = template_execute(&ctx, data, len, &noff);
         if(e < 0) {
@@ -673,6 +1252,8 @@ msgpack_unpack_next(msgpack_unpacked* result,
 
         ctx.user.z = &result->zone;
         ctx.user.referenced = false;
+        ctx.user.pool = NULL;
+        ctx.user.z_pool = NULL;
 
         e = template_execute(&ctx, data, len, &noff);
 
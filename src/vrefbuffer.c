@@ -20,6 +20,12 @@ struct msgpack_vrefbuffer_chunk {
 
 bool msgpack_vrefbuffer_init(msgpack_vrefbuffer* vbuf,
         size_t ref_size, size_t chunk_size)
+{
+    return msgpack_vrefbuffer_init_with_allocator(vbuf, ref_size, chunk_size, NULL);
+}
+
+bool msgpack_vrefbuffer_init_with_allocator(msgpack_vrefbuffer* vbuf,
+        size_t ref_size, size_t chunk_size, const msgpack_allocator* allocator)
 {
     size_t nfirst;
     msgpack_iovec* array;
@@ -32,6 +38,7 @@ bool msgpack_vrefbuffer_init(msgpack_vrefbuffer* vbuf,
         chunk_size = MSGPACK_VREFBUFFER_CHUNK_SIZE;
     }
     vbuf->chunk_size = chunk_size;
+    vbuf->allocator = allocator;
     vbuf->ref_size =
         ref_size > MSGPACK_PACKER_MAX_BUFFER_SIZE + 1 ?
         ref_size : MSGPACK_PACKER_MAX_BUFFER_SIZE + 1 ;
@@ -43,7 +50,7 @@ bool msgpack_vrefbuffer_init(msgpack_vrefbuffer* vbuf,
     nfirst = (sizeof(msgpack_iovec) < 72/2) ?
             72 / sizeof(msgpack_iovec) : 8;
 
-    array = (msgpack_iovec*)malloc(
+    array = (msgpack_iovec*)msgpack_allocator_malloc(allocator,
             sizeof(msgpack_iovec) * nfirst);
     if(array == NULL) {
         return false;
@@ -53,10 +60,10 @@ bool msgpack_vrefbuffer_init(msgpack_vrefbuffer* vbuf,
     vbuf->end   = array + nfirst;
     vbuf->array = array;
 
-    chunk = (msgpack_vrefbuffer_chunk*)malloc(
+    chunk = (msgpack_vrefbuffer_chunk*)msgpack_allocator_malloc(allocator,
             sizeof(msgpack_vrefbuffer_chunk) + chunk_size);
     if(chunk == NULL) {
-        free(array);
+        msgpack_allocator_free(allocator, array);
         return false;
     }
     else {
@@ -76,14 +83,14 @@ void msgpack_vrefbuffer_destroy(msgpack_vrefbuffer* vbuf)
     msgpack_vrefbuffer_chunk* c = vbuf->inner_buffer.head;
     while(true) {
         msgpack_vrefbuffer_chunk* n = c->next;
-        free(c);
+        msgpack_allocator_free(vbuf->allocator, c);
         if(n != NULL) {
             c = n;
         } else {
             break;
         }
     }
-    free(vbuf->array);
+    msgpack_allocator_free(vbuf->allocator, vbuf->array);
 }
 
 void msgpack_vrefbuffer_clear(msgpack_vrefbuffer* vbuf)
@@ -92,7 +99,7 @@ void msgpack_vrefbuffer_clear(msgpack_vrefbuffer* vbuf)
     msgpack_vrefbuffer_chunk* n;
     while(c != NULL) {
         n = c->next;
-        free(c);
+        msgpack_allocator_free(vbuf->allocator, c);
         c = n;
     }
 
@@ -114,7 +121,7 @@ int msgpack_vrefbuffer_append_ref(msgpack_vrefbuffer* vbuf,
         const size_t nused = (size_t)(vbuf->tail - vbuf->array);
         const size_t nnext = nused * 2;
 
-        msgpack_iovec* nvec = (msgpack_iovec*)realloc(
+        msgpack_iovec* nvec = (msgpack_iovec*)msgpack_allocator_realloc(vbuf->allocator,
                 vbuf->array, sizeof(msgpack_iovec)*nnext);
         if(nvec == NULL) {
             return -1;
@@ -148,7 +155,7 @@ int msgpack_vrefbuffer_append_copy(msgpack_vrefbuffer* vbuf,
         if((sizeof(msgpack_vrefbuffer_chunk) + sz) < sz){
             return -1;
         }
-        chunk = (msgpack_vrefbuffer_chunk*)malloc(
+        chunk = (msgpack_vrefbuffer_chunk*)msgpack_allocator_malloc(vbuf->allocator,
                 sizeof(msgpack_vrefbuffer_chunk) + sz);
         if(chunk == NULL) {
             return -1;
@@ -183,7 +190,7 @@ int msgpack_vrefbuffer_migrate(msgpack_vrefbuffer* vbuf, msgpack_vrefbuffer* to)
         return -1;
     }
 
-    empty = (msgpack_vrefbuffer_chunk*)malloc(
+    empty = (msgpack_vrefbuffer_chunk*)msgpack_allocator_malloc(vbuf->allocator,
             sizeof(msgpack_vrefbuffer_chunk) + sz);
     if(empty == NULL) {
         return -1;
@@ -207,10 +214,10 @@ int msgpack_vrefbuffer_migrate(msgpack_vrefbuffer* vbuf, msgpack_vrefbuffer* to)
                 nnext = tmp_nnext;
             }
 
-            nvec = (msgpack_iovec*)realloc(
+            nvec = (msgpack_iovec*)msgpack_allocator_realloc(to->allocator,
                     to->array, sizeof(msgpack_iovec)*nnext);
             if(nvec == NULL) {
-                free(empty);
+                msgpack_allocator_free(vbuf->allocator, empty);
                 return -1;
             }
 
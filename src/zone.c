@@ -8,18 +8,258 @@
  *    http://www.boost.org/LICENSE_1_0.txt)
  */
 #include "msgpack/zone.h"
+#include "msgpack/allocator.h"
 #include <stdlib.h>
 #include <string.h>
 
+#if defined(MSGPACK_ZONE_CHUNK_CACHE)
+#include <pthread.h>
+#endif
+
 struct msgpack_zone_chunk {
     struct msgpack_zone_chunk* next;
+    size_t size;
     /* data ... */
 };
 
-static inline bool init_chunk_list(msgpack_zone_chunk_list* cl, size_t chunk_size)
+
+#if defined(MSGPACK_ZONE_CHUNK_CACHE)
+
+/*
+ * Chunks of MSGPACK_ZONE_CHUNK_SIZE bytes are cached in a per-thread
+ * magazine, a list that only its thread touches. A full magazine moves half
+ * of its chunks to the depot, shared by all threads under a mutex, and an
+ * empty one refills from it when the depot is not empty, so the mutex is
+ * taken once per batch of chunks and never by allocations that miss.
+ * Counters are kept per thread and folded into the depot at each visit,
+ * when the thread exits or calls msgpack_zone_chunk_cache_flush(). A thread
+ * registers its exit destructor before it first allocates or frees a chunk
+ * through its magazine, so the chunks it holds go back to the depot.
+ * The cache is bypassed while the default allocator is not the libc one.
+ */
+typedef struct {
+    msgpack_zone_chunk* head;
+    size_t count;
+    size_t folded;      /* count when last folded */
+    size_t hits;
+    size_t misses;
+    bool registered;    /* the thread exit destructor is set */
+} chunk_magazine;
+
+static struct {
+    pthread_mutex_t lock;
+    msgpack_zone_chunk* head;
+    size_t count;
+    size_t magazine_chunks;     /* in magazines, as last folded */
+    size_t thread_limit;
+    size_t depot_limit;
+    size_t hits;
+    size_t misses;
+} chunk_depot = {
+    PTHREAD_MUTEX_INITIALIZER, NULL, 0, 0,
+    MSGPACK_ZONE_CHUNK_CACHE_THREAD_LIMIT, MSGPACK_ZONE_CHUNK_CACHE_DEPOT_LIMIT, 0, 0
+};
+
+/*
+ * count and thread_limit are written under the lock and also read without
+ * it: a stale value only delays a refill or a drain.
+ */
+#define CHUNK_LOAD(x) __atomic_load_n(&(x), __ATOMIC_RELAXED)
+#define CHUNK_STORE(x, v) __atomic_store_n(&(x), (v), __ATOMIC_RELAXED)
+
+static __thread chunk_magazine chunk_tls;
+static pthread_once_t chunk_key_once = PTHREAD_ONCE_INIT;
+static pthread_key_t chunk_key;
+static bool chunk_key_valid;
+
+static void free_chunks(msgpack_zone_chunk* c)
+{
+    while(c != NULL) {
+        msgpack_zone_chunk* n = c->next;
+        free(c);
+        c = n;
+    }
+}
+
+/* called with the depot locked */
+static void chunk_fold(chunk_magazine* m)
+{
+    chunk_depot.hits += m->hits;
+    chunk_depot.misses += m->misses;
+    chunk_depot.magazine_chunks += m->count - m->folded;
+    m->hits = 0;
+    m->misses = 0;
+    m->folded = m->count;
+}
+
+/* called with the depot locked, returns the chunks over the depot limit */
+static msgpack_zone_chunk* chunk_depot_trim(void)
+{
+    msgpack_zone_chunk* excess = NULL;
+    while(chunk_depot.count > chunk_depot.depot_limit) {
+        msgpack_zone_chunk* c = chunk_depot.head;
+        chunk_depot.head = c->next;
+        c->next = excess;
+        excess = c;
+        CHUNK_STORE(chunk_depot.count, chunk_depot.count - 1);
+    }
+    return excess;
+}
+
+/* moves n chunks of the magazine to the depot */
+static void chunk_drain(chunk_magazine* m, size_t n)
+{
+    msgpack_zone_chunk* first = m->head;
+    msgpack_zone_chunk* last = first;
+    msgpack_zone_chunk* excess;
+    size_t i;
+
+    if(n == 0) {
+        pthread_mutex_lock(&chunk_depot.lock);
+        chunk_fold(m);
+        pthread_mutex_unlock(&chunk_depot.lock);
+        return;
+    }
+    for(i = 1; i < n; ++i) {
+        last = last->next;
+    }
+    m->head = last->next;
+    m->count -= n;
+
+    pthread_mutex_lock(&chunk_depot.lock);
+    chunk_fold(m);
+    last->next = chunk_depot.head;
+    chunk_depot.head = first;
+    CHUNK_STORE(chunk_depot.count, chunk_depot.count + n);
+    excess = chunk_depot_trim();
+    pthread_mutex_unlock(&chunk_depot.lock);
+
+    free_chunks(excess);
+}
+
+/* moves up to half a magazine of chunks from the depot */
+static void chunk_refill(chunk_magazine* m)
+{
+    /* a thread that only allocates, or an empty depot, never locks */
+    if(CHUNK_LOAD(chunk_depot.count) == 0) {
+        return;
+    }
+    pthread_mutex_lock(&chunk_depot.lock);
+    chunk_fold(m);
+    if(chunk_depot.count > 0) {
+        size_t n = chunk_depot.thread_limit / 2;
+        if(n == 0) {
+            n = 1;
+        }
+        while(n-- > 0 && chunk_depot.count > 0) {
+            msgpack_zone_chunk* c = chunk_depot.head;
+            chunk_depot.head = c->next;
+            CHUNK_STORE(chunk_depot.count, chunk_depot.count - 1);
+            c->next = m->head;
+            m->head = c;
+            ++m->count;
+        }
+    }
+    pthread_mutex_unlock(&chunk_depot.lock);
+}
+
+static void chunk_thread_exit(void* p)
+{
+    chunk_magazine* m = (chunk_magazine*)p;
+    chunk_drain(m, m->count);
+    /* a zone freed by a later destructor registers again */
+    m->registered = false;
+}
+
+static void chunk_key_create(void)
+{
+    chunk_key_valid = pthread_key_create(&chunk_key, chunk_thread_exit) == 0;
+}
+
+static inline bool chunk_register(chunk_magazine* m)
+{
+    if(!m->registered) {
+        pthread_once(&chunk_key_once, chunk_key_create);
+        if(!chunk_key_valid || pthread_setspecific(chunk_key, m) != 0) {
+            return false;
+        }
+        m->registered = true;
+    }
+    return true;
+}
+
+#endif /* MSGPACK_ZONE_CHUNK_CACHE */
+
+static inline msgpack_zone_chunk* alloc_chunk(
+        const msgpack_zone_chunk_provider* provider, size_t size)
+{
+    msgpack_zone_chunk* chunk;
+    if(provider != NULL) {
+        if(size > SIZE_MAX - sizeof(msgpack_zone_chunk)) {
+            return NULL;
+        }
+        chunk = (msgpack_zone_chunk*)(*provider->alloc)(provider->ctx,
+                sizeof(msgpack_zone_chunk) + size);
+        if(chunk != NULL) {
+            chunk->size = size;
+        }
+        return chunk;
+    }
+#if defined(MSGPACK_ZONE_CHUNK_CACHE)
+    if(size == MSGPACK_ZONE_CHUNK_SIZE &&
+            msgpack_allocator_get_default() == msgpack_allocator_libc()) {
+        chunk_magazine* const m = &chunk_tls;
+        /* unregistered, refilled chunks would leak when the thread exits */
+        if(m->count == 0 && chunk_register(m)) {
+            chunk_refill(m);
+        }
+        if(m->count > 0) {
+            chunk = m->head;
+            m->head = chunk->next;
+            --m->count;
+            ++m->hits;
+            return chunk;
+        }
+        ++m->misses;
+    }
+#endif
+    chunk = (msgpack_zone_chunk*)msgpack_allocator_malloc(NULL, sizeof(msgpack_zone_chunk) + size);
+    if(chunk != NULL) {
+        chunk->size = size;
+    }
+    return chunk;
+}
+
+static inline void free_chunk(
+        const msgpack_zone_chunk_provider* provider, msgpack_zone_chunk* chunk)
 {
-    msgpack_zone_chunk* chunk = (msgpack_zone_chunk*)malloc(
-            sizeof(msgpack_zone_chunk) + chunk_size);
+    if(provider != NULL) {
+        (*provider->free)(provider->ctx, chunk, sizeof(msgpack_zone_chunk) + chunk->size);
+        return;
+    }
+#if defined(MSGPACK_ZONE_CHUNK_CACHE)
+    if(chunk->size == MSGPACK_ZONE_CHUNK_SIZE &&
+            msgpack_allocator_get_default() == msgpack_allocator_libc()) {
+        chunk_magazine* const m = &chunk_tls;
+        const size_t limit = CHUNK_LOAD(chunk_depot.thread_limit);
+        if(limit > 0 && chunk_register(m)) {
+            if(m->count >= limit) {
+                chunk_drain(m, m->count - limit / 2);
+            }
+            chunk->next = m->head;
+            m->head = chunk;
+            ++m->count;
+            return;
+        }
+    }
+#endif
+    msgpack_allocator_free(NULL, chunk);
+}
+
+static inline bool init_chunk_list(msgpack_zone_chunk_list* cl, size_t chunk_size,
+        const msgpack_zone_chunk_provider* provider)
+{
+    msgpack_zone_chunk* chunk = alloc_chunk(provider, chunk_size);
     if(chunk == NULL) {
         return false;
     }
@@ -32,12 +272,13 @@ static inline bool init_chunk_list(msgpack_zone_chunk_list* cl, size_t chunk_siz
     return true;
 }
 
-static inline void destroy_chunk_list(msgpack_zone_chunk_list* cl)
+static inline void destroy_chunk_list(msgpack_zone_chunk_list* cl,
+        const msgpack_zone_chunk_provider* provider)
 {
     msgpack_zone_chunk* c = cl->head;
     while(true) {
         msgpack_zone_chunk* n = c->next;
-        free(c);
+        free_chunk(provider, c);
         if(n != NULL) {
             c = n;
         } else {
@@ -46,13 +287,14 @@ static inline void destroy_chunk_list(msgpack_zone_chunk_list* cl)
     }
 }
 
-static inline void clear_chunk_list(msgpack_zone_chunk_list* cl, size_t chunk_size)
+static inline void clear_chunk_list(msgpack_zone_chunk_list* cl, size_t chunk_size,
+        const msgpack_zone_chunk_provider* provider)
 {
     msgpack_zone_chunk* c = cl->head;
     while(true) {
         msgpack_zone_chunk* n = c->next;
         if(n != NULL) {
-            free(c);
+            free_chunk(provider, c);
             c = n;
         } else {
             cl->head = c;
@@ -80,8 +322,7 @@ void* msgpack_zone_malloc_expand(msgpack_zone* zone, size_t size)
         sz = tmp_sz;
     }
 
-    chunk = (msgpack_zone_chunk*)malloc(
-            sizeof(msgpack_zone_chunk) + sz);
+    chunk = alloc_chunk(zone->provider, sz);
     if (chunk == NULL) {
         return NULL;
     }
@@ -115,7 +356,9 @@ static inline void call_finalizer_array(msgpack_zone_finalizer_array* fa)
 static inline void destroy_finalizer_array(msgpack_zone_finalizer_array* fa)
 {
     call_finalizer_array(fa);
-    free(fa->array);
+    if(fa->array != NULL) {
+        msgpack_allocator_free(NULL, fa->array);
+    }
 }
 
 static inline void clear_finalizer_array(msgpack_zone_finalizer_array* fa)
@@ -141,7 +384,7 @@ bool msgpack_zone_push_finalizer_expand(msgpack_zone* zone,
         nnext = nused * 2;
     }
 
-    tmp = (msgpack_zone_finalizer*)realloc(fa->array,
+    tmp = (msgpack_zone_finalizer*)msgpack_allocator_realloc(NULL, fa->array,
                 sizeof(msgpack_zone_finalizer) * nnext);
     if(tmp == NULL) {
         return false;
@@ -172,20 +415,46 @@ bool msgpack_zone_is_empty(msgpack_zone* zone)
 void msgpack_zone_destroy(msgpack_zone* zone)
 {
     destroy_finalizer_array(&zone->finalizer_array);
-    destroy_chunk_list(&zone->chunk_list);
+    destroy_chunk_list(&zone->chunk_list, zone->provider);
 }
 
 void msgpack_zone_clear(msgpack_zone* zone)
 {
     clear_finalizer_array(&zone->finalizer_array);
-    clear_chunk_list(&zone->chunk_list, zone->chunk_size);
+    clear_chunk_list(&zone->chunk_list, zone->chunk_size, zone->provider);
+}
+
+void msgpack_zone_rollback(msgpack_zone* zone, const msgpack_zone_marker* mark)
+{
+    msgpack_zone_chunk_list* const cl = &zone->chunk_list;
+    msgpack_zone_finalizer_array* const fa = &zone->finalizer_array;
+
+    while((size_t)(fa->tail - fa->array) > mark->finalizers) {
+        --fa->tail;
+        (*fa->tail->func)(fa->tail->data);
+    }
+
+    while(cl->head != mark->head) {
+        msgpack_zone_chunk* n = cl->head->next;
+        free_chunk(zone->provider, cl->head);
+        cl->head = n;
+    }
+    cl->ptr  = mark->ptr;
+    cl->free = mark->free;
 }
 
 bool msgpack_zone_init(msgpack_zone* zone, size_t chunk_size)
+{
+    return msgpack_zone_init_with_provider(zone, chunk_size, NULL);
+}
+
+bool msgpack_zone_init_with_provider(msgpack_zone* zone, size_t chunk_size,
+        const msgpack_zone_chunk_provider* provider)
 {
     zone->chunk_size = chunk_size;
+    zone->provider = provider;
 
-    if(!init_chunk_list(&zone->chunk_list, chunk_size)) {
+    if(!init_chunk_list(&zone->chunk_list, chunk_size, provider)) {
         return false;
     }
 
@@ -196,21 +465,23 @@ bool msgpack_zone_init(msgpack_zone* zone, size_t chunk_size)
 
 msgpack_zone* msgpack_zone_new(size_t chunk_size)
 {
-    msgpack_zone* zone = (msgpack_zone*)malloc(
+    return msgpack_zone_new_with_provider(chunk_size, NULL);
+}
+
+msgpack_zone* msgpack_zone_new_with_provider(size_t chunk_size,
+        const msgpack_zone_chunk_provider* provider)
+{
+    msgpack_zone* zone = (msgpack_zone*)msgpack_allocator_malloc(NULL,
             sizeof(msgpack_zone));
     if(zone == NULL) {
         return NULL;
     }
 
-    zone->chunk_size = chunk_size;
-
-    if(!init_chunk_list(&zone->chunk_list, chunk_size)) {
-        free(zone);
+    if(!msgpack_zone_init_with_provider(zone, chunk_size, provider)) {
+        msgpack_allocator_free(NULL, zone);
         return NULL;
     }
 
-    init_finalizer_array(&zone->finalizer_array);
-
     return zone;
 }
 
@@ -218,5 +489,175 @@ void msgpack_zone_free(msgpack_zone* zone)
 {
     if(zone == NULL) { return; }
     msgpack_zone_destroy(zone);
-    free(zone);
+    msgpack_allocator_free(NULL, zone);
+}
+
+
+struct msgpack_zone_pool {
+    msgpack_zone** zones;
+    size_t count;
+    size_t max;
+    size_t chunk_size;
+    size_t refs;
+    size_t interval;        /* returns since the last trim */
+    size_t low_water;       /* min count since the last trim */
+    msgpack_zone_pool_stats stats;
+};
+
+msgpack_zone_pool* msgpack_zone_pool_new(size_t chunk_size, size_t max_zones)
+{
+    msgpack_zone_pool* pool = (msgpack_zone_pool*)msgpack_allocator_malloc(NULL,
+            sizeof(msgpack_zone_pool));
+    if(pool == NULL) {
+        return NULL;
+    }
+    memset(pool, 0, sizeof(msgpack_zone_pool));
+    if(max_zones > 0) {
+        pool->zones = (msgpack_zone**)msgpack_allocator_malloc(NULL,
+                max_zones * sizeof(msgpack_zone*));
+        if(pool->zones == NULL) {
+            msgpack_allocator_free(NULL, pool);
+            return NULL;
+        }
+    }
+    pool->max = max_zones;
+    pool->chunk_size = chunk_size;
+    pool->refs = 1;
+    return pool;
+}
+
+void msgpack_zone_pool_retain(msgpack_zone_pool* pool)
+{
+    ++pool->refs;
 }
+
+void msgpack_zone_pool_release(msgpack_zone_pool* pool)
+{
+    if(pool == NULL || --pool->refs > 0) {
+        return;
+    }
+    msgpack_zone_pool_trim(pool, 0);
+    if(pool->zones != NULL) {
+        msgpack_allocator_free(NULL, pool->zones);
+    }
+    msgpack_allocator_free(NULL, pool);
+}
+
+msgpack_zone* msgpack_zone_pool_get(msgpack_zone_pool* pool)
+{
+    msgpack_zone* zone;
+
+    if(pool->count > 0) {
+        zone = pool->zones[--pool->count];
+        if(pool->count < pool->low_water) {
+            pool->low_water = pool->count;
+        }
+        ++pool->stats.hits;
+    }
+    else {
+        zone = msgpack_zone_new(pool->chunk_size);
+        if(zone == NULL) {
+            return NULL;
+        }
+        pool->low_water = 0;
+        ++pool->stats.misses;
+    }
+    ++pool->refs;
+    return zone;
+}
+
+void msgpack_zone_pool_put(msgpack_zone_pool* pool, msgpack_zone* zone)
+{
+    ++pool->stats.returns;
+
+    if(zone->chunk_size == pool->chunk_size && pool->count < pool->max) {
+        msgpack_zone_clear(zone);
+        pool->zones[pool->count++] = zone;
+        if(pool->count > pool->stats.max_cached) {
+            pool->stats.max_cached = pool->count;
+        }
+    }
+    else {
+        msgpack_zone_free(zone);
+        ++pool->stats.frees;
+    }
+
+    if(++pool->interval >= MSGPACK_ZONE_POOL_TRIM_INTERVAL) {
+        /* low_water zones were not needed during the whole interval */
+        msgpack_zone_pool_trim(pool, pool->count - pool->low_water);
+        pool->interval = 0;
+        pool->low_water = pool->count;
+    }
+
+    msgpack_zone_pool_release(pool);
+}
+
+void msgpack_zone_pool_trim(msgpack_zone_pool* pool, size_t keep)
+{
+    while(pool->count > keep) {
+        msgpack_zone_free(pool->zones[--pool->count]);
+        ++pool->stats.frees;
+    }
+    if(pool->low_water > pool->count) {
+        pool->low_water = pool->count;
+    }
+}
+
+void msgpack_zone_pool_get_stats(const msgpack_zone_pool* pool, msgpack_zone_pool_stats* stats)
+{
+    *stats = pool->stats;
+    stats->cached = pool->count;
+}
+
+
+#if defined(MSGPACK_ZONE_CHUNK_CACHE)
+
+bool msgpack_zone_chunk_cache_set_limits(size_t thread_limit, size_t depot_limit)
+{
+    msgpack_zone_chunk* excess;
+
+    pthread_mutex_lock(&chunk_depot.lock);
+    CHUNK_STORE(chunk_depot.thread_limit, thread_limit);
+    chunk_depot.depot_limit = depot_limit;
+    excess = chunk_depot_trim();
+    pthread_mutex_unlock(&chunk_depot.lock);
+
+    free_chunks(excess);
+    return true;
+}
+
+void msgpack_zone_chunk_cache_flush(void)
+{
+    chunk_magazine* const m = &chunk_tls;
+    chunk_drain(m, m->count);
+}
+
+void msgpack_zone_chunk_cache_get_stats(msgpack_zone_chunk_cache_stats* stats)
+{
+    pthread_mutex_lock(&chunk_depot.lock);
+    stats->hits = chunk_depot.hits;
+    stats->misses = chunk_depot.misses;
+    stats->bytes_cached = (chunk_depot.count + chunk_depot.magazine_chunks) *
+        (sizeof(msgpack_zone_chunk) + MSGPACK_ZONE_CHUNK_SIZE);
+    pthread_mutex_unlock(&chunk_depot.lock);
+}
+
+#else  /* MSGPACK_ZONE_CHUNK_CACHE */
+
+bool msgpack_zone_chunk_cache_set_limits(size_t thread_limit, size_t depot_limit)
+{
+    (void)thread_limit;
+    (void)depot_limit;
+    return false;
+}
+
+void msgpack_zone_chunk_cache_flush(void)
+{
+}
+
+void msgpack_zone_chunk_cache_get_stats(msgpack_zone_chunk_cache_stats* stats)
+{
+    memset(stats, 0, sizeof(msgpack_zone_chunk_cache_stats));
+}
+
+#endif /* MSGPACK_ZONE_CHUNK_CACHE */
@@ -0,0 +1,159 @@
+/*
+ * MessagePack for C mmap-backed zone chunks
+ *
+ *    Distributed under the Boost Software License, Version 1.0.
+ *    (See accompanying file LICENSE_1_0.txt or copy at
+ *    http://www.boost.org/LICENSE_1_0.txt)
+ */
+#include "msgpack/zone.h"
+#include "msgpack/allocator.h"
+#include <stdlib.h>
+
+#if !defined(_WIN32)
+#include <sys/mman.h>
+#endif
+
+#if !defined(_WIN32) && (defined(MAP_ANONYMOUS) || defined(MAP_ANON))
+
+#if !defined(MAP_ANONYMOUS)
+#define MAP_ANONYMOUS MAP_ANON
+#endif
+
+#if !defined(MAP_NORESERVE)
+#define MAP_NORESERVE 0
+#endif
+
+/* huge page size on x86-64 and arm64, the region is aligned to it */
+#define ZONE_MMAP_ALIGN ((size_t)2 * 1024 * 1024)
+#define ZONE_MMAP_CHUNK_ALIGN 64
+
+typedef struct {
+    char* base;
+    size_t size;
+    size_t top;         /* end of the last chunk handed out */
+    size_t high;        /* max top since the pages were last given back */
+    size_t live;        /* chunks of the region not freed */
+} zone_mmap_region;
+
+static inline size_t zone_mmap_round(size_t size)
+{
+    return (size + (ZONE_MMAP_CHUNK_ALIGN - 1)) & ~(size_t)(ZONE_MMAP_CHUNK_ALIGN - 1);
+}
+
+static void* zone_mmap_alloc(void* ctx, size_t size)
+{
+    zone_mmap_region* r = (zone_mmap_region*)ctx;
+    size_t n = zone_mmap_round(size);
+    char* p;
+
+    if(n < size || n > r->size - r->top) {
+        return msgpack_allocator_malloc(NULL, size);
+    }
+    p = r->base + r->top;
+    r->top += n;
+    if(r->top > r->high) {
+        r->high = r->top;
+    }
+    ++r->live;
+    return p;
+}
+
+static void zone_mmap_free(void* ctx, void* ptr, size_t size)
+{
+    zone_mmap_region* r = (zone_mmap_region*)ctx;
+    char* p = (char*)ptr;
+
+    if(p < r->base || p >= r->base + r->size) {
+        msgpack_allocator_free(NULL, ptr);
+        return;
+    }
+    if(p + zone_mmap_round(size) == r->base + r->top) {
+        r->top = (size_t)(p - r->base);
+    }
+    if(--r->live == 0) {
+        madvise(r->base, r->high, MADV_DONTNEED);
+        r->top = 0;
+        r->high = 0;
+    }
+}
+
+bool msgpack_zone_mmap_provider_init(msgpack_zone_chunk_provider* provider,
+        size_t reserve, bool huge_pages)
+{
+    zone_mmap_region* r;
+    char* map;
+    char* base;
+    size_t size;
+    size_t head;
+
+    if(reserve == 0 || reserve > SIZE_MAX - 2 * ZONE_MMAP_ALIGN) {
+        return false;
+    }
+    size = (reserve + (ZONE_MMAP_ALIGN - 1)) & ~(ZONE_MMAP_ALIGN - 1);
+
+    r = (zone_mmap_region*)msgpack_allocator_malloc(NULL, sizeof(zone_mmap_region));
+    if(r == NULL) {
+        return false;
+    }
+
+    /* over-reserve to align the region, then unmap the slack */
+    map = (char*)mmap(NULL, size + ZONE_MMAP_ALIGN, PROT_READ | PROT_WRITE,
+            MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if(map == (char*)MAP_FAILED) {
+        msgpack_allocator_free(NULL, r);
+        return false;
+    }
+    base = (char*)(((uintptr_t)map + (ZONE_MMAP_ALIGN - 1)) & ~(uintptr_t)(ZONE_MMAP_ALIGN - 1));
+    head = (size_t)(base - map);
+    if(head > 0) {
+        munmap(map, head);
+    }
+    munmap(base + size, ZONE_MMAP_ALIGN - head);
+
+#if defined(MADV_HUGEPAGE)
+    if(huge_pages) {
+        /* advisory: without THP support the region uses normal pages */
+        madvise(base, size, MADV_HUGEPAGE);
+    }
+#else
+    (void)huge_pages;
+#endif
+
+    r->base = base;
+    r->size = size;
+    r->top = 0;
+    r->high = 0;
+    r->live = 0;
+
+    provider->alloc = zone_mmap_alloc;
+    provider->free = zone_mmap_free;
+    provider->ctx = r;
+    return true;
+}
+
+void msgpack_zone_mmap_provider_destroy(msgpack_zone_chunk_provider* provider)
+{
+    zone_mmap_region* r = (zone_mmap_region*)provider->ctx;
+    if(r == NULL) { return; }
+    munmap(r->base, r->size);
+    msgpack_allocator_free(NULL, r);
+    provider->ctx = NULL;
+}
+
+#else  /* mmap */
+
+bool msgpack_zone_mmap_provider_init(msgpack_zone_chunk_provider* provider,
+        size_t reserve, bool huge_pages)
+{
+    (void)provider;
+    (void)reserve;
+    (void)huge_pages;
+    return false;
+}
+
+void msgpack_zone_mmap_provider_destroy(msgpack_zone_chunk_provider* provider)
+{
+    (void)provider;
+}
+
+#endif /* mmap */
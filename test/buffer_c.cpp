@@ -1,5 +1,8 @@
+#include <msgpack.h>
 #include <msgpack/fbuffer.h>
+#include <msgpack/fdbuffer.h>
 #include <msgpack/zbuffer.h>
+#include <msgpack/pzbuffer.h>
 #include <msgpack/sbuffer.h>
 #include <msgpack/vrefbuffer.h>
 
@@ -15,6 +18,7 @@
 #endif //defined(__GNUC__)
 
 #include <string.h>
+#include <vector>
 
 #if defined(unix) || defined(__unix) || defined(__linux__) || defined(__APPLE__) || defined(__OpenBSD__) || defined(__NetBSD__) || defined(__QNX__) || defined(__QNXTO__) || defined(__HAIKU__)
 #define HAVE_SYS_UIO_H 1
@@ -36,6 +40,143 @@ TEST(buffer, zbuffer_c)
     msgpack_zbuffer_destroy(&zbuf);
 }
 
+#if !defined(_WIN32)
+
+static void pzbuffer_check(size_t nthreads, size_t records)
+{
+    msgpack_sbuffer sbuf;
+    msgpack_sbuffer_init(&sbuf);
+    msgpack_packer spk;
+    msgpack_packer_init(&spk, &sbuf, msgpack_sbuffer_write);
+
+    msgpack_pzbuffer* pzbuf = msgpack_pzbuffer_new(Z_DEFAULT_COMPRESSION, 0, nthreads);
+    ASSERT_TRUE(pzbuf != NULL);
+    msgpack_packer pk;
+    msgpack_packer_init(&pk, pzbuf, msgpack_pzbuffer_write);
+
+    for (size_t i = 0; i < records; i++) {
+        msgpack_packer* pks[] = { &spk, &pk };
+        for (size_t j = 0; j < 2; j++) {
+            EXPECT_EQ(0, msgpack_pack_map(pks[j], 2));
+            EXPECT_EQ(0, msgpack_pack_str_with_body(pks[j], "id", 2));
+            EXPECT_EQ(0, msgpack_pack_uint64(pks[j], i * 2654435761u));
+            EXPECT_EQ(0, msgpack_pack_str_with_body(pks[j], "name", 4));
+            EXPECT_EQ(0, msgpack_pack_str_with_body(pks[j], "a repeated name", 15));
+        }
+    }
+
+    EXPECT_TRUE(msgpack_pzbuffer_flush(pzbuf) != NULL);
+    if (records > 0) {
+        EXPECT_LT(msgpack_pzbuffer_size(pzbuf), sbuf.size);
+    }
+
+    uLongf len = (uLongf)sbuf.size;
+    char* out = (char*)malloc(sbuf.size + 16);
+    EXPECT_EQ(Z_OK, uncompress((Bytef*)out, &len,
+        (const Bytef*)msgpack_pzbuffer_data(pzbuf), (uLong)msgpack_pzbuffer_size(pzbuf)));
+    EXPECT_EQ(sbuf.size, (size_t)len);
+    if (sbuf.size > 0) {
+        EXPECT_EQ(0, memcmp(out, sbuf.data, sbuf.size));
+    }
+
+    // a reset starts a new stream
+    EXPECT_TRUE(msgpack_pzbuffer_reset(pzbuf));
+    EXPECT_EQ(0, msgpack_pzbuffer_write(pzbuf, "abc", 3));
+    EXPECT_TRUE(msgpack_pzbuffer_flush(pzbuf) != NULL);
+    len = (uLongf)sbuf.size + 16;
+    EXPECT_EQ(Z_OK, uncompress((Bytef*)out, &len,
+        (const Bytef*)msgpack_pzbuffer_data(pzbuf), (uLong)msgpack_pzbuffer_size(pzbuf)));
+    EXPECT_EQ(3u, (size_t)len);
+    EXPECT_EQ(0, memcmp(out, "abc", 3));
+
+    free(out);
+    msgpack_pzbuffer_free(pzbuf);
+    msgpack_sbuffer_destroy(&sbuf);
+}
+
+TEST(buffer, pzbuffer_c)
+{
+    pzbuffer_check(1, 0);
+    pzbuffer_check(1, 100000);
+    pzbuffer_check(4, 100000);
+    pzbuffer_check(0, 1000);
+}
+
+TEST(buffer, pzbuffer_pipelined_c)
+{
+    msgpack_sbuffer sbuf;
+    msgpack_sbuffer_init(&sbuf);
+    msgpack_pzbuffer pzbuf;
+    ASSERT_TRUE(msgpack_pzbuffer_init_pipelined(&pzbuf, Z_DEFAULT_COMPRESSION, 0, 1));
+
+    for (size_t i = 0; i < 100000; i++) {
+        msgpack_packer pk;
+        msgpack_packer_init(&pk, &sbuf, msgpack_sbuffer_write);
+        EXPECT_EQ(0, msgpack_pack_uint64(&pk, i * 2654435761u));
+        EXPECT_EQ(0, msgpack_pack_str_with_body(&pk, "a repeated name", 15));
+    }
+    for (size_t off = 0; off < sbuf.size; off += 1000) {
+        size_t n = sbuf.size - off < 1000 ? sbuf.size - off : 1000;
+        EXPECT_EQ(0, msgpack_pzbuffer_write(&pzbuf, sbuf.data + off, n));
+    }
+    EXPECT_TRUE(msgpack_pzbuffer_flush(&pzbuf) != NULL);
+
+    // the same single zlib stream as msgpack_zbuffer produces
+    uLongf len = (uLongf)sbuf.size;
+    char* out = (char*)malloc(sbuf.size);
+    EXPECT_EQ(Z_OK, uncompress((Bytef*)out, &len,
+        (const Bytef*)msgpack_pzbuffer_data(&pzbuf), (uLong)msgpack_pzbuffer_size(&pzbuf)));
+    EXPECT_EQ(sbuf.size, (size_t)len);
+    EXPECT_EQ(0, memcmp(out, sbuf.data, sbuf.size));
+
+    msgpack_pzbuffer_stats stats;
+    msgpack_pzbuffer_get_stats(&pzbuf, &stats);
+    EXPECT_EQ(0u, stats.queue_depth);
+    EXPECT_EQ(sbuf.size / MSGPACK_PZBUFFER_BLOCK_SIZE + 1, stats.blocks);
+    EXPECT_LE(1u, stats.max_queue_depth);
+    EXPECT_LE(stats.max_queue_depth, 2u);
+    EXPECT_EQ(stats.stalls == 0, stats.stall_ns == 0);
+
+    EXPECT_TRUE(msgpack_pzbuffer_reset(&pzbuf));
+    EXPECT_EQ(0, msgpack_pzbuffer_write(&pzbuf, "abc", 3));
+    EXPECT_TRUE(msgpack_pzbuffer_flush(&pzbuf) != NULL);
+    len = (uLongf)sbuf.size;
+    EXPECT_EQ(Z_OK, uncompress((Bytef*)out, &len,
+        (const Bytef*)msgpack_pzbuffer_data(&pzbuf), (uLong)msgpack_pzbuffer_size(&pzbuf)));
+    EXPECT_EQ(3u, (size_t)len);
+    EXPECT_EQ(0, memcmp(out, "abc", 3));
+
+    free(out);
+    msgpack_pzbuffer_destroy(&pzbuf);
+    msgpack_sbuffer_destroy(&sbuf);
+}
+
+TEST(buffer, pzbuffer_stalls_c)
+{
+    // deflating at level 9 is much slower than copying: the producer fills
+    // the queue and waits
+    msgpack_pzbuffer pzbuf;
+    ASSERT_TRUE(msgpack_pzbuffer_init_pipelined(&pzbuf, Z_BEST_COMPRESSION, 0, 1));
+    std::vector<char> data(16 * MSGPACK_PZBUFFER_BLOCK_SIZE);
+    uint32_t x = 1;
+    for (size_t i = 0; i < data.size(); i++) {
+        x = x * 1103515245u + 12345u;
+        data[i] = (char)('a' + (x >> 16) % 8);
+    }
+    EXPECT_EQ(0, msgpack_pzbuffer_write(&pzbuf, data.data(), data.size()));
+    EXPECT_TRUE(msgpack_pzbuffer_flush(&pzbuf) != NULL);
+
+    msgpack_pzbuffer_stats stats;
+    msgpack_pzbuffer_get_stats(&pzbuf, &stats);
+    EXPECT_EQ(2u, stats.max_queue_depth);
+    EXPECT_LT(0u, stats.stalls);
+    EXPECT_LT(0u, stats.stall_ns);
+
+    msgpack_pzbuffer_destroy(&pzbuf);
+}
+
+#endif // !defined(_WIN32)
+
 TEST(buffer, fbuffer_c)
 {
 #if defined(_MSC_VER)
@@ -85,6 +226,116 @@ TEST(buffer, sbuffer_c)
     msgpack_sbuffer_free(sbuf);
 }
 
+// counts the blocks allocated through it
+struct counting_allocator {
+    msgpack_allocator base;
+    int live;
+    int calls;
+};
+
+static void* counting_malloc(void* ctx, size_t size)
+{
+    counting_allocator* a = (counting_allocator*)ctx;
+    ++a->live;
+    ++a->calls;
+    return malloc(size);
+}
+
+static void* counting_realloc(void* ctx, void* ptr, size_t size)
+{
+    counting_allocator* a = (counting_allocator*)ctx;
+    if (ptr == NULL) ++a->live;
+    ++a->calls;
+    return realloc(ptr, size);
+}
+
+static void counting_free(void* ctx, void* ptr)
+{
+    counting_allocator* a = (counting_allocator*)ctx;
+    --a->live;
+    free(ptr);
+}
+
+static void counting_allocator_init(counting_allocator* a)
+{
+    a->base.malloc = counting_malloc;
+    a->base.realloc = counting_realloc;
+    a->base.free = counting_free;
+    a->base.ctx = a;
+    a->live = 0;
+    a->calls = 0;
+}
+
+TEST(buffer, allocator_c)
+{
+    counting_allocator a;
+    counting_allocator_init(&a);
+
+    msgpack_sbuffer sbuf;
+    msgpack_sbuffer_init_with_allocator(&sbuf, &a.base);
+    msgpack_packer pk;
+    msgpack_packer_init(&pk, &sbuf, msgpack_sbuffer_write);
+    for (int i = 0; i < 1000; ++i) {
+        msgpack_pack_array(&pk, 2);
+        msgpack_pack_int(&pk, i);
+        msgpack_pack_str_with_body(&pk, "0123456789abcdef", 16);
+    }
+    EXPECT_EQ(1, a.live);
+
+    msgpack_vrefbuffer vbuf;
+    ASSERT_TRUE(msgpack_vrefbuffer_init_with_allocator(&vbuf, 0, 64, &a.base));
+    for (int i = 0; i < 100; ++i) {
+        EXPECT_EQ(0, msgpack_vrefbuffer_write(&vbuf, "0123456789", 10));
+    }
+    EXPECT_LT(3, a.live);
+    msgpack_vrefbuffer_destroy(&vbuf);
+    EXPECT_EQ(1, a.live);
+
+    // results keep the unpacker buffer alive past the unpacker
+    msgpack_unpacker unp;
+    ASSERT_TRUE(msgpack_unpacker_init_with_allocator(&unp, 256, &a.base));
+    msgpack_unpacked results[3];
+    size_t fed = 0;
+    int got = 0;
+    while (got < 3) {
+        ASSERT_TRUE(msgpack_unpacker_reserve_buffer(&unp, 100));
+        memcpy(msgpack_unpacker_buffer(&unp), sbuf.data + fed, 100);
+        msgpack_unpacker_buffer_consumed(&unp, 100);
+        fed += 100;
+        msgpack_unpacked_init(&results[got]);
+        while (got < 3 && msgpack_unpacker_next(&unp, &results[got]) == MSGPACK_UNPACK_SUCCESS) {
+            if (++got < 3) msgpack_unpacked_init(&results[got]);
+        }
+    }
+    EXPECT_EQ(3, a.live); // sbuf, the unpacker buffer and context
+    msgpack_unpacker_destroy(&unp);
+    EXPECT_EQ(2, a.live);
+    for (int i = 0; i < 3; ++i) {
+        EXPECT_EQ(16u, results[i].data.via.array.ptr[1].via.str.size);
+        msgpack_unpacked_destroy(&results[i]);
+    }
+    EXPECT_EQ(1, a.live);
+
+    msgpack_sbuffer_destroy(&sbuf);
+    EXPECT_EQ(0, a.live);
+
+    // the default allocator
+    msgpack_allocator_set_default(&a.base);
+    EXPECT_EQ(&a.base, msgpack_allocator_get_default());
+    msgpack_zone* z = msgpack_zone_new(MSGPACK_ZONE_CHUNK_SIZE);
+    ASSERT_TRUE(z != NULL);
+    EXPECT_TRUE(msgpack_zone_malloc(z, 2 * MSGPACK_ZONE_CHUNK_SIZE) != NULL);
+    EXPECT_EQ(3, a.live);
+    msgpack_zone_free(z);
+    msgpack_sbuffer* psbuf = msgpack_sbuffer_new();
+    EXPECT_EQ(0, msgpack_sbuffer_write(psbuf, "x", 1));
+    EXPECT_EQ(2, a.live);
+    msgpack_sbuffer_free(psbuf);
+    EXPECT_EQ(0, a.live);
+    msgpack_allocator_set_default(NULL);
+    EXPECT_EQ(msgpack_allocator_libc(), msgpack_allocator_get_default());
+}
+
 TEST(buffer, vrefbuffer_c)
 {
     const char *raw = "I was about to sail away in a junk,"
@@ -146,3 +397,88 @@ TEST(buffer, vrefbuffer_c)
     free(buf);
     msgpack_vrefbuffer_free(vbuf);
 }
+
+#if HAVE_SYS_UIO_H
+#include <fcntl.h>
+#include <errno.h>
+
+TEST(buffer, fdbuffer_c)
+{
+    const size_t body_size = 256 * 1024;
+    char *body = (char *)malloc(body_size);
+    for (size_t i = 0; i < body_size; i++) {
+        body[i] = (char)(i * 7);
+    }
+
+    msgpack_sbuffer sbuf;
+    msgpack_sbuffer_init(&sbuf);
+    msgpack_packer spk;
+    msgpack_packer_init(&spk, &sbuf, msgpack_sbuffer_write);
+    msgpack_pack_array(&spk, 3);
+    msgpack_pack_int(&spk, 1);
+    msgpack_pack_bin_with_body(&spk, body, body_size);
+    msgpack_pack_str_with_body(&spk, "tail", 4);
+
+    int fds[2];
+    ASSERT_EQ(0, pipe(fds));
+    fcntl(fds[0], F_SETFL, fcntl(fds[0], F_GETFL) | O_NONBLOCK);
+    fcntl(fds[1], F_SETFL, fcntl(fds[1], F_GETFL) | O_NONBLOCK);
+
+    msgpack_fdbuffer *fdbuf = msgpack_fdbuffer_new(fds[1], 0, 0);
+    ASSERT_TRUE(fdbuf != NULL);
+    msgpack_packer pk;
+    msgpack_packer_init(&pk, fdbuf, msgpack_fdbuffer_write);
+    msgpack_pack_array(&pk, 3);
+    msgpack_pack_int(&pk, 1);
+    msgpack_pack_bin_with_body(&pk, body, body_size);
+    msgpack_pack_str_with_body(&pk, "tail", 4);
+
+    // the body is referenced, not copied
+    EXPECT_EQ(sbuf.size, msgpack_fdbuffer_pending(fdbuf));
+    bool referenced = false;
+    for (size_t i = 0; i < msgpack_vrefbuffer_veclen(&fdbuf->vbuf); i++) {
+        if (msgpack_vrefbuffer_vec(&fdbuf->vbuf)[i].iov_base == body) {
+            referenced = true;
+        }
+    }
+    EXPECT_TRUE(referenced);
+
+    char *out = (char *)malloc(sbuf.size);
+    size_t received = 0;
+    int again = 0;
+    while (true) {
+        int ret = msgpack_fdbuffer_flush(fdbuf);
+        if (ret == 0) {
+            break;
+        }
+        ASSERT_TRUE(errno == EAGAIN || errno == EWOULDBLOCK);
+        ++again;
+        EXPECT_LT(0U, msgpack_fdbuffer_pending(fdbuf));
+        ssize_t n;
+        while ((n = read(fds[0], out + received, sbuf.size - received)) > 0) {
+            received += (size_t)n;
+        }
+    }
+    EXPECT_LT(0, again);
+    EXPECT_EQ(0U, msgpack_fdbuffer_pending(fdbuf));
+    ssize_t n;
+    while ((n = read(fds[0], out + received, sbuf.size - received)) > 0) {
+        received += (size_t)n;
+    }
+    EXPECT_EQ(sbuf.size, received);
+    EXPECT_EQ(0, memcmp(out, sbuf.data, sbuf.size));
+
+    // the buffer is reusable after a complete flush
+    EXPECT_EQ(0, msgpack_pack_nil(&pk));
+    EXPECT_EQ(0, msgpack_fdbuffer_flush(fdbuf));
+    EXPECT_EQ(1, read(fds[0], out, 1));
+    EXPECT_EQ((char)0xc0, out[0]);
+
+    msgpack_fdbuffer_free(fdbuf);
+    close(fds[0]);
+    close(fds[1]);
+    free(out);
+    free(body);
+    msgpack_sbuffer_destroy(&sbuf);
+}
+#endif
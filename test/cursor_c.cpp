@@ -0,0 +1,182 @@
+#include <msgpack.h>
+#include <msgpack/cursor.h>
+
+#if defined(__GNUC__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wconversion"
+#endif //defined(__GNUC__)
+
+#include <gtest/gtest.h>
+
+#if defined(__GNUC__)
+#pragma GCC diagnostic pop
+#endif //defined(__GNUC__)
+
+// {"id": 42, "payload": [1, -300, 2.5, true, bin], "user": {"name": "alice", "age": 7}, "score": -1.5f}
+static void pack_message(msgpack_sbuffer* sbuf)
+{
+    msgpack_packer pk;
+    msgpack_packer_init(&pk, sbuf, msgpack_sbuffer_write);
+
+    msgpack_pack_map(&pk, 4);
+    msgpack_pack_str_with_body(&pk, "id", 2);
+    msgpack_pack_uint64(&pk, 42);
+    msgpack_pack_str_with_body(&pk, "payload", 7);
+    msgpack_pack_array(&pk, 5);
+    msgpack_pack_int(&pk, 1);
+    msgpack_pack_int(&pk, -300);
+    msgpack_pack_double(&pk, 2.5);
+    msgpack_pack_true(&pk);
+    msgpack_pack_bin_with_body(&pk, "\x01\x02\x03", 3);
+    msgpack_pack_str_with_body(&pk, "user", 4);
+    msgpack_pack_map(&pk, 2);
+    msgpack_pack_str_with_body(&pk, "name", 4);
+    msgpack_pack_str_with_body(&pk, "alice", 5);
+    msgpack_pack_str_with_body(&pk, "age", 3);
+    msgpack_pack_int(&pk, 7);
+    msgpack_pack_str_with_body(&pk, "score", 5);
+    msgpack_pack_float(&pk, -1.5f);
+}
+
+TEST(cursor, find_key)
+{
+    msgpack_sbuffer sbuf;
+    msgpack_sbuffer_init(&sbuf);
+    pack_message(&sbuf);
+
+    msgpack_cursor root;
+    msgpack_cursor_init(&root, sbuf.data, sbuf.size, 0);
+    EXPECT_EQ(MSGPACK_OBJECT_MAP, msgpack_cursor_type(&root));
+
+    msgpack_cursor user, name, age, score, id;
+    ASSERT_TRUE(msgpack_cursor_find_key(&root, "user", 4, &user));
+    ASSERT_TRUE(msgpack_cursor_find_key(&user, "name", 4, &name));
+    const char* ptr;
+    uint32_t size;
+    EXPECT_TRUE(msgpack_cursor_as_str(&name, &ptr, &size));
+    EXPECT_EQ(5u, size);
+    EXPECT_EQ(0, memcmp("alice", ptr, 5));
+    int64_t i;
+    EXPECT_FALSE(msgpack_cursor_as_int(&name, &i));
+
+    ASSERT_TRUE(msgpack_cursor_find_key(&user, "age", 3, &age));
+    EXPECT_TRUE(msgpack_cursor_as_int(&age, &i));
+    EXPECT_EQ(7, i);
+
+    ASSERT_TRUE(msgpack_cursor_find_key(&root, "id", 2, &id));
+    uint64_t u;
+    EXPECT_TRUE(msgpack_cursor_as_uint(&id, &u));
+    EXPECT_EQ(42u, u);
+
+    ASSERT_TRUE(msgpack_cursor_find_key(&root, "score", 5, &score));
+    double d;
+    EXPECT_TRUE(msgpack_cursor_as_double(&score, &d));
+    EXPECT_EQ(-1.5, d);
+
+    msgpack_cursor none;
+    EXPECT_FALSE(msgpack_cursor_find_key(&root, "missing", 7, &none));
+    EXPECT_FALSE(msgpack_cursor_find_key(&name, "x", 1, &none));
+
+    // the raw bytes of a subtree, to forward it as is
+    const char* raw;
+    size_t raw_size;
+    EXPECT_TRUE(msgpack_cursor_raw(&user, &raw, &raw_size));
+    msgpack_sbuffer expected;
+    msgpack_sbuffer_init(&expected);
+    msgpack_packer pk;
+    msgpack_packer_init(&pk, &expected, msgpack_sbuffer_write);
+    msgpack_pack_map(&pk, 2);
+    msgpack_pack_str_with_body(&pk, "name", 4);
+    msgpack_pack_str_with_body(&pk, "alice", 5);
+    msgpack_pack_str_with_body(&pk, "age", 3);
+    msgpack_pack_int(&pk, 7);
+    EXPECT_EQ(expected.size, raw_size);
+    EXPECT_EQ(0, memcmp(expected.data, raw, raw_size));
+    msgpack_sbuffer_destroy(&expected);
+
+    EXPECT_TRUE(msgpack_cursor_raw(&root, &raw, &raw_size));
+    EXPECT_EQ(sbuf.size, raw_size);
+
+    msgpack_sbuffer_destroy(&sbuf);
+}
+
+TEST(cursor, enter_next)
+{
+    msgpack_sbuffer sbuf;
+    msgpack_sbuffer_init(&sbuf);
+    pack_message(&sbuf);
+
+    msgpack_cursor root, payload, it;
+    msgpack_cursor_init(&root, sbuf.data, sbuf.size, 0);
+    ASSERT_TRUE(msgpack_cursor_find_key(&root, "payload", 7, &payload));
+    EXPECT_EQ(MSGPACK_OBJECT_ARRAY, msgpack_cursor_type(&payload));
+    ASSERT_TRUE(msgpack_cursor_enter(&payload, &it));
+
+    int64_t i;
+    double d;
+    bool b;
+    const char* ptr;
+    uint32_t size;
+    EXPECT_TRUE(msgpack_cursor_as_int(&it, &i));
+    EXPECT_EQ(1, i);
+    EXPECT_TRUE(msgpack_cursor_next(&it));
+    EXPECT_TRUE(msgpack_cursor_as_int(&it, &i));
+    EXPECT_EQ(-300, i);
+    uint64_t u;
+    EXPECT_FALSE(msgpack_cursor_as_uint(&it, &u));
+    EXPECT_TRUE(msgpack_cursor_next(&it));
+    EXPECT_TRUE(msgpack_cursor_as_double(&it, &d));
+    EXPECT_EQ(2.5, d);
+    EXPECT_TRUE(msgpack_cursor_next(&it));
+    EXPECT_TRUE(msgpack_cursor_as_bool(&it, &b));
+    EXPECT_TRUE(b);
+    EXPECT_TRUE(msgpack_cursor_next(&it));
+    EXPECT_TRUE(msgpack_cursor_as_bin(&it, &ptr, &size));
+    EXPECT_EQ(3u, size);
+    EXPECT_FALSE(msgpack_cursor_next(&it));
+    EXPECT_FALSE(msgpack_cursor_valid(&it));
+
+    // keys and values alternate in a map
+    ASSERT_TRUE(msgpack_cursor_enter(&root, &it));
+    EXPECT_TRUE(msgpack_cursor_key_equals(&it, "id", 2));
+    int keys = 0;
+    do {
+        ++keys;
+    } while (msgpack_cursor_next(&it) && msgpack_cursor_next(&it));
+    EXPECT_EQ(4, keys);
+
+    // the whole value can still be unpacked
+    msgpack_zone zone;
+    msgpack_zone_init(&zone, 2048);
+    msgpack_object obj;
+    EXPECT_TRUE(msgpack_cursor_object(&payload, &zone, &obj));
+    EXPECT_EQ(MSGPACK_OBJECT_ARRAY, obj.type);
+    EXPECT_EQ(5u, obj.via.array.size);
+    msgpack_zone_destroy(&zone);
+
+    // a scalar cannot be entered
+    msgpack_cursor scalar;
+    ASSERT_TRUE(msgpack_cursor_enter(&payload, &scalar));
+    EXPECT_FALSE(msgpack_cursor_enter(&scalar, &it));
+
+    msgpack_sbuffer_destroy(&sbuf);
+}
+
+TEST(cursor, truncated)
+{
+    msgpack_sbuffer sbuf;
+    msgpack_sbuffer_init(&sbuf);
+    pack_message(&sbuf);
+
+    // every prefix fails cleanly
+    for (size_t len = 0; len < sbuf.size; ++len) {
+        msgpack_cursor root, value;
+        msgpack_cursor_init(&root, sbuf.data, len, 0);
+        msgpack_cursor_find_key(&root, "score", 5, &value);
+        const char* raw;
+        size_t raw_size;
+        EXPECT_FALSE(msgpack_cursor_raw(&root, &raw, &raw_size));
+    }
+
+    msgpack_sbuffer_destroy(&sbuf);
+}
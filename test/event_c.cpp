@@ -0,0 +1,252 @@
+#include <msgpack.h>
+#include <msgpack/event.h>
+
+#if defined(__GNUC__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wconversion"
+#endif //defined(__GNUC__)
+
+#include <gtest/gtest.h>
+
+#if defined(__GNUC__)
+#pragma GCC diagnostic pop
+#endif //defined(__GNUC__)
+
+#include <string>
+#include <sstream>
+
+static int trace_nil(void* data)
+{
+    *(std::string*)data += "nil ";
+    return 0;
+}
+
+static int trace_boolean(void* data, bool v)
+{
+    *(std::string*)data += v ? "true " : "false ";
+    return 0;
+}
+
+static int trace_positive(void* data, uint64_t v)
+{
+    std::ostringstream os;
+    os << v << ' ';
+    *(std::string*)data += os.str();
+    return 0;
+}
+
+static int trace_negative(void* data, int64_t v)
+{
+    std::ostringstream os;
+    os << v << ' ';
+    *(std::string*)data += os.str();
+    return 0;
+}
+
+static int trace_float64(void* data, double v)
+{
+    std::ostringstream os;
+    os << v << "d ";
+    *(std::string*)data += os.str();
+    return 0;
+}
+
+static int trace_str(void* data, const char* ptr, uint32_t size)
+{
+    *(std::string*)data += "\"" + std::string(ptr, size) + "\" ";
+    return 0;
+}
+
+static int trace_ext(void* data, int8_t type, const char* ptr, uint32_t size)
+{
+    std::ostringstream os;
+    os << "ext" << (int)type << ':' << std::string(ptr, size) << ' ';
+    *(std::string*)data += os.str();
+    return 0;
+}
+
+static int trace_key(void* data, const char* ptr, uint32_t size)
+{
+    *(std::string*)data += std::string(ptr, size) + ": ";
+    return 0;
+}
+
+static int trace_begin_array(void* data, uint32_t size)
+{
+    std::ostringstream os;
+    os << '[' << size << ' ';
+    *(std::string*)data += os.str();
+    return 0;
+}
+
+static int trace_begin_map(void* data, uint32_t size)
+{
+    std::ostringstream os;
+    os << '{' << size << ' ';
+    *(std::string*)data += os.str();
+    return 0;
+}
+
+static int trace_end_array(void* data)
+{
+    *(std::string*)data += "] ";
+    return 0;
+}
+
+static int trace_end_map(void* data)
+{
+    *(std::string*)data += "} ";
+    return 0;
+}
+
+static msgpack_event_callbacks trace_callbacks()
+{
+    msgpack_event_callbacks cb;
+    memset(&cb, 0, sizeof(cb));
+    cb.nil = trace_nil;
+    cb.boolean = trace_boolean;
+    cb.positive_integer = trace_positive;
+    cb.negative_integer = trace_negative;
+    cb.float64 = trace_float64;
+    cb.str = trace_str;
+    cb.ext = trace_ext;
+    cb.key = trace_key;
+    cb.begin_array = trace_begin_array;
+    cb.begin_map = trace_begin_map;
+    cb.end_array = trace_end_array;
+    cb.end_map = trace_end_map;
+    return cb;
+}
+
+static const char* const expected_trace =
+    "{4 a: [4 1 -2 nil true ] b: {0 } 3 [1 \"v\" ] c: {1 d: ext5:xy } } "
+    "[0 ] 0.5d ";
+
+static void pack_sample(msgpack_sbuffer* sbuf)
+{
+    msgpack_packer pk;
+    msgpack_packer_init(&pk, sbuf, msgpack_sbuffer_write);
+
+    msgpack_pack_map(&pk, 4);
+    msgpack_pack_str_with_body(&pk, "a", 1);
+    msgpack_pack_array(&pk, 4);
+    msgpack_pack_int(&pk, 1);
+    msgpack_pack_int(&pk, -2);
+    msgpack_pack_nil(&pk);
+    msgpack_pack_true(&pk);
+    msgpack_pack_str_with_body(&pk, "b", 1);
+    msgpack_pack_map(&pk, 0);
+    // a non-str key is reported through the regular callbacks
+    msgpack_pack_int(&pk, 3);
+    msgpack_pack_array(&pk, 1);
+    msgpack_pack_str_with_body(&pk, "v", 1);
+    msgpack_pack_str_with_body(&pk, "c", 1);
+    msgpack_pack_map(&pk, 1);
+    msgpack_pack_str_with_body(&pk, "d", 1);
+    msgpack_pack_ext_with_body(&pk, "xy", 2, 5);
+
+    msgpack_pack_array(&pk, 0);
+    msgpack_pack_double(&pk, 0.5);
+}
+
+TEST(event, parse)
+{
+    msgpack_sbuffer sbuf;
+    msgpack_sbuffer_init(&sbuf);
+    pack_sample(&sbuf);
+
+    msgpack_event_callbacks cb = trace_callbacks();
+    std::string trace;
+    size_t off = 0;
+    int count = 0;
+    int ret;
+    while ((ret = msgpack_event_parse(&cb, &trace, sbuf.data, sbuf.size, &off)) == MSGPACK_UNPACK_SUCCESS) {
+        ++count;
+    }
+    EXPECT_EQ(MSGPACK_UNPACK_CONTINUE, ret);
+    EXPECT_EQ(3, count);
+    EXPECT_EQ(sbuf.size, off);
+    EXPECT_EQ(expected_trace, trace);
+
+    // truncated
+    trace.clear();
+    off = 0;
+    EXPECT_EQ(MSGPACK_UNPACK_CONTINUE, msgpack_event_parse(&cb, &trace, sbuf.data, 5, &off));
+    EXPECT_EQ(0u, off);
+
+    msgpack_sbuffer_destroy(&sbuf);
+}
+
+TEST(event, parser_streaming)
+{
+    msgpack_sbuffer sbuf;
+    msgpack_sbuffer_init(&sbuf);
+    pack_sample(&sbuf);
+
+    msgpack_event_callbacks cb = trace_callbacks();
+    std::string trace;
+    msgpack_event_parser* parser = msgpack_event_parser_new(&cb, &trace);
+    ASSERT_TRUE(parser != NULL);
+
+    // the bytes from off onward are given again with one more byte each time
+    size_t off = 0;
+    int count = 0;
+    for (size_t len = 1; len <= sbuf.size; ++len) {
+        int ret;
+        while ((ret = msgpack_event_parser_execute(parser, sbuf.data, len, &off)) > 0) {
+            ++count;
+        }
+        EXPECT_EQ(0, ret);
+    }
+    EXPECT_EQ(3, count);
+    EXPECT_EQ(sbuf.size, off);
+    EXPECT_EQ(expected_trace, trace);
+
+    msgpack_event_parser_free(parser);
+    msgpack_sbuffer_destroy(&sbuf);
+}
+
+static int abort_on_nil(void* data)
+{
+    (void)data;
+    return -10;
+}
+
+TEST(event, abort_and_errors)
+{
+    msgpack_sbuffer sbuf;
+    msgpack_sbuffer_init(&sbuf);
+    pack_sample(&sbuf);
+
+    msgpack_event_callbacks cb = trace_callbacks();
+    cb.nil = abort_on_nil;
+    std::string trace;
+    msgpack_event_parser parser;
+    ASSERT_TRUE(msgpack_event_parser_init(&parser, &cb, &trace));
+
+    size_t off = 0;
+    EXPECT_EQ(-10, msgpack_event_parser_execute(&parser, sbuf.data, sbuf.size, &off));
+    EXPECT_EQ("{4 a: [4 1 -2 ", trace);
+
+    // too deep
+    msgpack_sbuffer_clear(&sbuf);
+    msgpack_packer pk;
+    msgpack_packer_init(&pk, &sbuf, msgpack_sbuffer_write);
+    for (int i = 0; i < 100; ++i) {
+        msgpack_pack_array(&pk, 1);
+    }
+    msgpack_pack_nil(&pk);
+    msgpack_event_parser_reset(&parser);
+    off = 0;
+    EXPECT_EQ(MSGPACK_UNPACK_NOMEM_ERROR,
+              msgpack_event_parser_execute(&parser, sbuf.data, sbuf.size, &off));
+
+    // invalid byte
+    msgpack_event_parser_reset(&parser);
+    off = 0;
+    EXPECT_EQ(MSGPACK_UNPACK_PARSE_ERROR,
+              msgpack_event_parser_execute(&parser, "\xc1", 1, &off));
+
+    msgpack_event_parser_destroy(&parser);
+    msgpack_sbuffer_destroy(&sbuf);
+}
@@ -0,0 +1,181 @@
+#include <msgpack.h>
+#include <msgpack/filter.h>
+#include <algorithm>
+#include <vector>
+
+#if defined(__GNUC__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wconversion"
+#endif //defined(__GNUC__)
+
+#include <gtest/gtest.h>
+
+#if defined(__GNUC__)
+#pragma GCC diagnostic pop
+#endif //defined(__GNUC__)
+
+// {"id": i, "level": "warn" or "info", "tags": [i * 1.5, "t"]}
+static void pack_record(msgpack_packer* pk, int i)
+{
+    msgpack_pack_map(pk, 3);
+    msgpack_pack_str_with_body(pk, "id", 2);
+    msgpack_pack_int(pk, i);
+    msgpack_pack_str_with_body(pk, "level", 5);
+    if (i % 3 == 0) {
+        msgpack_pack_str_with_body(pk, "warning", 7);
+    } else {
+        msgpack_pack_str_with_body(pk, "info", 4);
+    }
+    msgpack_pack_str_with_body(pk, "tags", 4);
+    msgpack_pack_array(pk, 2);
+    msgpack_pack_double(pk, i * 1.5);
+    msgpack_pack_str_with_body(pk, "t", 1);
+}
+
+static int record_id(const char* data, size_t len)
+{
+    msgpack_zone zone;
+    msgpack_zone_init(&zone, 256);
+    msgpack_object obj;
+    int id = -1;
+    if (msgpack_unpack(data, len, NULL, &zone, &obj) == MSGPACK_UNPACK_SUCCESS) {
+        id = (int)obj.via.map.ptr[0].val.via.i64;
+    }
+    msgpack_zone_destroy(&zone);
+    return id;
+}
+
+TEST(filter, predicates)
+{
+    msgpack_sbuffer sbuf;
+    msgpack_sbuffer_init(&sbuf);
+    msgpack_packer pk;
+    msgpack_packer_init(&pk, &sbuf, msgpack_sbuffer_write);
+    pack_record(&pk, 6);
+
+    msgpack_object v;
+    v.type = MSGPACK_OBJECT_NEGATIVE_INTEGER;
+    v.via.i64 = 6;
+
+    msgpack_filter* f = msgpack_filter_new();
+    ASSERT_TRUE(f != NULL);
+    EXPECT_TRUE(msgpack_filter_match(f, sbuf.data, sbuf.size, 0));
+    EXPECT_TRUE(msgpack_filter_add_equal(f, "id", &v));
+    EXPECT_TRUE(msgpack_filter_add_int_range(f, "id", 0, 10));
+    EXPECT_TRUE(msgpack_filter_add_str_prefix(f, "level", "warn", 4));
+    v.type = MSGPACK_OBJECT_FLOAT32;
+    v.via.f64 = 9.0;
+    EXPECT_TRUE(msgpack_filter_add_equal(f, "tags[0]", &v));
+    v.type = MSGPACK_OBJECT_STR;
+    v.via.str.ptr = "t";
+    v.via.str.size = 1;
+    EXPECT_TRUE(msgpack_filter_add_equal(f, "tags[1]", &v));
+    EXPECT_TRUE(msgpack_filter_match(f, sbuf.data, sbuf.size, 0));
+
+    EXPECT_TRUE(msgpack_filter_add_int_range(f, "tags[2]", 0, 10));
+    EXPECT_FALSE(msgpack_filter_match(f, sbuf.data, sbuf.size, 0));
+    msgpack_filter_free(f);
+
+    f = msgpack_filter_new();
+    EXPECT_TRUE(msgpack_filter_add_int_range(f, "id", 7, 10));
+    EXPECT_FALSE(msgpack_filter_match(f, sbuf.data, sbuf.size, 0));
+    msgpack_filter_free(f);
+
+    f = msgpack_filter_new();
+    EXPECT_TRUE(msgpack_filter_add_str_prefix(f, "level", "warning!", 8));
+    EXPECT_FALSE(msgpack_filter_match(f, sbuf.data, sbuf.size, 0));
+    EXPECT_FALSE(msgpack_filter_add_int_range(f, "a..b", 0, 1));
+    EXPECT_FALSE(msgpack_filter_add_int_range(f, "a[x]", 0, 1));
+    v.type = MSGPACK_OBJECT_ARRAY;
+    EXPECT_FALSE(msgpack_filter_add_equal(f, "tags", &v));
+    msgpack_filter_free(f);
+
+    msgpack_sbuffer_destroy(&sbuf);
+}
+
+TEST(filter, next)
+{
+    msgpack_sbuffer sbuf;
+    msgpack_sbuffer_init(&sbuf);
+    msgpack_packer pk;
+    msgpack_packer_init(&pk, &sbuf, msgpack_sbuffer_write);
+    for (int i = 0; i < 10; ++i) {
+        pack_record(&pk, i);
+    }
+
+    msgpack_filter* f = msgpack_filter_new();
+    EXPECT_TRUE(msgpack_filter_add_str_prefix(f, "level", "warn", 4));
+
+    size_t off = 0;
+    size_t start;
+    int expected[] = { 0, 3, 6, 9 };
+    for (int i = 0; i < 4; ++i) {
+        ASSERT_EQ(MSGPACK_UNPACK_SUCCESS,
+                  msgpack_filter_next(f, sbuf.data, sbuf.size, &off, &start));
+        EXPECT_EQ(expected[i], record_id(sbuf.data + start, off - start));
+    }
+    EXPECT_EQ(MSGPACK_UNPACK_CONTINUE, msgpack_filter_next(f, sbuf.data, sbuf.size, &off, &start));
+    EXPECT_EQ(sbuf.size, off);
+
+    // a truncated record stops the scan at its beginning
+    off = 0;
+    EXPECT_EQ(MSGPACK_UNPACK_SUCCESS, msgpack_filter_next(f, sbuf.data, sbuf.size - 1, &off, &start));
+    EXPECT_EQ(MSGPACK_UNPACK_SUCCESS, msgpack_filter_next(f, sbuf.data, sbuf.size - 1, &off, &start));
+    EXPECT_EQ(MSGPACK_UNPACK_SUCCESS, msgpack_filter_next(f, sbuf.data, sbuf.size - 1, &off, &start));
+    size_t last = off;
+    EXPECT_EQ(MSGPACK_UNPACK_CONTINUE, msgpack_filter_next(f, sbuf.data, sbuf.size - 1, &off, &start));
+    EXPECT_LT(last, off);
+    EXPECT_EQ(9, record_id(sbuf.data + off, sbuf.size - off));
+
+    const char bad[] = { (char)0xc1 };
+    off = 0;
+    EXPECT_EQ(MSGPACK_UNPACK_PARSE_ERROR, msgpack_filter_next(f, bad, 1, &off, &start));
+
+    msgpack_filter_free(f);
+    msgpack_sbuffer_destroy(&sbuf);
+}
+
+TEST(filter, unpacker)
+{
+    msgpack_sbuffer sbuf;
+    msgpack_sbuffer_init(&sbuf);
+    msgpack_packer pk;
+    msgpack_packer_init(&pk, &sbuf, msgpack_sbuffer_write);
+    for (int i = 0; i < 100; ++i) {
+        pack_record(&pk, i);
+    }
+
+    msgpack_filter* f = msgpack_filter_new();
+    EXPECT_TRUE(msgpack_filter_add_int_range(f, "id", 40, 49));
+
+    msgpack_unpacker unp;
+    ASSERT_TRUE(msgpack_unpacker_init(&unp, 64));
+
+    // feed in small chunks so that records straddle the feeds
+    std::vector<int> ids;
+    size_t fed = 0;
+    while (fed < sbuf.size) {
+        size_t n = std::min<size_t>(7, sbuf.size - fed);
+        ASSERT_TRUE(msgpack_unpacker_reserve_buffer(&unp, n));
+        memcpy(msgpack_unpacker_buffer(&unp), sbuf.data + fed, n);
+        msgpack_unpacker_buffer_consumed(&unp, n);
+        fed += n;
+
+        const char* ptr;
+        size_t size;
+        msgpack_unpack_return ret;
+        while ((ret = msgpack_unpacker_filter_next(&unp, f, &ptr, &size)) == MSGPACK_UNPACK_SUCCESS) {
+            ids.push_back(record_id(ptr, size));
+        }
+        ASSERT_EQ(MSGPACK_UNPACK_CONTINUE, ret);
+    }
+    ASSERT_EQ(10u, ids.size());
+    for (int i = 0; i < 10; ++i) {
+        EXPECT_EQ(40 + i, ids[i]);
+    }
+    EXPECT_EQ(0u, msgpack_unpacker_message_size(&unp));
+
+    msgpack_unpacker_destroy(&unp);
+    msgpack_filter_free(f);
+    msgpack_sbuffer_destroy(&sbuf);
+}
@@ -0,0 +1,139 @@
+#include <msgpack.h>
+#include <msgpack/mmap_reader.h>
+#include <errno.h>
+#include <stdio.h>
+#include <string>
+
+#if !defined(_WIN32)
+#include <unistd.h>
+#endif
+
+#if defined(__GNUC__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wconversion"
+#endif //defined(__GNUC__)
+
+#include <gtest/gtest.h>
+
+#if defined(__GNUC__)
+#pragma GCC diagnostic pop
+#endif //defined(__GNUC__)
+
+#if !defined(_WIN32)
+
+// [i, bin of 100 bytes] records, the last one cut after cut bytes
+static std::string write_records(int records, size_t cut)
+{
+    char path[] = "/tmp/msgpack_mmap_reader_XXXXXX";
+    int fd = mkstemp(path);
+    EXPECT_LE(0, fd);
+    msgpack_sbuffer sbuf;
+    msgpack_sbuffer_init(&sbuf);
+    msgpack_packer pk;
+    msgpack_packer_init(&pk, &sbuf, msgpack_sbuffer_write);
+    std::string bin(100, 'b');
+    for (int i = 0; i < records; ++i) {
+        msgpack_pack_array(&pk, 2);
+        msgpack_pack_int(&pk, i);
+        bin[99] = (char)i;
+        msgpack_pack_bin_with_body(&pk, bin.data(), bin.size());
+    }
+    size_t size = cut != 0 ? sbuf.size - cut : sbuf.size;
+    EXPECT_EQ((ssize_t)size, write(fd, sbuf.data, size));
+    close(fd);
+    msgpack_sbuffer_destroy(&sbuf);
+    return path;
+}
+
+TEST(mmap_reader, walk)
+{
+    std::string path = write_records(20000, 0);
+    msgpack_mmap_reader reader;
+    ASSERT_TRUE(msgpack_mmap_reader_open(&reader, path.c_str(), 64 * 1024));
+
+    msgpack_unpacked result;
+    msgpack_unpacked_init(&result);
+    int got = 0;
+    while (msgpack_mmap_reader_next(&reader, &result) == MSGPACK_UNPACK_SUCCESS) {
+        ASSERT_EQ(MSGPACK_OBJECT_ARRAY, result.data.type);
+        EXPECT_EQ((uint64_t)got, result.data.via.array.ptr[0].via.u64);
+        const char* p = result.data.via.array.ptr[1].via.bin.ptr;
+        EXPECT_TRUE(p > reader.data && p < reader.data + reader.size);
+        EXPECT_EQ((char)got, p[99]);
+        ++got;
+    }
+    EXPECT_EQ(20000, got);
+    EXPECT_EQ(reader.size, reader.off);
+    EXPECT_EQ(reader.size, reader.advised);
+    EXPECT_LT(0u, reader.dropped);
+    EXPECT_GE(reader.off - 64 * 1024, reader.dropped);
+
+    msgpack_unpacked_destroy(&result);
+    msgpack_mmap_reader_close(&reader);
+    unlink(path.c_str());
+}
+
+TEST(mmap_reader, unaligned_window)
+{
+    std::string path = write_records(20000, 0);
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    msgpack_mmap_reader reader;
+    ASSERT_TRUE(msgpack_mmap_reader_open(&reader, path.c_str(), 100000));
+    EXPECT_EQ(0u, reader.window % page);
+    EXPECT_LE(100000u, reader.window);
+
+    msgpack_unpacked result;
+    msgpack_unpacked_init(&result);
+    int got = 0;
+    while (msgpack_mmap_reader_next(&reader, &result) == MSGPACK_UNPACK_SUCCESS) {
+        ASSERT_TRUE(reader.advised == reader.size || reader.advised % page == 0);
+        ASSERT_EQ(0u, reader.dropped % page);
+        ++got;
+    }
+    EXPECT_EQ(20000, got);
+    EXPECT_EQ(reader.size, reader.advised);
+    EXPECT_LT(0u, reader.dropped);
+
+    msgpack_unpacked_destroy(&result);
+    msgpack_mmap_reader_close(&reader);
+    unlink(path.c_str());
+}
+
+TEST(mmap_reader, truncated)
+{
+    std::string path = write_records(10, 30);
+    FILE* fp = fopen(path.c_str(), "rb");
+    ASSERT_TRUE(fp != NULL);
+    msgpack_mmap_reader reader;
+    ASSERT_TRUE(msgpack_mmap_reader_init_fd(&reader, fileno(fp), 0));
+    fclose(fp);
+
+    msgpack_unpacked result;
+    msgpack_unpacked_init(&result);
+    for (int i = 0; i < 9; ++i) {
+        ASSERT_EQ(MSGPACK_UNPACK_SUCCESS, msgpack_mmap_reader_next(&reader, &result));
+    }
+    size_t off = reader.off;
+    EXPECT_EQ(MSGPACK_UNPACK_CONTINUE, msgpack_mmap_reader_next(&reader, &result));
+    EXPECT_EQ(off, reader.off);
+    EXPECT_LT(reader.off, reader.size);
+    msgpack_mmap_reader_close(&reader);
+    unlink(path.c_str());
+
+    // empty
+    path = write_records(0, 0);
+    ASSERT_TRUE(msgpack_mmap_reader_open(&reader, path.c_str(), 0));
+    EXPECT_EQ(0u, reader.size);
+    EXPECT_EQ(MSGPACK_UNPACK_CONTINUE, msgpack_mmap_reader_next(&reader, &result));
+    msgpack_mmap_reader_close(&reader);
+    unlink(path.c_str());
+
+    EXPECT_FALSE(msgpack_mmap_reader_open(&reader, path.c_str(), 0));
+    EXPECT_EQ(ENOENT, errno);
+    msgpack_mmap_reader_close(&reader);
+    EXPECT_EQ(-1, reader.fd);
+    EXPECT_EQ(NULL, reader.data);
+    msgpack_unpacked_destroy(&result);
+}
+
+#endif // !defined(_WIN32)
@@ -1570,6 +1570,145 @@ TEST(MSGPACKC, vref_buffer_overflow)
     EXPECT_EQ(-1, msgpack_vrefbuffer_migrate(&vbuf, &to));
 }
 
+TEST(MSGPACKC, object_map_find) {
+  msgpack_sbuffer sbuf;
+  msgpack_sbuffer_init(&sbuf);
+  msgpack_packer pk;
+  msgpack_packer_init(&pk, &sbuf, msgpack_sbuffer_write);
+  msgpack_pack_map(&pk, 202);
+  for (int i = 0; i < 200; ++i) {
+    char key[16];
+    int len = snprintf(key, sizeof(key), "key%d", i);
+    msgpack_pack_str_with_body(&pk, key, len);
+    msgpack_pack_int(&pk, i);
+  }
+  // not indexed, and a duplicate whose first pair wins
+  msgpack_pack_int(&pk, 1);
+  msgpack_pack_int(&pk, -1);
+  msgpack_pack_str_with_body(&pk, "key7", 4);
+  msgpack_pack_int(&pk, -7);
+
+  msgpack_zone z;
+  msgpack_zone_init(&z, 2048);
+  msgpack_object obj;
+  EXPECT_EQ(MSGPACK_UNPACK_SUCCESS,
+            msgpack_unpack(sbuf.data, sbuf.size, NULL, &z, &obj));
+  const msgpack_object_map* map = &obj.via.map;
+
+  msgpack_object_map_index* index = msgpack_object_map_index_build(&z, map);
+  ASSERT_TRUE(index != NULL);
+  for (int i = 0; i < 200; ++i) {
+    char key[16];
+    int len = snprintf(key, sizeof(key), "key%d", i);
+    const msgpack_object* v = msgpack_object_map_find(map, index, key, len);
+    ASSERT_TRUE(v != NULL);
+    EXPECT_EQ((uint64_t)i, v->via.u64);
+    EXPECT_EQ(v, msgpack_object_map_find_str(map, key, len));
+    EXPECT_EQ(v, msgpack_object_map_find(map, NULL, key, len));
+  }
+  EXPECT_TRUE(msgpack_object_map_find(map, index, "key200", 6) == NULL);
+  EXPECT_TRUE(msgpack_object_map_find(map, index, "", 0) == NULL);
+  EXPECT_TRUE(msgpack_object_map_find_str(map, "key", 3) == NULL);
+
+  msgpack_object_map empty = { 0, NULL };
+  index = msgpack_object_map_index_build(&z, &empty);
+  ASSERT_TRUE(index != NULL);
+  EXPECT_TRUE(msgpack_object_map_find(&empty, index, "a", 1) == NULL);
+
+  msgpack_zone_destroy(&z);
+  msgpack_sbuffer_destroy(&sbuf);
+}
+
+static void count_finalizer(void* data)
+{
+    ++*(int*)data;
+}
+
+TEST(MSGPACKC, zone_rollback) {
+    msgpack_sbuffer sbuf;
+    msgpack_sbuffer_init(&sbuf);
+    msgpack_packer pk;
+    msgpack_packer_init(&pk, &sbuf, msgpack_sbuffer_write);
+    msgpack_pack_array(&pk, 2);
+    msgpack_pack_str_with_body(&pk, "kept", 4);
+    msgpack_pack_int(&pk, 1);
+    size_t first = sbuf.size;
+    msgpack_pack_array(&pk, 100);
+    for (int i = 0; i < 100; ++i) {
+        msgpack_pack_int(&pk, i);
+    }
+
+    msgpack_zone zone;
+    ASSERT_TRUE(msgpack_zone_init(&zone, 64));
+    msgpack_object kept;
+    EXPECT_EQ(MSGPACK_UNPACK_SUCCESS, msgpack_unpack(sbuf.data, first, NULL, &zone, &kept));
+    int calls = 0;
+    EXPECT_TRUE(msgpack_zone_push_finalizer(&zone, count_finalizer, &calls));
+
+    // a discarded decode spanning new chunks and finalizers
+    msgpack_zone_marker mark = msgpack_zone_mark(&zone);
+    msgpack_object discarded;
+    EXPECT_EQ(MSGPACK_UNPACK_SUCCESS,
+              msgpack_unpack(sbuf.data + first, sbuf.size - first, NULL, &zone, &discarded));
+    EXPECT_NE(mark.head, zone.chunk_list.head);
+    for (int i = 0; i < 20; ++i) {
+        EXPECT_TRUE(msgpack_zone_push_finalizer(&zone, count_finalizer, &calls));
+    }
+    msgpack_zone_rollback(&zone, &mark);
+    EXPECT_EQ(20, calls);
+    EXPECT_EQ(mark.head, zone.chunk_list.head);
+    EXPECT_EQ(mark.ptr, zone.chunk_list.ptr);
+    EXPECT_EQ(mark.free, zone.chunk_list.free);
+
+    // a rollback to the current state changes nothing
+    mark = msgpack_zone_mark(&zone);
+    msgpack_zone_rollback(&zone, &mark);
+    EXPECT_EQ(20, calls);
+
+    EXPECT_EQ(2u, kept.via.array.size);
+    EXPECT_EQ(0, memcmp("kept", kept.via.array.ptr[0].via.str.ptr, 4));
+    msgpack_zone_destroy(&zone);
+    EXPECT_EQ(21, calls);
+    msgpack_sbuffer_destroy(&sbuf);
+}
+
+TEST(MSGPACKC, zone_mmap_provider) {
+    msgpack_zone_chunk_provider provider;
+    if (!msgpack_zone_mmap_provider_init(&provider, 1024 * 1024, true)) {
+        return; // no mmap
+    }
+
+    msgpack_zone zone;
+    ASSERT_TRUE(msgpack_zone_init_with_provider(&zone, 4096, &provider));
+    char* first = zone.chunk_list.ptr;
+    for (int i = 0; i < 100; ++i) {
+        char* p = (char*)msgpack_zone_malloc(&zone, 1000);
+        ASSERT_TRUE(p != NULL);
+        memset(p, i, 1000);
+    }
+    // larger than the region: from malloc
+    char* big = (char*)msgpack_zone_malloc(&zone, 2 * 1024 * 1024);
+    ASSERT_TRUE(big != NULL);
+    memset(big, 1, 2 * 1024 * 1024);
+    EXPECT_TRUE(msgpack_zone_malloc(&zone, 1000) != NULL);
+
+    // chunks freed by a rollback are handed out again
+    msgpack_zone_marker mark = msgpack_zone_mark(&zone);
+    char* p = (char*)msgpack_zone_malloc(&zone, 4000);
+    msgpack_zone_rollback(&zone, &mark);
+    EXPECT_EQ(p, (char*)msgpack_zone_malloc(&zone, 4000));
+
+    // the region starts over once every chunk is freed
+    msgpack_zone_destroy(&zone);
+    msgpack_zone* z = msgpack_zone_new_with_provider(4096, &provider);
+    ASSERT_TRUE(z != NULL);
+    EXPECT_EQ(first, z->chunk_list.ptr);
+    EXPECT_EQ(0, *(char*)msgpack_zone_malloc(z, 1));
+    msgpack_zone_free(z);
+
+    msgpack_zone_mmap_provider_destroy(&provider);
+}
+
 TEST(MSGPACKC, object_print_buffer_overflow) {
   msgpack_object obj;
   obj.type = MSGPACK_OBJECT_NIL;
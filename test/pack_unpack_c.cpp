@@ -101,3 +101,238 @@ TEST(pack, insufficient)
     msgpack_sbuffer_free(sbuf);
     msgpack_packer_free(pk);
 }
+
+
+TEST(unpack, skip)
+{
+    msgpack_sbuffer* sbuf = msgpack_sbuffer_new();
+    msgpack_packer* pk = msgpack_packer_new(sbuf, msgpack_sbuffer_write);
+    char body[70000];
+    memset(body, 'x', sizeof(body));
+
+    EXPECT_EQ(0, msgpack_pack_int(pk, -1));
+    EXPECT_EQ(0, msgpack_pack_map(pk, 2));
+    EXPECT_EQ(0, msgpack_pack_str_with_body(pk, "list", 4));
+    EXPECT_EQ(0, msgpack_pack_array(pk, 20));
+    for (int i = 0; i < 20; ++i) {
+        EXPECT_EQ(0, msgpack_pack_int64(pk, (int64_t)i << (i * 3)));
+    }
+    EXPECT_EQ(0, msgpack_pack_str_with_body(pk, "nested", 6));
+    EXPECT_EQ(0, msgpack_pack_map(pk, 2));
+    EXPECT_EQ(0, msgpack_pack_double(pk, 1.5));
+    EXPECT_EQ(0, msgpack_pack_ext_with_body(pk, body, 300, 1));
+    EXPECT_EQ(0, msgpack_pack_nil(pk));
+    EXPECT_EQ(0, msgpack_pack_array(pk, 0));
+    EXPECT_EQ(0, msgpack_pack_bin_with_body(pk, body, sizeof(body)));
+    EXPECT_EQ(0, msgpack_pack_str_with_body(pk, body, 200));
+    EXPECT_EQ(0, msgpack_pack_ext_with_body(pk, body, 4, 2));
+    EXPECT_EQ(0, msgpack_pack_true(pk));
+
+    // same extents as msgpack_unpack_next
+    msgpack_unpacked msg;
+    msgpack_unpacked_init(&msg);
+    size_t off = 0;
+    size_t uoff = 0;
+    int count = 0;
+    while (msgpack_unpack_next(&msg, sbuf->data, sbuf->size, &uoff) == MSGPACK_UNPACK_SUCCESS) {
+        size_t size;
+        EXPECT_EQ(MSGPACK_UNPACK_SUCCESS, msgpack_measure(sbuf->data + off, sbuf->size - off, &size));
+        EXPECT_EQ(uoff - off, size);
+        EXPECT_EQ(MSGPACK_UNPACK_SUCCESS, msgpack_skip(sbuf->data, sbuf->size, &off));
+        EXPECT_EQ(uoff, off);
+        ++count;
+    }
+    EXPECT_EQ(6, count);
+    EXPECT_EQ(MSGPACK_UNPACK_CONTINUE, msgpack_skip(sbuf->data, sbuf->size, &off));
+    msgpack_unpacked_destroy(&msg);
+
+    // every truncation of the map asks for more
+    size_t full;
+    EXPECT_EQ(MSGPACK_UNPACK_SUCCESS, msgpack_measure(sbuf->data + 1, sbuf->size - 1, &full));
+    for (size_t len = 0; len < full; ++len) {
+        size_t need;
+        off = 1;
+        EXPECT_EQ(MSGPACK_UNPACK_CONTINUE, msgpack_skip(sbuf->data, 1 + len, &off));
+        EXPECT_EQ(1u, off);
+        EXPECT_EQ(MSGPACK_UNPACK_CONTINUE, msgpack_measure(sbuf->data + 1, len, &need));
+        EXPECT_GT(need, len);
+        EXPECT_LE(need, full);
+    }
+
+    off = 0;
+    EXPECT_EQ(MSGPACK_UNPACK_PARSE_ERROR, msgpack_skip("\x92\x01\xc1", 3, &off));
+    EXPECT_EQ(0u, off);
+
+    msgpack_sbuffer_free(sbuf);
+    msgpack_packer_free(pk);
+}
+
+TEST(unpack, contiguous)
+{
+    msgpack_sbuffer* sbuf = msgpack_sbuffer_new();
+    msgpack_packer* pk = msgpack_packer_new(sbuf, msgpack_sbuffer_write);
+
+    /* {"a": [1, [], {"b": "c"}], "d": {}, "e": [[2, 3]]} */
+    msgpack_pack_map(pk, 3);
+    msgpack_pack_str_with_body(pk, "a", 1);
+    msgpack_pack_array(pk, 3);
+    msgpack_pack_int(pk, 1);
+    msgpack_pack_array(pk, 0);
+    msgpack_pack_map(pk, 1);
+    msgpack_pack_str_with_body(pk, "b", 1);
+    msgpack_pack_str_with_body(pk, "c", 1);
+    msgpack_pack_str_with_body(pk, "d", 1);
+    msgpack_pack_map(pk, 0);
+    msgpack_pack_str_with_body(pk, "e", 1);
+    msgpack_pack_array(pk, 1);
+    msgpack_pack_array(pk, 2);
+    msgpack_pack_int(pk, 2);
+    msgpack_pack_int(pk, 3);
+
+    msgpack_zone z;
+    msgpack_zone_init(&z, 2048);
+    msgpack_object expected;
+    EXPECT_EQ(MSGPACK_UNPACK_SUCCESS, msgpack_unpack(sbuf->data, sbuf->size, NULL, &z, &expected));
+
+    /* 3 pairs, 3 elements, 1 pair, 1 element, 2 elements */
+    size_t size;
+    EXPECT_EQ(MSGPACK_UNPACK_SUCCESS,
+              msgpack_unpack_contiguous_size(sbuf->data, sbuf->size, 0, &size));
+    EXPECT_EQ(14 * sizeof(msgpack_object), size);
+
+    msgpack_object* block = (msgpack_object*)malloc(size);
+    msgpack_object obj;
+    size_t off = 0;
+    EXPECT_EQ(MSGPACK_UNPACK_NOMEM_ERROR,
+              msgpack_unpack_contiguous(sbuf->data, sbuf->size, &off, block, size - 1, &obj));
+    EXPECT_EQ(0u, off);
+    EXPECT_EQ(MSGPACK_UNPACK_SUCCESS,
+              msgpack_unpack_contiguous(sbuf->data, sbuf->size, &off, block, size, &obj));
+    EXPECT_EQ(sbuf->size, off);
+    EXPECT_TRUE(msgpack_object_equal(expected, obj));
+
+    /* preorder: the root pairs, then the elements of "a", then its map */
+    EXPECT_EQ((msgpack_object_kv*)block, obj.via.map.ptr);
+    EXPECT_EQ(block + 6, obj.via.map.ptr[0].val.via.array.ptr);
+    EXPECT_EQ((msgpack_object_kv*)(block + 9), obj.via.map.ptr[0].val.via.array.ptr[2].via.map.ptr);
+    EXPECT_EQ(block + 11, obj.via.map.ptr[2].val.via.array.ptr);
+    free(block);
+
+    off = 0;
+    EXPECT_EQ(MSGPACK_UNPACK_SUCCESS,
+              msgpack_unpack_contiguous_zone(sbuf->data, sbuf->size, &off, &z, &obj));
+    EXPECT_TRUE(msgpack_object_equal(expected, obj));
+
+    EXPECT_EQ(MSGPACK_UNPACK_CONTINUE,
+              msgpack_unpack_contiguous_zone(sbuf->data, sbuf->size - 1, NULL, &z, &obj));
+
+    /* a scalar needs no block */
+    msgpack_sbuffer_clear(sbuf);
+    msgpack_pack_int(pk, 5);
+    msgpack_pack_nil(pk);
+    EXPECT_EQ(MSGPACK_UNPACK_SUCCESS,
+              msgpack_unpack_contiguous_size(sbuf->data, sbuf->size, 0, &size));
+    EXPECT_EQ(0u, size);
+    off = 0;
+    EXPECT_EQ(MSGPACK_UNPACK_EXTRA_BYTES,
+              msgpack_unpack_contiguous(sbuf->data, sbuf->size, &off, NULL, 0, &obj));
+    EXPECT_EQ(1u, off);
+    EXPECT_EQ(5u, obj.via.u64);
+
+    msgpack_zone_destroy(&z);
+    msgpack_packer_free(pk);
+    msgpack_sbuffer_free(sbuf);
+}
+
+TEST(sprintf, vrefbuffer)
+{
+    const size_t blob_size = 64 * 1024;
+    char* blob = (char*)malloc(blob_size);
+    for (size_t i = 0; i < blob_size; i++) {
+        blob[i] = (char)i;
+    }
+    const char small[] = "0123456789";
+
+    msgpack_sbuffer sbuf;
+    msgpack_sbuffer_init(&sbuf);
+    msgpack_packer pk;
+    msgpack_packer_init(&pk, &sbuf, msgpack_sbuffer_write);
+    msgpack_sprintf(&pk, "{id: %i, blobs: [%&p, %p, [%&s]], name: %s}",
+        7, blob, (uint32_t)blob_size, small, (uint32_t)sizeof(small), "x", "name");
+
+    msgpack_vrefbuffer* vbuf = msgpack_vrefbuffer_new(0, 0);
+    EXPECT_EQ(0, msgpack_sprintf_vrefbuffer(vbuf, "{id: %i, blobs: [%&p, %p, [%&s]], name: %s}",
+        7, blob, (uint32_t)blob_size, small, (uint32_t)sizeof(small), "x", "name"));
+
+    const msgpack_iovec* iov = msgpack_vrefbuffer_vec(vbuf);
+    size_t iovcnt = msgpack_vrefbuffer_veclen(vbuf);
+    std::string out;
+    bool blob_referenced = false;
+    for (size_t i = 0; i < iovcnt; i++) {
+        if (iov[i].iov_base == blob) {
+            EXPECT_EQ(blob_size, iov[i].iov_len);
+            blob_referenced = true;
+        }
+        out.append((const char*)iov[i].iov_base, iov[i].iov_len);
+    }
+    EXPECT_TRUE(blob_referenced);
+    EXPECT_EQ(std::string(sbuf.data, sbuf.size), out);
+
+    msgpack_zone z;
+    msgpack_zone_init(&z, 2048);
+    msgpack_object obj;
+    EXPECT_EQ(MSGPACK_UNPACK_SUCCESS, msgpack_unpack(out.data(), out.size(), NULL, &z, &obj));
+    EXPECT_EQ(MSGPACK_OBJECT_MAP, obj.type);
+    EXPECT_EQ(3u, obj.via.map.size);
+    msgpack_object blobs = obj.via.map.ptr[1].val;
+    EXPECT_EQ(MSGPACK_OBJECT_ARRAY, blobs.type);
+    EXPECT_EQ(3u, blobs.via.array.size);
+    EXPECT_EQ(blob_size, blobs.via.array.ptr[0].via.bin.size);
+    EXPECT_EQ(0, memcmp(blob, blobs.via.array.ptr[0].via.bin.ptr, blob_size));
+    EXPECT_EQ(std::string("x"), std::string(blobs.via.array.ptr[2].via.array.ptr[0].via.str.ptr, 1));
+    msgpack_zone_destroy(&z);
+
+    msgpack_vrefbuffer_free(vbuf);
+    msgpack_sbuffer_destroy(&sbuf);
+    free(blob);
+}
+
+TEST(sprintf, half)
+{
+    msgpack_sbuffer sbuf;
+    msgpack_sbuffer_init(&sbuf);
+    msgpack_packer pk;
+    msgpack_packer_init(&pk, &sbuf, msgpack_sbuffer_write);
+    // bfloat16 1.0, binary16 -2.0, -3, 65535, then float 0.5
+    msgpack_sprintf(&pk, "[%hf, %he, %hi, %hu, %f]",
+        (uint16_t)0x3f80, (uint16_t)0xc000, (int16_t)-3, (uint16_t)65535, 0.5f);
+
+    msgpack_zone z;
+    msgpack_zone_init(&z, 2048);
+    msgpack_object obj;
+    ASSERT_EQ(MSGPACK_UNPACK_SUCCESS, msgpack_unpack(sbuf.data, sbuf.size, NULL, &z, &obj));
+    ASSERT_EQ(MSGPACK_OBJECT_ARRAY, obj.type);
+    ASSERT_EQ(5u, obj.via.array.size);
+    msgpack_object* e = obj.via.array.ptr;
+    EXPECT_EQ(MSGPACK_OBJECT_FLOAT32, e[0].type);
+    EXPECT_EQ(1.0, e[0].via.f64);
+    EXPECT_EQ(MSGPACK_OBJECT_FLOAT32, e[1].type);
+    EXPECT_EQ(-2.0, e[1].via.f64);
+    EXPECT_EQ(MSGPACK_OBJECT_NEGATIVE_INTEGER, e[2].type);
+    EXPECT_EQ(-3, e[2].via.i64);
+    EXPECT_EQ(MSGPACK_OBJECT_POSITIVE_INTEGER, e[3].type);
+    EXPECT_EQ(65535u, e[3].via.u64);
+    EXPECT_EQ(MSGPACK_OBJECT_FLOAT32, e[4].type);
+    EXPECT_EQ(0.5, e[4].via.f64);
+
+    // h applies to one specifier only
+    msgpack_sbuffer_clear(&sbuf);
+    msgpack_sprintf(&pk, "[%hf, %f]", (uint16_t)0xbf80, 0.25f);
+    ASSERT_EQ(MSGPACK_UNPACK_SUCCESS, msgpack_unpack(sbuf.data, sbuf.size, NULL, &z, &obj));
+    ASSERT_EQ(2u, obj.via.array.size);
+    EXPECT_EQ(-1.0, obj.via.array.ptr[0].via.f64);
+    EXPECT_EQ(0.25, obj.via.array.ptr[1].via.f64);
+
+    msgpack_zone_destroy(&z);
+    msgpack_sbuffer_destroy(&sbuf);
+}
@@ -0,0 +1,242 @@
+#include <msgpack.h>
+#include <msgpack/projection.h>
+
+#if defined(__GNUC__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wconversion"
+#endif //defined(__GNUC__)
+
+#include <gtest/gtest.h>
+
+#if defined(__GNUC__)
+#pragma GCC diagnostic pop
+#endif //defined(__GNUC__)
+
+// {"id": 7, "user": {"name": "a", "age": 30}, "events": [{"ts": 0, "v": "e0"}, ...]}
+static void pack_document(msgpack_sbuffer* sbuf, int events)
+{
+    msgpack_packer pk;
+    msgpack_packer_init(&pk, sbuf, msgpack_sbuffer_write);
+
+    msgpack_pack_map(&pk, 3);
+    msgpack_pack_str_with_body(&pk, "id", 2);
+    msgpack_pack_int(&pk, 7);
+    msgpack_pack_str_with_body(&pk, "user", 4);
+    msgpack_pack_map(&pk, 2);
+    msgpack_pack_str_with_body(&pk, "name", 4);
+    msgpack_pack_str_with_body(&pk, "a", 1);
+    msgpack_pack_str_with_body(&pk, "age", 3);
+    msgpack_pack_int(&pk, 30);
+    msgpack_pack_str_with_body(&pk, "events", 6);
+    msgpack_pack_array(&pk, events);
+    for (int i = 0; i < events; ++i) {
+        char v[16];
+        int len = snprintf(v, sizeof(v), "e%d", i);
+        msgpack_pack_map(&pk, 2);
+        msgpack_pack_str_with_body(&pk, "ts", 2);
+        msgpack_pack_int(&pk, i);
+        msgpack_pack_str_with_body(&pk, "v", 1);
+        msgpack_pack_str_with_body(&pk, v, len);
+    }
+}
+
+static const msgpack_object* find(const msgpack_object* map, const char* key)
+{
+    if (map->type != MSGPACK_OBJECT_MAP) return NULL;
+    for (uint32_t i = 0; i < map->via.map.size; ++i) {
+        const msgpack_object* k = &map->via.map.ptr[i].key;
+        if (k->type == MSGPACK_OBJECT_STR && k->via.str.size == strlen(key) &&
+                memcmp(k->via.str.ptr, key, k->via.str.size) == 0) {
+            return &map->via.map.ptr[i].val;
+        }
+    }
+    return NULL;
+}
+
+TEST(projection, keys)
+{
+    msgpack_sbuffer sbuf;
+    msgpack_sbuffer_init(&sbuf);
+    pack_document(&sbuf, 3);
+
+    const char* paths[] = { "id", "user.name", "missing" };
+    msgpack_projection* proj = msgpack_projection_new(paths, 3);
+    ASSERT_TRUE(proj != NULL);
+
+    msgpack_zone zone;
+    msgpack_zone_init(&zone, 2048);
+    msgpack_object obj;
+    size_t off = 0;
+    EXPECT_EQ(MSGPACK_UNPACK_SUCCESS,
+              msgpack_unpack_projected(sbuf.data, sbuf.size, &off, proj, &zone, &obj));
+    EXPECT_EQ(sbuf.size, off);
+
+    ASSERT_EQ(MSGPACK_OBJECT_MAP, obj.type);
+    EXPECT_EQ(2u, obj.via.map.size);
+    const msgpack_object* id = find(&obj, "id");
+    ASSERT_TRUE(id != NULL);
+    EXPECT_EQ(7u, id->via.u64);
+    const msgpack_object* user = find(&obj, "user");
+    ASSERT_TRUE(user != NULL);
+    ASSERT_EQ(MSGPACK_OBJECT_MAP, user->type);
+    EXPECT_EQ(1u, user->via.map.size);
+    const msgpack_object* name = find(user, "name");
+    ASSERT_TRUE(name != NULL);
+    EXPECT_EQ(MSGPACK_OBJECT_STR, name->type);
+    EXPECT_EQ(0, memcmp("a", name->via.str.ptr, 1));
+    EXPECT_TRUE(find(&obj, "events") == NULL);
+
+    msgpack_zone_destroy(&zone);
+    msgpack_projection_free(proj);
+    msgpack_sbuffer_destroy(&sbuf);
+}
+
+TEST(projection, arrays)
+{
+    msgpack_sbuffer sbuf;
+    msgpack_sbuffer_init(&sbuf);
+    pack_document(&sbuf, 4);
+
+    msgpack_zone zone;
+    msgpack_zone_init(&zone, 2048);
+    msgpack_object obj;
+
+    const char* any[] = { "events[*].ts" };
+    msgpack_projection* proj = msgpack_projection_new(any, 1);
+    ASSERT_TRUE(proj != NULL);
+    EXPECT_EQ(MSGPACK_UNPACK_SUCCESS,
+              msgpack_unpack_projected(sbuf.data, sbuf.size, NULL, proj, &zone, &obj));
+    const msgpack_object* events = find(&obj, "events");
+    ASSERT_TRUE(events != NULL);
+    ASSERT_EQ(MSGPACK_OBJECT_ARRAY, events->type);
+    ASSERT_EQ(4u, events->via.array.size);
+    for (uint32_t i = 0; i < 4; ++i) {
+        const msgpack_object* e = &events->via.array.ptr[i];
+        ASSERT_EQ(1u, e->via.map.size);
+        EXPECT_EQ(i, find(e, "ts")->via.u64);
+    }
+    msgpack_projection_free(proj);
+
+    const char* index[] = { "events[2].v", "events[0]", "events[9]" };
+    proj = msgpack_projection_new(index, 3);
+    ASSERT_TRUE(proj != NULL);
+    EXPECT_EQ(MSGPACK_UNPACK_SUCCESS,
+              msgpack_unpack_projected(sbuf.data, sbuf.size, NULL, proj, &zone, &obj));
+    events = find(&obj, "events");
+    ASSERT_TRUE(events != NULL);
+    ASSERT_EQ(2u, events->via.array.size);
+    EXPECT_EQ(2u, events->via.array.ptr[0].via.map.size);
+    const msgpack_object* v = find(&events->via.array.ptr[1], "v");
+    ASSERT_TRUE(v != NULL);
+    EXPECT_EQ(0, memcmp("e2", v->via.str.ptr, 2));
+    msgpack_projection_free(proj);
+
+    // [*] keeps positions, elements without a match become nil
+    const char* sparse[] = { "events[*].missing", "events[1].ts" };
+    proj = msgpack_projection_new(sparse, 2);
+    ASSERT_TRUE(proj != NULL);
+    EXPECT_EQ(MSGPACK_UNPACK_SUCCESS,
+              msgpack_unpack_projected(sbuf.data, sbuf.size, NULL, proj, &zone, &obj));
+    events = find(&obj, "events");
+    ASSERT_TRUE(events != NULL);
+    ASSERT_EQ(4u, events->via.array.size);
+    EXPECT_EQ(MSGPACK_OBJECT_NIL, events->via.array.ptr[0].type);
+    EXPECT_EQ(1u, find(&events->via.array.ptr[1], "ts")->via.u64);
+    EXPECT_EQ(MSGPACK_OBJECT_NIL, events->via.array.ptr[3].type);
+    msgpack_projection_free(proj);
+
+    // [*] and [N] on the same element select the union
+    const char* mixed[] = { "events[*].ts", "events[0].v", "events[2]" };
+    proj = msgpack_projection_new(mixed, 3);
+    ASSERT_TRUE(proj != NULL);
+    EXPECT_EQ(MSGPACK_UNPACK_SUCCESS,
+              msgpack_unpack_projected(sbuf.data, sbuf.size, NULL, proj, &zone, &obj));
+    events = find(&obj, "events");
+    ASSERT_TRUE(events != NULL);
+    ASSERT_EQ(4u, events->via.array.size);
+    for (uint32_t i = 0; i < 4; ++i) {
+        const msgpack_object* e = &events->via.array.ptr[i];
+        ASSERT_EQ(MSGPACK_OBJECT_MAP, e->type);
+        EXPECT_EQ(i == 0 || i == 2 ? 2u : 1u, e->via.map.size);
+        EXPECT_EQ(i, find(e, "ts")->via.u64);
+    }
+    v = find(&events->via.array.ptr[0], "v");
+    ASSERT_TRUE(v != NULL);
+    EXPECT_EQ(0, memcmp("e0", v->via.str.ptr, 2));
+    msgpack_projection_free(proj);
+
+    msgpack_zone_destroy(&zone);
+    msgpack_sbuffer_destroy(&sbuf);
+}
+
+TEST(projection, whole_and_nothing)
+{
+    msgpack_sbuffer sbuf;
+    msgpack_sbuffer_init(&sbuf);
+    pack_document(&sbuf, 2);
+
+    msgpack_zone zone;
+    msgpack_zone_init(&zone, 2048);
+    msgpack_object obj;
+    msgpack_object expected;
+
+    const char* whole[] = { "" };
+    msgpack_projection* proj = msgpack_projection_new(whole, 1);
+    ASSERT_TRUE(proj != NULL);
+    EXPECT_EQ(MSGPACK_UNPACK_SUCCESS,
+              msgpack_unpack_projected(sbuf.data, sbuf.size, NULL, proj, &zone, &obj));
+    EXPECT_EQ(MSGPACK_UNPACK_SUCCESS,
+              msgpack_unpack(sbuf.data, sbuf.size, NULL, &zone, &expected));
+    EXPECT_TRUE(msgpack_object_equal(expected, obj));
+    msgpack_projection_free(proj);
+
+    const char* none[] = { "id.x", "user[0]" };
+    proj = msgpack_projection_new(none, 2);
+    ASSERT_TRUE(proj != NULL);
+    EXPECT_EQ(MSGPACK_UNPACK_SUCCESS,
+              msgpack_unpack_projected(sbuf.data, sbuf.size, NULL, proj, &zone, &obj));
+    EXPECT_EQ(MSGPACK_OBJECT_NIL, obj.type);
+    msgpack_projection_free(proj);
+
+    msgpack_zone_destroy(&zone);
+    msgpack_sbuffer_destroy(&sbuf);
+}
+
+TEST(projection, errors)
+{
+    const char* bad[] = { "a..b", ".a", "a.", "a[", "a[]", "a[x]", "a[1" };
+    for (size_t i = 0; i < sizeof(bad) / sizeof(bad[0]); ++i) {
+        EXPECT_TRUE(msgpack_projection_new(&bad[i], 1) == NULL) << bad[i];
+    }
+
+    msgpack_sbuffer sbuf;
+    msgpack_sbuffer_init(&sbuf);
+    pack_document(&sbuf, 2);
+    msgpack_sbuffer_write(&sbuf, "\xc0", 1);
+
+    const char* paths[] = { "id" };
+    msgpack_projection* proj = msgpack_projection_new(paths, 1);
+    msgpack_zone zone;
+    msgpack_zone_init(&zone, 2048);
+    msgpack_object obj;
+    size_t off = 0;
+
+    EXPECT_EQ(MSGPACK_UNPACK_CONTINUE,
+              msgpack_unpack_projected(sbuf.data, sbuf.size - 3, &off, proj, &zone, &obj));
+    EXPECT_EQ(0u, off);
+    EXPECT_EQ(MSGPACK_UNPACK_EXTRA_BYTES,
+              msgpack_unpack_projected(sbuf.data, sbuf.size, &off, proj, &zone, &obj));
+    EXPECT_EQ(sbuf.size - 1, off);
+    EXPECT_EQ(MSGPACK_UNPACK_SUCCESS,
+              msgpack_unpack_projected(sbuf.data, sbuf.size, &off, proj, &zone, &obj));
+    EXPECT_EQ(MSGPACK_OBJECT_NIL, obj.type);
+
+    const char parse_error[] = { (char)0x91, (char)0xc1 };
+    off = 0;
+    EXPECT_EQ(MSGPACK_UNPACK_PARSE_ERROR,
+              msgpack_unpack_projected(parse_error, sizeof(parse_error), &off, proj, &zone, &obj));
+
+    msgpack_zone_destroy(&zone);
+    msgpack_projection_free(proj);
+    msgpack_sbuffer_destroy(&sbuf);
+}
@@ -1,4 +1,6 @@
 #include <msgpack.h>
+#include <msgpack/zbuffer.h>
+#include <msgpack/zunpacker.h>
 
 #if defined(__GNUC__)
 #pragma GCC diagnostic push
@@ -12,6 +14,15 @@
 #endif //defined(__GNUC__)
 
 #include <stdio.h>
+#include <algorithm>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <unistd.h>
+#endif
 
 TEST(streaming, basic)
 {
@@ -192,3 +203,494 @@ TEST(streaming, basic_with_size)
     msgpack_unpacker_free(unp);
     msgpack_sbuffer_free(buffer);
 }
+
+TEST(streaming, zunpacker)
+{
+    msgpack_zbuffer zbuf;
+    ASSERT_TRUE(msgpack_zbuffer_init(&zbuf, Z_DEFAULT_COMPRESSION, MSGPACK_ZBUFFER_INIT_SIZE));
+    msgpack_packer pk;
+    msgpack_packer_init(&pk, &zbuf, msgpack_zbuffer_write);
+
+    // a body larger than the unpacker buffer spans many inflate outputs
+    char big[100000];
+    for (size_t i = 0; i < sizeof(big); ++i) {
+        big[i] = (char)(i % 251);
+    }
+    msgpack_sbuffer sbuf;
+    msgpack_sbuffer_init(&sbuf);
+    for (int i = 0; i < 1000; ++i) {
+        EXPECT_EQ(0, msgpack_pack_int(&pk, i));
+    }
+    EXPECT_EQ(0, msgpack_pack_bin_with_body(&pk, big, sizeof(big)));
+    EXPECT_TRUE(msgpack_zbuffer_flush(&zbuf) != NULL);
+    msgpack_sbuffer_write(&sbuf, msgpack_zbuffer_data(&zbuf), msgpack_zbuffer_size(&zbuf));
+
+    // followed by a second stream
+    EXPECT_TRUE(msgpack_zbuffer_reset(&zbuf));
+    EXPECT_EQ(0, msgpack_pack_str_with_body(&pk, "next", 4));
+    EXPECT_TRUE(msgpack_zbuffer_flush(&zbuf) != NULL);
+    msgpack_sbuffer_write(&sbuf, msgpack_zbuffer_data(&zbuf), msgpack_zbuffer_size(&zbuf));
+
+    msgpack_zunpacker* zunp = msgpack_zunpacker_new(1024);
+    ASSERT_TRUE(zunp != NULL);
+    msgpack_unpacked result;
+    msgpack_unpacked_init(&result);
+
+    int count = 0;
+    for (size_t off = 0; off < sbuf.size; off += 7) {
+        msgpack_zunpacker_feed(zunp, sbuf.data + off, sbuf.size - off < 7 ? sbuf.size - off : 7);
+        msgpack_unpack_return ret;
+        while ((ret = msgpack_zunpacker_next(zunp, &result)) == MSGPACK_UNPACK_SUCCESS) {
+            msgpack_object obj = result.data;
+            if (count < 1000) {
+                EXPECT_EQ(MSGPACK_OBJECT_POSITIVE_INTEGER, obj.type);
+                EXPECT_EQ((uint64_t)count, obj.via.u64);
+            } else if (count == 1000) {
+                EXPECT_EQ(MSGPACK_OBJECT_BIN, obj.type);
+                EXPECT_EQ(sizeof(big), obj.via.bin.size);
+                EXPECT_EQ(0, memcmp(big, obj.via.bin.ptr, sizeof(big)));
+            } else {
+                EXPECT_EQ(MSGPACK_OBJECT_STR, obj.type);
+                EXPECT_EQ(0, memcmp("next", obj.via.str.ptr, 4));
+            }
+            ++count;
+        }
+        EXPECT_EQ(MSGPACK_UNPACK_CONTINUE, ret);
+        EXPECT_EQ(0u, msgpack_zunpacker_pending(zunp));
+    }
+    EXPECT_EQ(1002, count);
+
+    // corrupted input
+    const char garbage[] = "not a zlib stream";
+    msgpack_zunpacker_feed(zunp, garbage, sizeof(garbage));
+    EXPECT_EQ(MSGPACK_UNPACK_PARSE_ERROR, msgpack_zunpacker_next(zunp, &result));
+
+    msgpack_unpacked_destroy(&result);
+    msgpack_zunpacker_free(zunp);
+    msgpack_sbuffer_destroy(&sbuf);
+    msgpack_zbuffer_destroy(&zbuf);
+}
+
+TEST(streaming, zone_pool)
+{
+    msgpack_sbuffer sbuf;
+    msgpack_sbuffer_init(&sbuf);
+    msgpack_packer pk;
+    msgpack_packer_init(&pk, &sbuf, msgpack_sbuffer_write);
+    for (int i = 0; i < 10; ++i) {
+        msgpack_pack_array(&pk, 2);
+        msgpack_pack_int(&pk, i);
+        msgpack_pack_str_with_body(&pk, "str", 3);
+    }
+
+    msgpack_zone_pool* pool = msgpack_zone_pool_new(MSGPACK_ZONE_CHUNK_SIZE, 2);
+    ASSERT_TRUE(pool != NULL);
+    msgpack_unpacker unp;
+    ASSERT_TRUE(msgpack_unpacker_init(&unp, 1024));
+    msgpack_unpacker_set_zone_pool(&unp, pool);
+    ASSERT_TRUE(msgpack_unpacker_reserve_buffer(&unp, sbuf.size));
+    memcpy(msgpack_unpacker_buffer(&unp), sbuf.data, sbuf.size);
+    msgpack_unpacker_buffer_consumed(&unp, sbuf.size);
+
+    // one result at a time: a single zone goes round
+    msgpack_unpacked result;
+    msgpack_unpacked_init(&result);
+    for (int i = 0; i < 5; ++i) {
+        ASSERT_EQ(MSGPACK_UNPACK_SUCCESS, msgpack_unpacker_next(&unp, &result));
+        EXPECT_EQ((uint64_t)i, result.data.via.array.ptr[0].via.u64);
+        EXPECT_EQ(pool, result.pool);
+    }
+    msgpack_unpacked_destroy(&result);
+
+    msgpack_zone_pool_stats stats;
+    msgpack_zone_pool_get_stats(pool, &stats);
+    EXPECT_EQ(1u, stats.misses);
+    EXPECT_EQ(4u, stats.hits);
+    EXPECT_EQ(5u, stats.returns);
+    EXPECT_EQ(1u, stats.cached);
+
+    // more results alive than the pool holds
+    msgpack_unpacked results[4];
+    for (int i = 0; i < 4; ++i) {
+        msgpack_unpacked_init(&results[i]);
+        ASSERT_EQ(MSGPACK_UNPACK_SUCCESS, msgpack_unpacker_next(&unp, &results[i]));
+    }
+    // a released zone leaves the pool
+    msgpack_zone* z = msgpack_unpacked_release_zone(&results[3]);
+    ASSERT_TRUE(z != NULL);
+    msgpack_zone_free(z);
+    for (int i = 0; i < 3; ++i) {
+        msgpack_unpacked_destroy(&results[i]);
+    }
+    msgpack_zone_pool_get_stats(pool, &stats);
+    EXPECT_EQ(4u, stats.misses);
+    EXPECT_EQ(2u, stats.cached);
+    EXPECT_EQ(2u, stats.max_cached);
+    EXPECT_EQ(1u, stats.frees);
+
+    msgpack_zone_pool_trim(pool, 1);
+    msgpack_zone_pool_get_stats(pool, &stats);
+    EXPECT_EQ(1u, stats.cached);
+
+    // the pool outlives its owner and the unpacker as long as a result holds it
+    ASSERT_EQ(MSGPACK_UNPACK_SUCCESS, msgpack_unpacker_next(&unp, &result));
+    msgpack_zone_pool_release(pool);
+    msgpack_unpacker_destroy(&unp);
+    EXPECT_EQ(9u, result.data.via.array.ptr[0].via.u64);
+    msgpack_unpacked_destroy(&result);
+
+    msgpack_sbuffer_destroy(&sbuf);
+}
+
+TEST(streaming, plain_refcount)
+{
+    msgpack_sbuffer sbuf;
+    msgpack_sbuffer_init(&sbuf);
+    msgpack_packer pk;
+    msgpack_packer_init(&pk, &sbuf, msgpack_sbuffer_write);
+    for (int i = 0; i < 100; ++i) {
+        msgpack_pack_array(&pk, 2);
+        msgpack_pack_int(&pk, i);
+        msgpack_pack_str_with_body(&pk, "referenced", 10);
+    }
+
+    msgpack_unpacker unp;
+    ASSERT_TRUE(msgpack_unpacker_init(&unp, 64));
+    msgpack_unpacker_set_atomic_refcount(&unp, false);
+
+    // results referencing every buffer the unpacker went through
+    std::vector<msgpack_unpacked> results(101);
+    size_t fed = 0;
+    int got = 0;
+    while (fed < sbuf.size) {
+        size_t n = std::min<size_t>(50, sbuf.size - fed);
+        ASSERT_TRUE(msgpack_unpacker_reserve_buffer(&unp, n));
+        memcpy(msgpack_unpacker_buffer(&unp), sbuf.data + fed, n);
+        msgpack_unpacker_buffer_consumed(&unp, n);
+        fed += n;
+        msgpack_unpacked_init(&results[got]);
+        while (msgpack_unpacker_next(&unp, &results[got]) == MSGPACK_UNPACK_SUCCESS) {
+            msgpack_unpacked_init(&results[++got]);
+        }
+    }
+    EXPECT_EQ(100, got);
+    msgpack_unpacker_destroy(&unp);
+    for (int i = 0; i < got; ++i) {
+        EXPECT_EQ((uint64_t)i, results[i].data.via.array.ptr[0].via.u64);
+        EXPECT_EQ(0, memcmp("referenced", results[i].data.via.array.ptr[1].via.str.ptr, 10));
+        msgpack_unpacked_destroy(&results[i]);
+    }
+    msgpack_unpacked_destroy(&results[got]);
+
+    msgpack_sbuffer_destroy(&sbuf);
+}
+
+TEST(streaming, ring)
+{
+    msgpack_sbuffer sbuf;
+    msgpack_sbuffer_init(&sbuf);
+    msgpack_packer pk;
+    msgpack_packer_init(&pk, &sbuf, msgpack_sbuffer_write);
+    std::string body(100, 'x');
+    for (int i = 0; i < 2000; ++i) {
+        msgpack_pack_array(&pk, 2);
+        msgpack_pack_int(&pk, i);
+        msgpack_pack_str_with_body(&pk, body.data(), body.size());
+    }
+
+    msgpack_unpacker unp;
+    if (!msgpack_unpacker_init_ring(&unp, 4096)) {
+        msgpack_sbuffer_destroy(&sbuf);
+        return; // no memfd_create
+    }
+    char* buffer = unp.buffer;
+
+    // 50 times the ring, messages straddling its end
+    msgpack_unpacked result;
+    msgpack_unpacked_init(&result);
+    size_t fed = 0;
+    int got = 0;
+    while (fed < sbuf.size) {
+        size_t n = std::min<size_t>(300, sbuf.size - fed);
+        ASSERT_TRUE(msgpack_unpacker_reserve_buffer(&unp, n));
+        memcpy(msgpack_unpacker_buffer(&unp), sbuf.data + fed, n);
+        msgpack_unpacker_buffer_consumed(&unp, n);
+        fed += n;
+        while (msgpack_unpacker_next(&unp, &result) == MSGPACK_UNPACK_SUCCESS) {
+            EXPECT_EQ((uint64_t)got, result.data.via.array.ptr[0].via.u64);
+            EXPECT_EQ(0, memcmp(body.data(), result.data.via.array.ptr[1].via.str.ptr, 100));
+            ++got;
+        }
+    }
+    EXPECT_EQ(2000, got);
+    EXPECT_EQ(buffer, unp.buffer);
+    msgpack_unpacked_destroy(&result);
+
+    // a live result pins the ring
+    msgpack_sbuffer_clear(&sbuf);
+    msgpack_pack_str_with_body(&pk, body.data(), body.size());
+    ASSERT_TRUE(msgpack_unpacker_reserve_buffer(&unp, sbuf.size));
+    memcpy(msgpack_unpacker_buffer(&unp), sbuf.data, sbuf.size);
+    msgpack_unpacker_buffer_consumed(&unp, sbuf.size);
+    EXPECT_EQ(MSGPACK_UNPACK_SUCCESS, msgpack_unpacker_next(&unp, &result));
+    EXPECT_FALSE(msgpack_unpacker_reserve_buffer(&unp, 4096));
+    msgpack_unpacked_destroy(&result);
+    EXPECT_TRUE(msgpack_unpacker_reserve_buffer(&unp, 4096));
+    EXPECT_FALSE(msgpack_unpacker_reserve_buffer(&unp, 4097));
+
+    msgpack_unpacker_destroy(&unp);
+    msgpack_sbuffer_destroy(&sbuf);
+}
+
+static void release_piece(void* ctx, const char* data, size_t size)
+{
+    (void)size;
+    ++*(int*)ctx;
+    free((void*)data);
+}
+
+static void check_borrowed(const msgpack_object& obj, int i)
+{
+    ASSERT_EQ(MSGPACK_OBJECT_ARRAY, obj.type);
+    ASSERT_EQ(4u, obj.via.array.size);
+    EXPECT_EQ((uint64_t)i, obj.via.array.ptr[0].via.u64);
+    EXPECT_EQ((uint32_t)(i % 40 + 1), obj.via.array.ptr[1].via.str.size);
+    EXPECT_EQ(std::string(i % 40 + 1, (char)('a' + i % 26)),
+              std::string(obj.via.array.ptr[1].via.str.ptr, obj.via.array.ptr[1].via.str.size));
+    EXPECT_EQ(300u, obj.via.array.ptr[2].via.bin.size);
+    EXPECT_EQ((char)i, obj.via.array.ptr[2].via.bin.ptr[299]);
+    EXPECT_EQ(i * 0.5, obj.via.array.ptr[3].via.f64);
+}
+
+TEST(streaming, borrowed)
+{
+    msgpack_sbuffer sbuf;
+    msgpack_sbuffer_init(&sbuf);
+    msgpack_packer pk;
+    msgpack_packer_init(&pk, &sbuf, msgpack_sbuffer_write);
+    for (int i = 0; i < 200; ++i) {
+        std::string str(i % 40 + 1, (char)('a' + i % 26));
+        std::string bin(300, (char)i);
+        msgpack_pack_array(&pk, 4);
+        msgpack_pack_int(&pk, i);
+        msgpack_pack_str_with_body(&pk, str.data(), str.size());
+        msgpack_pack_bin_with_body(&pk, bin.data(), bin.size());
+        msgpack_pack_double(&pk, i * 0.5);
+    }
+
+    msgpack_unpacker unp;
+    ASSERT_TRUE(msgpack_unpacker_init(&unp, 64));
+
+    // pieces of 1 to 97 bytes, so that headers, scalars and bodies straddle
+    int pieces = 0;
+    int released = 0;
+    std::vector<msgpack_unpacked> results;
+    msgpack_unpacked result;
+    msgpack_unpacked_init(&result);
+    size_t fed = 0;
+    while (fed < sbuf.size) {
+        msgpack_iovec iov[3];
+        size_t iovcnt = 0;
+        for (; iovcnt < 3 && fed < sbuf.size; ++iovcnt) {
+            size_t n = std::min<size_t>((size_t)pieces * 7 % 97 + 1, sbuf.size - fed);
+            char* piece = (char*)malloc(n);
+            memcpy(piece, sbuf.data + fed, n);
+            iov[iovcnt].iov_base = piece;
+            iov[iovcnt].iov_len = n;
+            fed += n;
+            ++pieces;
+        }
+        if (iovcnt == 1) {
+            ASSERT_TRUE(msgpack_unpacker_push_buffer(&unp, (const char*)iov[0].iov_base,
+                                                     iov[0].iov_len, release_piece, &released));
+        } else {
+            ASSERT_TRUE(msgpack_unpacker_push_iovec(&unp, iov, iovcnt, release_piece, &released));
+        }
+        while (msgpack_unpacker_next(&unp, &result) == MSGPACK_UNPACK_SUCCESS) {
+            results.push_back(result);
+            msgpack_unpacked_init(&result);
+        }
+    }
+    ASSERT_EQ(200u, results.size());
+    // the results hold the pieces with their str and bin bodies
+    EXPECT_LT(released, pieces);
+    for (size_t i = 0; i < results.size(); ++i) {
+        check_borrowed(results[i].data, (int)i);
+        msgpack_unpacked_destroy(&results[i]);
+    }
+    msgpack_unpacker_destroy(&unp);
+    EXPECT_EQ(pieces, released);
+
+    // in place: a whole buffer
+    ASSERT_TRUE(msgpack_unpacker_init(&unp, 64));
+    char* whole = (char*)malloc(sbuf.size);
+    memcpy(whole, sbuf.data, sbuf.size);
+    released = 0;
+    ASSERT_TRUE(msgpack_unpacker_push_buffer(&unp, whole, sbuf.size, release_piece, &released));
+    for (int i = 0; i < 200; ++i) {
+        ASSERT_EQ(MSGPACK_UNPACK_SUCCESS, msgpack_unpacker_next(&unp, &result));
+        check_borrowed(result.data, i);
+        const char* p = result.data.via.array.ptr[2].via.bin.ptr;
+        EXPECT_TRUE(p > whole && p < whole + sbuf.size);
+    }
+    msgpack_unpacked_destroy(&result);
+    EXPECT_EQ(0, released);
+    // parsed to the end, unreferenced
+    EXPECT_EQ(MSGPACK_UNPACK_CONTINUE, msgpack_unpacker_next(&unp, &result));
+    EXPECT_EQ(1, released);
+    msgpack_unpacker_destroy(&unp);
+
+    msgpack_sbuffer_destroy(&sbuf);
+}
+
+#if !defined(_WIN32)
+
+TEST(streaming, read_fd)
+{
+    msgpack_sbuffer sbuf;
+    msgpack_sbuffer_init(&sbuf);
+    msgpack_packer pk;
+    msgpack_packer_init(&pk, &sbuf, msgpack_sbuffer_write);
+    std::string body(1000, 'x');
+    for (int i = 0; i < 1000; ++i) {
+        msgpack_pack_array(&pk, 2);
+        msgpack_pack_int(&pk, i);
+        msgpack_pack_str_with_body(&pk, body.data(), (size_t)(i % 10) * 100);
+    }
+
+    int fds[2];
+    ASSERT_EQ(0, pipe(fds));
+    ASSERT_EQ(0, fcntl(fds[0], F_SETFL, O_NONBLOCK));
+
+    msgpack_unpacker unp;
+    ASSERT_TRUE(msgpack_unpacker_init(&unp, 64));
+    msgpack_unpacked result;
+    msgpack_unpacked_init(&result);
+    EXPECT_EQ(MSGPACK_UNPACKER_READ_AGAIN, msgpack_unpacker_read_fd(&unp, fds[0], 0));
+
+    // capped reads
+    ASSERT_EQ(10, write(fds[1], sbuf.data, 10));
+    EXPECT_EQ(MSGPACK_UNPACKER_READ_OK, msgpack_unpacker_read_fd(&unp, fds[0], 3));
+    EXPECT_EQ(3u, msgpack_unpacker_message_size(&unp));
+    EXPECT_EQ(MSGPACK_UNPACKER_READ_OK, msgpack_unpacker_read_fd(&unp, fds[0], 0));
+    EXPECT_EQ(MSGPACK_UNPACKER_READ_AGAIN, msgpack_unpacker_read_fd(&unp, fds[0], 0));
+
+    std::thread writer([&] {
+        size_t off = 10;
+        while (off < sbuf.size) {
+            ssize_t n = write(fds[1], sbuf.data + off, std::min<size_t>(7000, sbuf.size - off));
+            ASSERT_LT(0, n);
+            off += (size_t)n;
+        }
+        close(fds[1]);
+    });
+
+    int got = 0;
+    msgpack_unpacker_read_return ret;
+    while ((ret = msgpack_unpacker_read_fd(&unp, fds[0], 0)) != MSGPACK_UNPACKER_READ_EOF) {
+        ASSERT_TRUE(ret == MSGPACK_UNPACKER_READ_OK || ret == MSGPACK_UNPACKER_READ_AGAIN);
+        while (msgpack_unpacker_read_next(&unp, &result) == MSGPACK_UNPACK_SUCCESS) {
+            EXPECT_EQ((uint64_t)got, result.data.via.array.ptr[0].via.u64);
+            EXPECT_EQ((uint32_t)(got % 10) * 100, result.data.via.array.ptr[1].via.str.size);
+            ++got;
+        }
+        if (ret == MSGPACK_UNPACKER_READ_AGAIN) {
+            std::this_thread::yield();
+        }
+    }
+    writer.join();
+    EXPECT_EQ(1000, got);
+    EXPECT_EQ(0u, msgpack_unpacker_message_size(&unp));
+
+    EXPECT_EQ(MSGPACK_UNPACKER_READ_ERROR, msgpack_unpacker_read_fd(&unp, -1, 0));
+    EXPECT_EQ(EBADF, errno);
+
+    close(fds[0]);
+    msgpack_unpacked_destroy(&result);
+    msgpack_unpacker_destroy(&unp);
+    msgpack_sbuffer_destroy(&sbuf);
+}
+
+#endif // !defined(_WIN32)
+
+// zones of two standard chunks
+static void zone_churn(int rounds)
+{
+    for (int i = 0; i < rounds; ++i) {
+        msgpack_zone* z = msgpack_zone_new(MSGPACK_ZONE_CHUNK_SIZE);
+        ASSERT_TRUE(z != NULL);
+        for (int j = 0; j < 3; ++j) {
+            ASSERT_TRUE(msgpack_zone_malloc(z, MSGPACK_ZONE_CHUNK_SIZE / 2) != NULL);
+        }
+        msgpack_zone_free(z);
+    }
+}
+
+TEST(streaming, zone_chunk_cache)
+{
+    if (!msgpack_zone_chunk_cache_set_limits(4, 8)) {
+        return; // built without MSGPACK_ZONE_CHUNK_CACHE
+    }
+    msgpack_zone_chunk_cache_flush();
+    msgpack_zone_chunk_cache_stats before;
+    msgpack_zone_chunk_cache_get_stats(&before);
+
+    zone_churn(100);
+    msgpack_zone_chunk_cache_flush();
+    msgpack_zone_chunk_cache_stats stats;
+    msgpack_zone_chunk_cache_get_stats(&stats);
+    EXPECT_EQ(200u, (stats.hits - before.hits) + (stats.misses - before.misses));
+    EXPECT_LE(stats.misses - before.misses, 2u);
+    EXPECT_GE(stats.bytes_cached, 2u * MSGPACK_ZONE_CHUNK_SIZE);
+    EXPECT_LT(stats.bytes_cached, 9u * MSGPACK_ZONE_CHUNK_SIZE);
+
+    // the magazines of exiting threads go to the depot
+    before = stats;
+    std::vector<std::thread> threads;
+    for (int i = 0; i < 4; ++i) {
+        threads.push_back(std::thread(zone_churn, 1000));
+    }
+    for (size_t i = 0; i < threads.size(); ++i) {
+        threads[i].join();
+    }
+    msgpack_zone_chunk_cache_get_stats(&stats);
+    EXPECT_EQ(8000u, (stats.hits - before.hits) + (stats.misses - before.misses));
+    EXPECT_GT(stats.hits - before.hits, 7900u);
+    EXPECT_LT(stats.bytes_cached, 9u * MSGPACK_ZONE_CHUNK_SIZE);
+
+    // the magazine of a thread that only allocates goes to the depot too
+    std::vector<msgpack_zone*> zones;
+    for (int i = 0; i < 8; ++i) {
+        zones.push_back(msgpack_zone_new(MSGPACK_ZONE_CHUNK_SIZE));
+    }
+    for (size_t i = 0; i < zones.size(); ++i) {
+        msgpack_zone_free(zones[i]);
+    }
+    zones.clear();
+    msgpack_zone_chunk_cache_flush();
+    msgpack_zone_chunk_cache_get_stats(&before);
+    std::thread producer([&zones]() {
+        for (int i = 0; i < 3; ++i) {
+            zones.push_back(msgpack_zone_new(MSGPACK_ZONE_CHUNK_SIZE));
+        }
+    });
+    producer.join();
+    msgpack_zone_chunk_cache_get_stats(&stats);
+    EXPECT_EQ(3u, stats.hits - before.hits);
+    EXPECT_EQ(0u, stats.misses - before.misses);
+    for (size_t i = 0; i < zones.size(); ++i) {
+        msgpack_zone_free(zones[i]);
+    }
+    msgpack_zone_chunk_cache_flush();
+    msgpack_zone_chunk_cache_get_stats(&stats);
+    EXPECT_EQ(before.bytes_cached, stats.bytes_cached);
+
+    // a limit of 0 disables the cache and empties the depot
+    EXPECT_TRUE(msgpack_zone_chunk_cache_set_limits(0, 0));
+    zone_churn(10);
+    msgpack_zone_chunk_cache_get_stats(&stats);
+    EXPECT_EQ(0u, stats.bytes_cached);
+
+    msgpack_zone_chunk_cache_set_limits(MSGPACK_ZONE_CHUNK_CACHE_THREAD_LIMIT,
+                                        MSGPACK_ZONE_CHUNK_CACHE_DEPOT_LIMIT);
+}
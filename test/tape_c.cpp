@@ -0,0 +1,156 @@
+#include <msgpack.h>
+#include <msgpack/tape.h>
+
+#if defined(__GNUC__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wconversion"
+#endif //defined(__GNUC__)
+
+#include <gtest/gtest.h>
+
+#if defined(__GNUC__)
+#pragma GCC diagnostic pop
+#endif //defined(__GNUC__)
+
+// {"rows": [[0, "r0"], [1, "r1"], ...], "meta": {"name": "t", "empty": []}}
+static void pack_document(msgpack_sbuffer* sbuf, int rows)
+{
+    msgpack_packer pk;
+    msgpack_packer_init(&pk, sbuf, msgpack_sbuffer_write);
+
+    msgpack_pack_map(&pk, 2);
+    msgpack_pack_str_with_body(&pk, "rows", 4);
+    msgpack_pack_array(&pk, rows);
+    for (int i = 0; i < rows; ++i) {
+        char name[16];
+        int len = snprintf(name, sizeof(name), "r%d", i);
+        msgpack_pack_array(&pk, 2);
+        msgpack_pack_int(&pk, i);
+        msgpack_pack_str_with_body(&pk, name, len);
+    }
+    msgpack_pack_str_with_body(&pk, "meta", 4);
+    msgpack_pack_map(&pk, 2);
+    msgpack_pack_str_with_body(&pk, "name", 4);
+    msgpack_pack_str_with_body(&pk, "t", 1);
+    msgpack_pack_str_with_body(&pk, "empty", 5);
+    msgpack_pack_array(&pk, 0);
+}
+
+static void check_document(const msgpack_tape* tape, const msgpack_sbuffer* sbuf, int rows)
+{
+    EXPECT_EQ(sbuf->size, tape->data_len);
+    // root, 2 keys, rows array, 3 entries per row, meta map, 4 entries in meta
+    EXPECT_EQ((size_t)(1 + 2 + 1 + rows * 3 + 1 + 4), tape->count);
+
+    const msgpack_tape_entry* root = msgpack_tape_at(tape, 0);
+    ASSERT_TRUE(root != NULL);
+    EXPECT_EQ(MSGPACK_OBJECT_MAP, (msgpack_object_type)root->type);
+    EXPECT_EQ(2u, root->size);
+    EXPECT_EQ(0u, root->offset);
+    EXPECT_EQ(sbuf->size, root->end);
+    EXPECT_EQ(tape->count, root->next);
+
+    uint32_t rows_index = msgpack_tape_find_key(tape, sbuf->data, 0, "rows", 4);
+    ASSERT_NE(MSGPACK_TAPE_NONE, rows_index);
+    EXPECT_EQ(rows_index, msgpack_tape_child(tape, 0, 1));
+
+    // the Nth row directly
+    uint32_t row = msgpack_tape_child(tape, rows_index, rows - 1);
+    ASSERT_NE(MSGPACK_TAPE_NONE, row);
+    EXPECT_EQ(MSGPACK_TAPE_NONE, msgpack_tape_child(tape, rows_index, rows));
+    msgpack_cursor cur;
+    int64_t v;
+    ASSERT_TRUE(msgpack_tape_cursor(tape, sbuf->data, msgpack_tape_child(tape, row, 0), &cur));
+    EXPECT_TRUE(msgpack_cursor_as_int(&cur, &v));
+    EXPECT_EQ(rows - 1, v);
+
+    // past the rows subtree
+    const msgpack_tape_entry* e = msgpack_tape_at(tape, rows_index);
+    EXPECT_EQ(msgpack_tape_child(tape, 0, 2), e->next);
+    EXPECT_EQ(msgpack_tape_at(tape, e->next)->offset, e->end);
+
+    uint32_t meta = msgpack_tape_find_key(tape, sbuf->data, 0, "meta", 4);
+    uint32_t name = msgpack_tape_find_key(tape, sbuf->data, meta, "name", 4);
+    const char* ptr;
+    uint32_t size;
+    ASSERT_TRUE(msgpack_tape_cursor(tape, sbuf->data, name, &cur));
+    EXPECT_TRUE(msgpack_cursor_as_str(&cur, &ptr, &size));
+    EXPECT_EQ(1u, size);
+    EXPECT_EQ('t', *ptr);
+
+    uint32_t empty = msgpack_tape_find_key(tape, sbuf->data, meta, "empty", 5);
+    EXPECT_EQ(0u, msgpack_tape_at(tape, empty)->size);
+    EXPECT_EQ(MSGPACK_TAPE_NONE, msgpack_tape_child(tape, empty, 0));
+    EXPECT_EQ(MSGPACK_TAPE_NONE, msgpack_tape_find_key(tape, sbuf->data, meta, "none", 4));
+    EXPECT_EQ(MSGPACK_TAPE_NONE, msgpack_tape_find_key(tape, sbuf->data, name, "name", 4));
+}
+
+TEST(tape, build)
+{
+    msgpack_sbuffer sbuf;
+    msgpack_sbuffer_init(&sbuf);
+    pack_document(&sbuf, 1000);
+
+    msgpack_tape tape;
+    msgpack_tape_init(&tape);
+    EXPECT_EQ(MSGPACK_UNPACK_SUCCESS, msgpack_tape_build(&tape, sbuf.data, sbuf.size, 0));
+    check_document(&tape, &sbuf, 1000);
+
+    // truncated and invalid
+    EXPECT_EQ(MSGPACK_UNPACK_CONTINUE, msgpack_tape_build(&tape, sbuf.data, sbuf.size - 1, 0));
+    EXPECT_EQ(MSGPACK_UNPACK_CONTINUE, msgpack_tape_build(&tape, "\xdd\xff\xff\xff\xff", 5, 0));
+    EXPECT_EQ(MSGPACK_UNPACK_PARSE_ERROR, msgpack_tape_build(&tape, "\x92\x01\xc1", 3, 0));
+    EXPECT_EQ(0u, tape.count);
+
+    msgpack_tape_destroy(&tape);
+    msgpack_sbuffer_destroy(&sbuf);
+}
+
+TEST(tape, save_load)
+{
+    msgpack_sbuffer sbuf;
+    msgpack_sbuffer_init(&sbuf);
+    pack_document(&sbuf, 100);
+
+    msgpack_tape tape;
+    msgpack_tape_init(&tape);
+    EXPECT_EQ(MSGPACK_UNPACK_SUCCESS, msgpack_tape_build(&tape, sbuf.data, sbuf.size, 0));
+
+    msgpack_sbuffer saved;
+    msgpack_sbuffer_init(&saved);
+    EXPECT_EQ(0, msgpack_tape_save(&tape, msgpack_sbuffer_write, &saved));
+
+    msgpack_tape loaded;
+    msgpack_tape_init(&loaded);
+    EXPECT_TRUE(msgpack_tape_load(&loaded, saved.data, saved.size));
+    check_document(&loaded, &sbuf, 100);
+
+    EXPECT_FALSE(msgpack_tape_load(&loaded, saved.data, saved.size - 1));
+
+    // entries pointing out of the data or backwards
+    const size_t header = saved.size - tape.count * sizeof(msgpack_tape_entry)
+        - tape.nchildren * sizeof(uint32_t);
+    msgpack_tape_entry* last = (msgpack_tape_entry*)(saved.data + header) + tape.count - 1;
+    msgpack_tape_entry e = *last;
+    last->end = sbuf.size + 1;
+    EXPECT_FALSE(msgpack_tape_load(&loaded, saved.data, saved.size));
+    *last = e;
+    last->offset = last->end;
+    EXPECT_FALSE(msgpack_tape_load(&loaded, saved.data, saved.size));
+    *last = e;
+    last->next = (uint32_t)tape.count + 1;
+    EXPECT_FALSE(msgpack_tape_load(&loaded, saved.data, saved.size));
+    *last = e;
+    last->next = 0;
+    EXPECT_FALSE(msgpack_tape_load(&loaded, saved.data, saved.size));
+    *last = e;
+    EXPECT_TRUE(msgpack_tape_load(&loaded, saved.data, saved.size));
+
+    saved.data[0] = 'X';
+    EXPECT_FALSE(msgpack_tape_load(&loaded, saved.data, saved.size));
+
+    msgpack_tape_destroy(&loaded);
+    msgpack_sbuffer_destroy(&saved);
+    msgpack_tape_destroy(&tape);
+    msgpack_sbuffer_destroy(&sbuf);
+}
@@ -0,0 +1,271 @@
+#include <msgpack.h>
+#include <msgpack/typed.h>
+#include <limits>
+#include <vector>
+
+#if defined(__GNUC__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wconversion"
+#endif //defined(__GNUC__)
+
+#include <gtest/gtest.h>
+
+#if defined(__GNUC__)
+#pragma GCC diagnostic pop
+#endif //defined(__GNUC__)
+
+static const int64_t int_values[] = {
+    0, 1, 127, 128, 255, 256, 65535, 65536, 4294967295LL, 4294967296LL,
+    std::numeric_limits<int64_t>::max(),
+    -1, -32, -33, -128, -129, -32768, -32769, -2147483648LL, -2147483649LL,
+    std::numeric_limits<int64_t>::min(),
+    // runs of the same width
+    300, 301, 302, 303, -5, -6, -7, 100000, 100001, 100002
+};
+
+TEST(typed, int64_array)
+{
+    const size_t n = sizeof(int_values) / sizeof(int_values[0]);
+    msgpack_sbuffer sbuf;
+    msgpack_sbuffer_init(&sbuf);
+    msgpack_packer pk;
+    msgpack_packer_init(&pk, &sbuf, msgpack_sbuffer_write);
+    msgpack_pack_array(&pk, n);
+    for (size_t i = 0; i < n; ++i) {
+        msgpack_pack_int64(&pk, int_values[i]);
+    }
+
+    int64_t out[64];
+    size_t count;
+    size_t off = 0;
+    EXPECT_EQ(MSGPACK_UNPACK_SUCCESS,
+              msgpack_unpack_int64_array(sbuf.data, sbuf.size, &off, out, 64, &count));
+    EXPECT_EQ(sbuf.size, off);
+    ASSERT_EQ(n, count);
+    for (size_t i = 0; i < n; ++i) {
+        EXPECT_EQ(int_values[i], out[i]);
+    }
+
+    msgpack_cursor cur;
+    msgpack_cursor_init(&cur, sbuf.data, sbuf.size, 0);
+    EXPECT_EQ(5u, msgpack_cursor_int64_array(&cur, out, 5));
+    EXPECT_EQ(n, msgpack_cursor_int64_array(&cur, out, 64));
+    EXPECT_EQ(int_values[n - 1], out[n - 1]);
+
+    // too small
+    off = 0;
+    EXPECT_EQ(MSGPACK_UNPACK_NOMEM_ERROR,
+              msgpack_unpack_int64_array(sbuf.data, sbuf.size, &off, out, 4, &count));
+    EXPECT_EQ(n, count);
+    EXPECT_EQ(0u, off);
+
+    // truncated
+    EXPECT_EQ(MSGPACK_UNPACK_CONTINUE,
+              msgpack_unpack_int64_array(sbuf.data, sbuf.size - 1, &off, out, 64, &count));
+    EXPECT_EQ(0u, off);
+
+    msgpack_sbuffer_destroy(&sbuf);
+}
+
+TEST(typed, non_conforming)
+{
+    msgpack_sbuffer sbuf;
+    msgpack_sbuffer_init(&sbuf);
+    msgpack_packer pk;
+    msgpack_packer_init(&pk, &sbuf, msgpack_sbuffer_write);
+    msgpack_pack_array(&pk, 4);
+    msgpack_pack_int(&pk, 1);
+    msgpack_pack_int(&pk, 1000);
+    msgpack_pack_uint64(&pk, std::numeric_limits<uint64_t>::max());
+    msgpack_pack_int(&pk, 2);
+
+    int64_t out[4];
+    double dout[4];
+    size_t count;
+    size_t off = 0;
+    EXPECT_EQ(MSGPACK_UNPACK_PARSE_ERROR,
+              msgpack_unpack_int64_array(sbuf.data, sbuf.size, &off, out, 4, &count));
+    EXPECT_EQ(2u, count);
+    EXPECT_EQ(1000, out[1]);
+    EXPECT_EQ(0u, off);
+    // but a double holds it
+    EXPECT_EQ(MSGPACK_UNPACK_SUCCESS,
+              msgpack_unpack_double_array(sbuf.data, sbuf.size, &off, dout, 4, &count));
+    EXPECT_EQ(4u, count);
+    EXPECT_EQ(2.0, dout[3]);
+
+    msgpack_sbuffer_clear(&sbuf);
+    msgpack_pack_array(&pk, 3);
+    msgpack_pack_double(&pk, 0.5);
+    msgpack_pack_str_with_body(&pk, "x", 1);
+    msgpack_pack_double(&pk, 1.5);
+    off = 0;
+    EXPECT_EQ(MSGPACK_UNPACK_PARSE_ERROR,
+              msgpack_unpack_double_array(sbuf.data, sbuf.size, &off, dout, 4, &count));
+    EXPECT_EQ(1u, count);
+    msgpack_cursor cur;
+    msgpack_cursor_init(&cur, sbuf.data, sbuf.size, 0);
+    EXPECT_EQ(1u, msgpack_cursor_double_array(&cur, dout, 4));
+
+    // not an array
+    msgpack_sbuffer_clear(&sbuf);
+    msgpack_pack_int(&pk, 1);
+    EXPECT_EQ(MSGPACK_UNPACK_PARSE_ERROR,
+              msgpack_unpack_double_array(sbuf.data, sbuf.size, NULL, dout, 4, &count));
+    EXPECT_EQ(0u, count);
+    msgpack_cursor_init(&cur, sbuf.data, sbuf.size, 0);
+    EXPECT_EQ(0u, msgpack_cursor_int64_array(&cur, out, 4));
+
+    msgpack_sbuffer_destroy(&sbuf);
+}
+
+TEST(typed, real_arrays)
+{
+    msgpack_sbuffer sbuf;
+    msgpack_sbuffer_init(&sbuf);
+    msgpack_packer pk;
+    msgpack_packer_init(&pk, &sbuf, msgpack_sbuffer_write);
+    msgpack_pack_array(&pk, 1000);
+    for (int i = 0; i < 1000; ++i) {
+        // runs of float64, float32 and integers
+        if (i < 400) {
+            msgpack_pack_double(&pk, i * 0.25);
+        } else if (i < 800) {
+            msgpack_pack_float(&pk, (float)(i * 0.25));
+        } else {
+            msgpack_pack_int(&pk, i - 900);
+        }
+    }
+    msgpack_pack_nil(&pk);
+
+    std::vector<double> d(1000);
+    std::vector<float> f(1000);
+    size_t count;
+    size_t off = 0;
+    EXPECT_EQ(MSGPACK_UNPACK_EXTRA_BYTES,
+              msgpack_unpack_double_array(sbuf.data, sbuf.size, &off, d.data(), d.size(), &count));
+    EXPECT_EQ(sbuf.size - 1, off);
+    off = 0;
+    EXPECT_EQ(MSGPACK_UNPACK_EXTRA_BYTES,
+              msgpack_unpack_float_array(sbuf.data, sbuf.size, &off, f.data(), f.size(), &count));
+    ASSERT_EQ(1000u, count);
+    for (int i = 0; i < 1000; ++i) {
+        double expected = i < 800 ? i * 0.25 : i - 900;
+        EXPECT_EQ(expected, d[i]);
+        EXPECT_EQ((float)expected, f[i]);
+    }
+
+    msgpack_sbuffer_destroy(&sbuf);
+}
+
+// [{"ts": i, "id": "n<i>", "v": i / 2, "ok": i odd}, ...], key order changing
+static void pack_rows(msgpack_packer* pk, int rows, bool missing_v)
+{
+    msgpack_pack_array(pk, rows);
+    for (int i = 0; i < rows; ++i) {
+        bool has_v = !(missing_v && i == rows - 1);
+        char id[16];
+        int len = snprintf(id, sizeof(id), "n%d", i);
+        msgpack_pack_map(pk, has_v ? 5 : 4);
+        if (i < rows / 2) {
+            msgpack_pack_str_with_body(pk, "ts", 2);
+            msgpack_pack_int(pk, i);
+            msgpack_pack_str_with_body(pk, "id", 2);
+            msgpack_pack_str_with_body(pk, id, len);
+        } else {
+            msgpack_pack_str_with_body(pk, "id", 2);
+            msgpack_pack_str_with_body(pk, id, len);
+            msgpack_pack_str_with_body(pk, "ts", 2);
+            msgpack_pack_int(pk, i);
+        }
+        msgpack_pack_str_with_body(pk, "extra", 5);
+        msgpack_pack_array(pk, 1);
+        msgpack_pack_nil(pk);
+        if (has_v) {
+            msgpack_pack_str_with_body(pk, "v", 1);
+            msgpack_pack_double(pk, i / 2.0);
+        }
+        msgpack_pack_str_with_body(pk, "ok", 2);
+        if (i % 2) msgpack_pack_true(pk); else msgpack_pack_false(pk);
+    }
+}
+
+TEST(typed, columns)
+{
+    const int rows = 20;
+    msgpack_sbuffer sbuf;
+    msgpack_sbuffer_init(&sbuf);
+    msgpack_packer pk;
+    msgpack_packer_init(&pk, &sbuf, msgpack_sbuffer_write);
+    pack_rows(&pk, rows, false);
+
+    int64_t ts[rows];
+    msgpack_object_str id[rows];
+    float v[rows];
+    bool ok[rows];
+    bool v_present[rows];
+    msgpack_column columns[] = {
+        { "ts", 2, MSGPACK_COLUMN_INT64, ts, NULL },
+        { "id", 2, MSGPACK_COLUMN_STR, id, NULL },
+        { "v", 1, MSGPACK_COLUMN_FLOAT, v, v_present },
+        { "ok", 2, MSGPACK_COLUMN_BOOL, ok, NULL },
+    };
+    msgpack_columns cols;
+    ASSERT_TRUE(msgpack_columns_init(&cols, columns, 4));
+
+    size_t n;
+    size_t off = 0;
+    EXPECT_EQ(MSGPACK_UNPACK_SUCCESS,
+              msgpack_columns_unpack(&cols, sbuf.data, sbuf.size, &off, rows, &n));
+    EXPECT_EQ(sbuf.size, off);
+    ASSERT_EQ((size_t)rows, n);
+    for (int i = 0; i < rows; ++i) {
+        char expected[16];
+        int len = snprintf(expected, sizeof(expected), "n%d", i);
+        EXPECT_EQ(i, ts[i]);
+        ASSERT_EQ((uint32_t)len, id[i].size);
+        EXPECT_EQ(0, memcmp(expected, id[i].ptr, len));
+        EXPECT_TRUE(v_present[i]);
+        EXPECT_EQ((float)i / 2.0f, v[i]);
+        EXPECT_EQ(i % 2 == 1, ok[i]);
+    }
+
+    // a missing optional column
+    msgpack_sbuffer_clear(&sbuf);
+    pack_rows(&pk, rows, true);
+    off = 0;
+    EXPECT_EQ(MSGPACK_UNPACK_SUCCESS,
+              msgpack_columns_unpack(&cols, sbuf.data, sbuf.size, &off, rows, &n));
+    EXPECT_TRUE(v_present[rows - 2]);
+    EXPECT_FALSE(v_present[rows - 1]);
+    EXPECT_EQ(0.0f, v[rows - 1]);
+
+    // a missing required column, a row of the wrong type
+    columns[2].present = NULL;
+    off = 0;
+    EXPECT_EQ(MSGPACK_UNPACK_PARSE_ERROR,
+              msgpack_columns_unpack(&cols, sbuf.data, sbuf.size, &off, rows, &n));
+    EXPECT_EQ((size_t)rows - 1, n);
+    EXPECT_EQ(0u, off);
+
+    msgpack_sbuffer_clear(&sbuf);
+    msgpack_pack_array(&pk, 2);
+    msgpack_pack_map(&pk, 0);
+    msgpack_pack_int(&pk, 1);
+    columns[0].present = v_present;
+    columns[1].present = v_present;
+    columns[2].present = v_present;
+    columns[3].present = v_present;
+    EXPECT_EQ(MSGPACK_UNPACK_PARSE_ERROR,
+              msgpack_columns_unpack(&cols, sbuf.data, sbuf.size, &off, rows, &n));
+    EXPECT_EQ(1u, n);
+
+    EXPECT_EQ(MSGPACK_UNPACK_NOMEM_ERROR,
+              msgpack_columns_unpack(&cols, sbuf.data, sbuf.size, &off, 1, &n));
+    EXPECT_EQ(2u, n);
+    EXPECT_EQ(MSGPACK_UNPACK_CONTINUE,
+              msgpack_columns_unpack(&cols, sbuf.data, sbuf.size - 1, &off, rows, &n));
+
+    msgpack_columns_destroy(&cols);
+    msgpack_sbuffer_destroy(&sbuf);
+}